@@ -21,7 +21,7 @@ umask(0077);
 # Look for them in $SRCDIR,  which is set by default in config.pm 
 # and can be altered with -s.
 #
-$driverfiles = "Makefile,mdriver.c,config.h,memlib.c,memlib.h,mm.h,clock.c,clock.h,fcyc.c,fcyc.h,fsecs.c,fsecs.h,ftimer.c,ftimer.h";
+$driverfiles = "Makefile,mdriver.c,libmdriver.c,libmdriver.h,config.h,memlib.c,memlib.h,mm.h,clock.c,clock.h,fcyc.c,fcyc.h,fsecs.c,fsecs.h,ftimer.c,ftimer.h,tracestream.c,tracestream.h,perfctr.c,perfctr.h,cachesim.c,cachesim.h,memtrace.h,profile.c,profile.h,simpoint.c,simpoint.h";
 
 #
 # usage - print help message and terminate
@@ -100,6 +100,10 @@ system("cp $SRCDIR/Makefile $tmpdir") == 0
   or die "ERROR: cp driver files to $tmpdir failed\n";
 system("cp $SRCDIR/mdriver.c $tmpdir") == 0
   or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/libmdriver.c $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/libmdriver.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
 system("cp $SRCDIR/config.h $tmpdir") == 0
   or die "ERROR: cp driver files to $tmpdir failed\n";
 system("cp $SRCDIR/memlib.c $tmpdir") == 0
@@ -124,6 +128,28 @@ system("cp $SRCDIR/ftimer.c $tmpdir") == 0
   or die "ERROR: cp driver files to $tmpdir failed\n";
 system("cp $SRCDIR/ftimer.h $tmpdir") == 0
   or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/tracestream.c $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/tracestream.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/perfctr.c $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/perfctr.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/cachesim.c $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/cachesim.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/memtrace.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/profile.c $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/profile.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/simpoint.c $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
+system("cp $SRCDIR/simpoint.h $tmpdir") == 0
+  or die "ERROR: cp driver files to $tmpdir failed\n";
   
 # Print header
 print "\nCS:APP Malloc Lab: Grading Sheet for $infile_basename\n\n";
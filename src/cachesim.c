@@ -0,0 +1,298 @@
+/*
+ * cachesim.c - A deterministic model of a cache and a TLB
+ *
+ * Both are set-associative with LRU replacement, and both allocate on
+ * writes as well as on reads, so loads and stores count alike. The
+ * model sees only the accesses it is fed, through the hooks in
+ * memtrace.h and the payload touches of the driver, and counts the
+ * same misses for the same accesses on any machine. It only tracks
+ * which lines are present; it never looks at the data.
+ *
+ * Independently of the cache, the model counts the bytes loaded and
+ * stored, and the distinct lines that each op touches, whatever the
+ * geometry: a line touched twice in one op counts once, even if it
+ * was evicted in between.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cachesim.h"
+
+/* One set-associative array of tags with LRU replacement */
+typedef struct {
+    int sets;                 /* number of sets */
+    int ways;                 /* entries per set */
+    int shift;                /* log2 of the bytes per entry */
+    unsigned long *tags;      /* sets*ways tags (NO_TAG: empty) */
+    unsigned long *stamps;    /* ... and the time of their last use */
+} array_t;
+
+#define NO_TAG (~0UL)
+
+/*
+ * The lines touched by the current op: an open-addressed hash table
+ * of line numbers (tagged with the source), whose entries belong to
+ * the current op only if their op number is the current one
+ */
+#define TOUCHED_INIT 1024     /* initial entries (a power of two) */
+typedef struct {
+    int size;                 /* number of entries */
+    int used;                 /* ... that belong to the current op */
+    unsigned long op;         /* number of the current op */
+    unsigned long *keys;      /* line<<1 | source */
+    unsigned long *ops;       /* the op that touched the line */
+} touched_t;
+
+/********************
+ * Global variables
+ *******************/
+int cachesim_on = 0;
+int cachesim_source = CACHESIM_META;
+
+static array_t cache, tlb;
+static unsigned long base = 0;  /* addresses are relative to this */
+static unsigned long now = 0;  /* lookups so far, for LRU */
+static cachesim_stats_t counts[CACHESIM_NSOURCES];
+static touched_t touched;
+
+/*********************
+ * Function prototypes
+ *********************/
+static int init_array(array_t *a, int entries, int ways, int bytes);
+static int lookup(array_t *a, unsigned long block);
+static int log2_exact(int x);
+static int touch_line(unsigned long key);
+static int grow_touched(void);
+
+/*
+ * cachesim_default_config - A 32 KB 8-way cache with 64-byte lines,
+ *     like the L1 data caches of most x86 processors, and a 64-entry
+ *     4-way TLB of 4 KB pages
+ */
+void cachesim_default_config(cachesim_config_t *config)
+{
+    config->cache_size = 32*1024;
+    config->line_size = 64;
+    config->assoc = 8;
+    config->tlb_entries = 64;
+    config->tlb_assoc = 4;
+    config->page_size = 4096;
+}
+
+/*
+ * cachesim_init - Build (or rebuild) the model for config. Returns -1
+ *     if a size is not a power of two or the ways don't divide the
+ *     entries.
+ */
+int cachesim_init(const cachesim_config_t *config)
+{
+    if (config->line_size <= 0 || config->assoc <= 0 ||
+	config->cache_size < config->line_size * config->assoc)
+	return -1;
+    if (init_array(&cache, config->cache_size / config->line_size,
+		   config->assoc, config->line_size) < 0)
+	return -1;
+    if (init_array(&tlb, config->tlb_entries, config->tlb_assoc,
+		   config->page_size) < 0)
+	return -1;
+    if (touched.keys == NULL) {
+	touched.size = TOUCHED_INIT / 2;
+	if (grow_touched() < 0)
+	    return -1;
+    }
+    cachesim_reset(NULL);
+    return 0;
+}
+
+/*
+ * cachesim_reset - Empty the cache and the TLB, and zero the counts
+ */
+void cachesim_reset(const void *newbase)
+{
+    int i;
+
+    for (i = 0; i < cache.sets * cache.ways; i++)
+	cache.tags[i] = NO_TAG;
+    for (i = 0; i < tlb.sets * tlb.ways; i++)
+	tlb.tags[i] = NO_TAG;
+    memset(counts, 0, sizeof(counts));
+    base = (unsigned long)newbase;
+    now = 0;
+    memset(touched.ops, 0, touched.size * sizeof(unsigned long));
+    touched.op = 1;
+    touched.used = 0;
+}
+
+/*
+ * cachesim_access - Feed an access of bytes bytes at addr to the
+ *     model. Every line and page that the access spans is looked up.
+ */
+void cachesim_access(const void *addr, size_t bytes, int write)
+{
+    cachesim_stats_t *c = &counts[cachesim_source];
+    unsigned long a = (unsigned long)addr - base;
+    unsigned long first, last, block;
+
+    if (bytes == 0)
+	return;
+    c->accesses++;
+    if (write)
+	c->store_bytes += bytes;
+    else
+	c->load_bytes += bytes;
+
+    first = a >> cache.shift;
+    last = (a + bytes - 1) >> cache.shift;
+    for (block = first; block <= last; block++) {
+	if (!lookup(&cache, block))
+	    c->misses++;
+	if (touch_line(block << 1 | cachesim_source))
+	    c->lines++;
+    }
+
+    first = a >> tlb.shift;
+    last = (a + bytes - 1) >> tlb.shift;
+    for (block = first; block <= last; block++)
+	if (!lookup(&tlb, block))
+	    c->tlb_misses++;
+}
+
+/*
+ * cachesim_end_op - End the current op. Bumping the op number empties
+ *     the table of touched lines without clearing it.
+ */
+void cachesim_end_op(void)
+{
+    touched.op++;
+    touched.used = 0;
+}
+
+/*
+ * cachesim_stats - The counts of source since the last reset
+ */
+void cachesim_stats(int source, cachesim_stats_t *stats)
+{
+    *stats = counts[source];
+}
+
+/*
+ * init_array - Allocate an array of entries entries in sets of ways,
+ *     each covering bytes bytes
+ */
+static int init_array(array_t *a, int entries, int ways, int bytes)
+{
+    if (ways <= 0 || entries < ways || entries % ways != 0 ||
+	log2_exact(entries / ways) < 0 || (a->shift = log2_exact(bytes)) < 0)
+	return -1;
+    a->sets = entries / ways;
+    a->ways = ways;
+    free(a->tags);
+    free(a->stamps);
+    a->tags = (unsigned long *)malloc(entries * sizeof(unsigned long));
+    a->stamps = (unsigned long *)calloc(entries, sizeof(unsigned long));
+    if (a->tags == NULL || a->stamps == NULL)
+	return -1;
+    return 0;
+}
+
+/*
+ * lookup - Look up block (an address divided by the bytes per entry)
+ *     in a, and make it the most recently used entry of its set.
+ *     Returns 1 on a hit, and 0 on a miss, after replacing the least
+ *     recently used entry of the set by block.
+ */
+static int lookup(array_t *a, unsigned long block)
+{
+    int set = block & (a->sets - 1);
+    unsigned long *tags = &a->tags[set * a->ways];
+    unsigned long *stamps = &a->stamps[set * a->ways];
+    int i, victim = 0;
+
+    now++;
+    for (i = 0; i < a->ways; i++) {
+	if (tags[i] == block) {
+	    stamps[i] = now;
+	    return 1;
+	}
+	if (tags[i] == NO_TAG)
+	    victim = i;
+	else if (tags[victim] != NO_TAG && stamps[i] < stamps[victim])
+	    victim = i;
+    }
+    tags[victim] = block;
+    stamps[victim] = now;
+    return 0;
+}
+
+/*
+ * touch_line - Record that the current op touched the line of key.
+ *     Returns 1 if it is the first time, and 0 otherwise. If the table
+ *     can't grow, the line counts as new.
+ */
+static int touch_line(unsigned long key)
+{
+    unsigned long i = (key * 2654435761UL) & (touched.size - 1);
+
+    if (touched.used >= touched.size - 1)
+	return 1;
+    while (touched.ops[i] == touched.op) {
+	if (touched.keys[i] == key)
+	    return 0;
+	i = (i + 1) & (touched.size - 1);
+    }
+    touched.keys[i] = key;
+    touched.ops[i] = touched.op;
+    if (++touched.used * 2 > touched.size)
+	grow_touched();
+    return 1;
+}
+
+/*
+ * grow_touched - Double the table of touched lines, keeping the lines
+ *     of the current op
+ */
+static int grow_touched(void)
+{
+    unsigned long *keys = touched.keys, *ops = touched.ops;
+    int size = touched.size, i;
+    unsigned long j;
+
+    touched.size = 2 * size;
+    touched.keys = (unsigned long *)malloc(touched.size * sizeof(unsigned long));
+    touched.ops = (unsigned long *)calloc(touched.size, sizeof(unsigned long));
+    if (touched.keys == NULL || touched.ops == NULL) {
+	free(touched.keys);
+	free(touched.ops);
+	touched.keys = keys;
+	touched.ops = ops;
+	touched.size = size;
+	return -1;
+    }
+    for (i = 0; keys && i < size; i++) {
+	if (ops[i] != touched.op)
+	    continue;
+	j = (keys[i] * 2654435761UL) & (touched.size - 1);
+	while (touched.ops[j] == touched.op)
+	    j = (j + 1) & (touched.size - 1);
+	touched.keys[j] = keys[i];
+	touched.ops[j] = touched.op;
+    }
+    free(keys);
+    free(ops);
+    return 0;
+}
+
+/*
+ * log2_exact - log2 of x if x is a power of two, else -1
+ */
+static int log2_exact(int x)
+{
+    int n = 0;
+
+    if (x <= 0 || (x & (x-1)) != 0)
+	return -1;
+    while ((1 << n) < x)
+	n++;
+    return n;
+}
@@ -0,0 +1,61 @@
+/*
+ * cachesim.h - A deterministic model of a cache and a TLB
+ */
+#ifndef __CACHESIM_H_
+#define __CACHESIM_H_
+
+#include <stddef.h>
+
+/* The geometry of the model. All sizes are powers of two. */
+typedef struct {
+    int cache_size;   /* bytes of the cache */
+    int line_size;    /* bytes per cache line */
+    int assoc;        /* lines per cache set */
+    int tlb_entries;  /* entries of the TLB */
+    int tlb_assoc;    /* entries per TLB set */
+    int page_size;    /* bytes per page */
+} cachesim_config_t;
+
+/* Who makes the accesses that the model counts */
+#define CACHESIM_META     0  /* the allocator, on its metadata */
+#define CACHESIM_PAYLOAD  1  /* the application, on the payloads */
+#define CACHESIM_NSOURCES 2
+
+/* What the model counted for one source */
+typedef struct {
+    double accesses;    /* accesses (an access may span several lines) */
+    double misses;      /* cache lines that missed */
+    double tlb_misses;  /* pages that missed in the TLB */
+    double load_bytes;  /* bytes loaded */
+    double store_bytes; /* bytes stored */
+    double lines;       /* distinct lines touched by each op, summed */
+} cachesim_stats_t;
+
+/* Feed the accesses to the model? (the hooks in memtrace.h check this) */
+extern int cachesim_on;
+
+/* The source of the accesses fed to the model */
+extern int cachesim_source;
+
+/* A 32 KB 8-way cache with 64-byte lines, a 64-entry 4-way TLB */
+void cachesim_default_config(cachesim_config_t *config);
+
+/* Build a model of this geometry, or return -1 if it makes no sense */
+int cachesim_init(const cachesim_config_t *config);
+
+/* Empty the cache and the TLB and zero the counts. Addresses are
+   taken relative to base, so the counts don't depend on where the
+   heap happens to be mapped. */
+void cachesim_reset(const void *base);
+
+/* Feed an access of bytes bytes at addr to the model */
+void cachesim_access(const void *addr, size_t bytes, int write);
+
+/* End an op (a request): the next access starts counting distinct
+   lines afresh */
+void cachesim_end_op(void);
+
+/* The counts of source since the last reset */
+void cachesim_stats(int source, cachesim_stats_t *stats);
+
+#endif /* __CACHESIM_H_ */
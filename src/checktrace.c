@@ -0,0 +1,309 @@
+/*
+ * checktrace.c - Check traces for consistency and balance them
+ *
+ * Reads a trace in one streaming pass and checks that every request
+ * makes sense: no malloc of an id that is still allocated or was
+ * already freed, no realloc or free of an id that was never allocated
+ * or was already freed. If the trace is consistent, writes a balanced
+ * version of it, with a free appended for every block that is still
+ * allocated at the end (in increasing id order), and with the header
+ * counts fixed to match the requests.
+ *
+ * Only one byte of state is kept per id. The requests are spooled to
+ * a temporary file in the binary trace format until the header of the
+ * output is known, so the memory use does not depend on the length of
+ * the trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "tracestream.h"
+
+/**********************
+ * Constants and macros
+ **********************/
+#define MAXLINE  1024   /* max string size */
+
+/* The state of an id */
+#define UNUSED   0      /* never allocated */
+#define LIVE     1      /* allocated and not yet freed */
+#define FREED    2      /* freed */
+
+/********************
+ * Global variables
+ *******************/
+static unsigned char *state = NULL; /* state of each id, grown as needed */
+static unsigned num_state = 0;
+static int errors = 0;              /* inconsistent requests found */
+
+/*********************
+ * Function prototypes
+ *********************/
+static int check(tracestream_t *ts, trace_req_t *req);
+static void grow_state(unsigned index);
+static void request_error(tracestream_t *ts, char *msg, unsigned index);
+static void usage(void);
+static void unix_error(char *msg);
+static void app_error(char *msg);
+
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    tracestream_t in, spool, out;
+    trace_req_t req;
+    char spoolpath[MAXLINE], *tmpdir;
+    int summary = 0;   /* print only whether the trace is balanced (-s) */
+    int binary = 0;    /* write a binary trace (-b) */
+    char *inpath = "-", *outpath = "-";
+    long long live = 0, ops = 0;
+    unsigned max_index = 0, i;
+    int rc, fd;
+    char c;
+
+    while ((c = getopt(argc, argv, "bsh")) != EOF) {
+        switch (c) {
+	case 'b': /* Write the balanced trace in the binary format */
+	    binary = 1;
+	    break;
+	case 's': /* Emit only a brief summary */
+	    summary = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (argc - optind > 2 || (summary && argc - optind > 1)) {
+	usage();
+	exit(1);
+    }
+    if (optind < argc)
+	inpath = argv[optind];
+    if (optind + 1 < argc)
+	outpath = argv[optind+1];
+
+    if (trace_open(&in, inpath) < 0)
+	app_error(in.errmsg);
+
+    /* Spool the requests, unless only the summary is wanted */
+    if (!summary) {
+	if ((tmpdir = getenv("TMPDIR")) == NULL)
+	    tmpdir = "/tmp";
+	snprintf(spoolpath, MAXLINE, "%s/checktraceXXXXXX", tmpdir);
+	if ((fd = mkstemp(spoolpath)) < 0)
+	    unix_error("mkstemp of the spool file failed");
+	close(fd);
+	spool.sugg_heapsize = spool.num_ids = spool.num_ops = 0;
+	spool.weight = 0;
+	if (trace_create(&spool, spoolpath, 1) < 0) {
+	    unlink(spoolpath);
+	    app_error(spool.errmsg);
+	}
+    }
+
+    /* The one pass over the trace */
+    while ((rc = trace_next(&in, &req)) > 0) {
+	if (check(&in, &req) < 0)
+	    continue;
+	ops++;
+	if (req.type == TRACE_ALLOC)
+	    live++;
+	else if (req.type == TRACE_FREE)
+	    live--;
+	if (req.type != TRACE_FREE && req.index > max_index)
+	    max_index = req.index;
+	if (!summary && trace_write(&spool, &req) < 0) {
+	    unlink(spoolpath);
+	    app_error(spool.errmsg);
+	}
+    }
+    if (rc < 0) {
+	if (!summary)
+	    unlink(spoolpath);
+	app_error(in.errmsg);
+    }
+
+    if (summary) {
+	if (errors)
+	    printf("Inconsistent trace (%d errors).\n", errors);
+	else if (live == 0)
+	    printf("Balanced trace.\n");
+	else
+	    printf("Unbalanced trace (%lld blocks never freed).\n", live);
+	trace_close(&in);
+	exit(errors ? 1 : 0);
+    }
+
+    if (trace_finish(&spool) < 0) {
+	unlink(spoolpath);
+	app_error(spool.errmsg);
+    }
+    if (errors) {
+	unlink(spoolpath);
+	fprintf(stderr, "checktrace: %d errors, no output written\n", errors);
+	exit(1);
+    }
+
+    /* The header with the counts of the balanced trace */
+    out.sugg_heapsize = in.sugg_heapsize;
+    out.num_ids = (ops > 0) ? max_index + 1 : 0;
+    out.num_ops = ops + live;
+    out.weight = in.weight;
+    if (out.num_ids != in.num_ids || in.opnum != in.num_ops)
+	fprintf(stderr, "checktrace: header said %d ids and %d requests, "
+		"trace has %d ids and %lld requests\n", in.num_ids, 
+		in.num_ops, out.num_ids, in.opnum);
+    trace_close(&in);
+    if (trace_create(&out, outpath, binary) < 0) {
+	unlink(spoolpath);
+	app_error(out.errmsg);
+    }
+
+    /* Copy the requests from the spool, then balance the trace */
+    if (trace_open(&spool, spoolpath) < 0) {
+	unlink(spoolpath);
+	app_error(spool.errmsg);
+    }
+    unlink(spoolpath);
+    while ((rc = trace_next(&spool, &req)) > 0)
+	if (trace_write(&out, &req) < 0)
+	    app_error(out.errmsg);
+    if (rc < 0)
+	app_error(spool.errmsg);
+    trace_close(&spool);
+
+    req.type = TRACE_FREE;
+    req.size = 0;
+    for (i = 0; i < num_state; i++) {
+	if (state[i] == LIVE) {
+	    req.index = i;
+	    if (trace_write(&out, &req) < 0)
+		app_error(out.errmsg);
+	}
+    }
+    if (trace_finish(&out) < 0)
+	app_error(out.errmsg);
+    exit(0);
+}
+
+
+/*
+ * check - Check request req against the state of its id, and update
+ *     the state. Returns -1 if the request is inconsistent.
+ */
+static int check(tracestream_t *ts, trace_req_t *req)
+{
+    unsigned char *s;
+
+    grow_state(req->index);
+    s = &state[req->index];
+
+    switch (req->type) {
+    case TRACE_ALLOC:
+	if (*s == LIVE) {
+	    request_error(ts, "malloc of allocated id", req->index);
+	    return -1;
+	}
+	if (*s == FREED) {
+	    request_error(ts, "malloc of reused id", req->index);
+	    return -1;
+	}
+	*s = LIVE;
+	break;
+
+    case TRACE_REALLOC:
+	if (*s == UNUSED) {
+	    request_error(ts, "realloc of unknown id", req->index);
+	    return -1;
+	}
+	if (*s == FREED) {
+	    request_error(ts, "realloc of freed id", req->index);
+	    return -1;
+	}
+	break;
+
+    default: /* TRACE_FREE */
+	if (*s == UNUSED) {
+	    request_error(ts, "free of unknown id", req->index);
+	    return -1;
+	}
+	if (*s == FREED) {
+	    request_error(ts, "double free of id", req->index);
+	    return -1;
+	}
+	*s = FREED;
+	break;
+    }
+    return 0;
+}
+
+/*
+ * grow_state - Make room for the state of id index
+ */
+static void grow_state(unsigned index)
+{
+    unsigned old = num_state;
+
+    if (index < num_state)
+	return;
+    num_state = (num_state > 0) ? num_state : 1024;
+    while (num_state <= index)
+	num_state *= 2;
+    if ((state = (unsigned char *)realloc(state, num_state)) == NULL)
+	unix_error("realloc of the id states failed");
+    memset(state + old, UNUSED, num_state - old);
+}
+
+/*
+ * request_error - Report an inconsistent request, by line number in an
+ *     ASCII trace and by request number in a binary one
+ */
+static void request_error(tracestream_t *ts, char *msg, unsigned index)
+{
+    errors++;
+    if (ts->binary)
+	fprintf(stderr, "checktrace: ERROR[request %lld]: %s %u\n", 
+		ts->opnum - 1, msg, index);
+    else
+	fprintf(stderr, "checktrace: ERROR[line %lld]: %s %u\n", 
+		ts->linenum, msg, index);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: checktrace [-hbs] [<in> [<out>]]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b  Write the balanced trace in the binary format.\n");
+    fprintf(stderr, "\t-h  Print this message.\n");
+    fprintf(stderr, "\t-s  Emit only a brief summary.\n");
+    fprintf(stderr, "<in> and <out> default to stdin and stdout.\n");
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+/*
+ * app_error - Report an error and terminate
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "checktrace: %s\n", msg);
+    exit(1);
+}
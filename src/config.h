@@ -45,6 +45,14 @@
  */
 #define AVG_LIBC_THRUPUT      13869E3  /* 13869 Kops/sec */
 
+/*
+ * mdriver -L replaces the constant cap (AVG_LIBC_THRUPUT, or
+ * MODEL_LIBC_THRUPUT with -I) by the throughput of libc malloc on the
+ * host and traces at hand. Calibrations are cached in this file, one
+ * per CPU model, trace set, and throughput metric.
+ */
+#define LIBC_CACHE ".mdriver-libc"
+
  /* 
   * This constant determines the contributions of space utilization
   * (UTIL_WEIGHT) and throughput (1 - UTIL_WEIGHT) to the performance
@@ -52,16 +60,77 @@
   */
 #define UTIL_WEIGHT .60
 
+/*
+ * The throughput of the perf index is either measured (THRU_TIME), or
+ * computed from a cost model of the allocator's work (THRU_MODEL),
+ * which is far less noisy than the time. It is not exact: perf's count
+ * moves a little from run to run, and the instructions of libc calls
+ * such as memcpy depend on the variant glibc picks for the CPU.
+ * mdriver -I selects THRU_MODEL. The model charges
+ *
+ *   cycles = MODEL_INSN_CYCLES * retired instructions (perf_event)
+ *          + MODEL_MISS_CYCLES * cache misses of the allocator
+ *          + MODEL_TLB_CYCLES * TLB misses of the allocator
+ *
+ * per replay, where the misses come from the cache model and are only
+ * charged with -S (in mdriver-sim), and runs at MODEL_HZ cycles per
+ * second. MODEL_LIBC_THRUPUT is the cap of the modeled throughput,
+ * as AVG_LIBC_THRUPUT is of the measured one.
+ */
+#define THRU_TIME  0
+#define THRU_MODEL 1
+#define THRU_METRIC THRU_TIME
+
+#define MODEL_INSN_CYCLES   0.5     /* an IPC of 2 */
+#define MODEL_MISS_CYCLES   12      /* a miss in L1 served by L2 */
+#define MODEL_TLB_CYCLES    25      /* a page walk that hits the cache */
+#define MODEL_HZ            2E9     /* 2 GHz */
+#define MODEL_LIBC_THRUPUT  20000E3 /* 20000 Kops/sec */
+
 /* 
  * Alignment requirement in bytes (either 4 or 8) 
  */
 #define ALIGNMENT 8  
 
 /* 
- * Maximum heap size in bytes 
+ * Maximum heap size in bytes (the default for mdriver -H). memlib only
+ * reserves the address range; memory is committed as the heap grows.
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
+/*
+ * Limits on the evaluation of each trace. mdriver evaluates every
+ * trace in a child process (unless run with -X), and a trace whose
+ * evaluation takes longer fails with a timeout instead of hanging the
+ * driver. The wall-clock limit is TRACE_WALL_FACTOR times the CPU
+ * time limit, which mdriver -W replaces.
+ */
+#define TRACE_CPU_LIMIT   60  /* CPU secs */
+#define TRACE_WALL_FACTOR  2  /* wall-clock limit / CPU time limit */
+
+/*
+ * Default rate of the sampling profiler (-P), in samples per CPU
+ * second. A prime keeps the samples from beating with periodic work
+ * in the replay. The kernel may round it to its own tick rate.
+ */
+#define PROFILE_HZ 997
+
+/*
+ * The windowed replay (-w) flags the windows of a trace whose cycles
+ * per request exceed the median of its windows by this factor, unless
+ * -w gives a factor of its own.
+ */
+#define WINDOW_FACTOR 2.0
+
+/*
+ * The representative windows of -s and -e are timed in replays from a
+ * checkpoint this many requests (but at least one window) ahead of
+ * each, so that the requests before the window warm up the caches and
+ * the TLB again after the checkpoint is copied back. The bigger the
+ * heap, the longer that takes.
+ */
+#define SIMPOINT_WARMUP 1000000
+
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
@@ -22,6 +22,7 @@
 #define CLEAR_CACHE 0        /* Clear cache before running test function */
 #define CACHE_BYTES (1<<19)  /* Max cache size in bytes */
 #define CACHE_BLOCK 32       /* Cache block size in bytes */
+#define BUDGET 0             /* Cycles to spend sampling (0 = unlimited) */
 
 static int kbest = K;
 static int maxsamples = MAXSAMPLES;
@@ -30,12 +31,18 @@ static int compensate = COMPENSATE;
 static int clear_cache = CLEAR_CACHE;
 static int cache_bytes = CACHE_BYTES;
 static int cache_block = CACHE_BLOCK;
+static double budget = BUDGET;
+static test_funct prepare = NULL;
 
 static int *cache_buf = NULL;
 
 static double *values = NULL;
 static int samplecount = 0;
 
+/* Confidence of the last estimate returned by fcyc */
+static int last_samples = 0;
+static double last_spread = 0.0;
+
 /* for debugging only */
 #define KEEP_VALS 0
 #define KEEP_SAMPLES 0
@@ -97,6 +104,14 @@ static int has_converged()
 	((1 + epsilon)*values[0] >= values[kbest-1]);
 }
 
+/* 
+ * over_budget - Would another sample like the last one exceed the budget? 
+ */
+static int over_budget(double spent, double cyc)
+{
+    return (budget > 0) && (spent + cyc > budget);
+}
+
 /* 
  * clear - Code to clear cache 
  */
@@ -129,28 +144,50 @@ static void clear()
 double fcyc(test_funct f, void *argp)
 {
     double result;
+    double spent = 0;
+    double cyc;
+    int n;
+
     init_sampler();
+
+    /* Allocate and touch the cache-clearing buffer before any sample,
+       so that its page faults don't fall between prepare and f */
+    if (clear_cache)
+	clear();
+
     if (compensate) {
 	do {
-	    double cyc;
+	    if (prepare)
+		prepare(argp);
 	    if (clear_cache)
 		clear();
 	    start_comp_counter();
 	    f(argp);
 	    cyc = get_comp_counter();
 	    add_sample(cyc);
-	} while (!has_converged() && samplecount < maxsamples);
+	    spent += cyc;
+	} while (!has_converged() && samplecount < maxsamples &&
+		 !over_budget(spent, cyc));
     } else {
 	do {
-	    double cyc;
+	    if (prepare)
+		prepare(argp);
 	    if (clear_cache)
 		clear();
 	    start_counter();
 	    f(argp);
 	    cyc = get_counter();
 	    add_sample(cyc);
-	} while (!has_converged() && samplecount < maxsamples);
+	    spent += cyc;
+	} while (!has_converged() && samplecount < maxsamples &&
+		 !over_budget(spent, cyc));
     }
+
+    /* Remember how far apart the (up to) K best samples ended up */
+    n = (samplecount < kbest) ? samplecount : kbest;
+    last_samples = samplecount;
+    last_spread = (values[0] > 0) ? values[n-1]/values[0] - 1.0 : 0.0;
+
 #ifdef DEBUG
     {
 	int i;
@@ -168,6 +205,26 @@ double fcyc(test_funct f, void *argp)
 }
 
 
+/*
+ * get_fcyc_samples - Number of samples taken by the last call to fcyc
+ */
+int get_fcyc_samples(void)
+{
+    return last_samples;
+}
+
+/*
+ * get_fcyc_spread - Relative spread of the K best samples of the last
+ *     call to fcyc: (Kth best - best)/best. The estimate has converged
+ *     when at least K samples were taken and the spread is within
+ *     epsilon.
+ */
+double get_fcyc_spread(void)
+{
+    return last_spread;
+}
+
+
 /*************************************************************
  * Set the various parameters used by the measurement routines 
  ************************************************************/
@@ -245,6 +302,28 @@ void set_fcyc_epsilon(double epsilon_arg)
     epsilon = epsilon_arg;
 }
 
+/* 
+ * set_fcyc_prepare - Call prepare(argp) before every sample, outside
+ *     of the measured time. Used to put the system in the same state
+ *     before each sample.
+ *     Default = NULL (nothing is called)
+ */
+void set_fcyc_prepare(test_funct prepare_arg)
+{
+    prepare = prepare_arg;
+}
+
+/* 
+ * set_fcyc_budget - Stop sampling early, before K-best has converged,
+ *     when another sample would push the total number of cycles spent
+ *     on samples past this budget. At least one sample is always taken.
+ *     Default = 0 (no budget)
+ */
+void set_fcyc_budget(double cycles)
+{
+    budget = cycles;
+}
+
 
 
 
@@ -13,6 +13,18 @@ typedef void (*test_funct)(void *);
 /* Compute number of cycles used by test function f */
 double fcyc(test_funct f, void* argp);
 
+/* 
+ * set_fcyc_prepare - Call prepare(argp) before every sample, outside
+ *     of the measured time. NULL (the default) calls nothing.
+ */
+void set_fcyc_prepare(test_funct prepare);
+
+/* Number of samples taken by the last call to fcyc */
+int get_fcyc_samples(void);
+
+/* Relative spread (Kth best - best)/best of the last call to fcyc */
+double get_fcyc_spread(void);
+
 /*********************************************************
  * Set the various parameters used by measurement routines 
  *********************************************************/
@@ -63,6 +75,13 @@ void set_fcyc_maxsamples(int maxsamples_arg);
  */
 void set_fcyc_epsilon(double epsilon_arg);
 
+/* 
+ * set_fcyc_budget - Stop sampling when another sample would push the
+ *     total cycles spent sampling past this budget.
+ *     Default = 0 (no budget)
+ */
+void set_fcyc_budget(double cycles);
+
 
 
 
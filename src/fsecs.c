@@ -9,8 +9,12 @@
 #include "config.h"
 
 static double Mhz;  /* estimated CPU clock frequency */
+static double budget = 0;   /* max secs to spend in fsecs (0 = no limit) */
+static int samples = 0;     /* samples taken by the last call to fsecs */
+static double spread = 0.0; /* relative spread of those samples */
+static fsecs_test_funct prepare = NULL; /* called before f is timed */
 
-extern int verbose; /* -v option in mdriver.c */
+extern int mdriver_verbose; /* -v option, set by mdriver.c */
 
 /*
  * init_fsecs - initialize the timing package
@@ -20,7 +24,7 @@ void init_fsecs(void)
     Mhz = 0; /* keep gcc -Wall happy */
 
 #if USE_FCYC
-    if (verbose)
+    if (mdriver_verbose)
 	printf("Measuring performance with a cycle counter.\n");
 
     /* set key parameters for the fcyc package */
@@ -29,12 +33,12 @@ void init_fsecs(void)
     set_fcyc_compensate(1);
     set_fcyc_epsilon(0.01);
     set_fcyc_k(3);
-    Mhz = mhz(verbose > 0);
+    Mhz = mhz(mdriver_verbose > 0);
 #elif USE_ITIMER
-    if (verbose)
+    if (mdriver_verbose)
 	printf("Measuring performance with the interval timer.\n");
 #elif USE_GETTOD
-    if (verbose)
+    if (mdriver_verbose)
 	printf("Measuring performance with gettimeofday().\n");
 #endif
 }
@@ -45,13 +49,96 @@ void init_fsecs(void)
 double fsecs(fsecs_test_funct f, void *argp) 
 {
 #if USE_FCYC
-    double cycles = fcyc(f, argp);
+    double cycles;
+
+    set_fcyc_budget(budget*Mhz*1e6);
+    cycles = fcyc(f, argp);
+    samples = get_fcyc_samples();
+    spread = get_fcyc_spread();
     return cycles/(Mhz*1e6);
-#elif USE_ITIMER
-    return ftimer_itimer(f, argp, 10);
+#else
+    /* 
+     * The timers average n runs. With a budget, time one run first and
+     * average only as many more as fit in the rest of the budget.
+     */
+    double secs;
+    int n = 10;
+
+    spread = -1.0; /* unknown: the timers only report the average */
+    if (prepare)
+	prepare(argp);
+    if (budget > 0) {
+#if USE_ITIMER
+	secs = ftimer_itimer(f, argp, 1);
+#elif USE_GETTOD
+	secs = ftimer_gettod(f, argp, 1);
+#endif
+	n = (secs > 0) ? (int)((budget - secs)/secs) : 10;
+	if (n < 1) {
+	    samples = 1;
+	    return secs;
+	}
+	if (n > 10)
+	    n = 10;
+    }
+    samples = n;
+#if USE_ITIMER
+    return ftimer_itimer(f, argp, n);
 #elif USE_GETTOD
-    return ftimer_gettod(f, argp, 10);
+    return ftimer_gettod(f, argp, n);
+#endif
 #endif 
 }
 
+/*
+ * set_fsecs_budget - Limit the time that each call to fsecs spends
+ *     running f to about secs seconds (0 = no limit)
+ */
+void set_fsecs_budget(double secs)
+{
+    budget = secs;
+}
+
+/*
+ * set_fsecs_prepare - Call prepare(argp) before f is timed, outside of
+ *     the measured time. The cycle counter calls it before every
+ *     sample. The timers average several runs of f in one measurement,
+ *     so they call it only once, before the first run.
+ */
+void set_fsecs_prepare(fsecs_test_funct prepare_arg)
+{
+    prepare = prepare_arg;
+#if USE_FCYC
+    set_fcyc_prepare(prepare_arg);
+#endif
+}
+
+/*
+ * get_fsecs_mhz - Return the clock rate that init_fsecs estimated, or 0
+ *     if the timing package doesn't use the cycle counter
+ */
+double get_fsecs_mhz(void)
+{
+    return Mhz;
+}
+
+/*
+ * get_fsecs_samples - Return the number of times the last call to
+ *     fsecs ran f
+ */
+int get_fsecs_samples(void)
+{
+    return samples;
+}
+
+/*
+ * get_fsecs_spread - Return the relative spread of the best samples
+ *     taken by the last call to fsecs, or a negative value if the
+ *     timing method does not know it
+ */
+double get_fsecs_spread(void)
+{
+    return spread;
+}
+
 
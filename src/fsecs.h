@@ -2,3 +2,16 @@ typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+
+/* Limit the time fsecs spends measuring f (0 = no limit) */
+void set_fsecs_budget(double secs);
+
+/* Call prepare(argp) before running f, outside of the measured time */
+void set_fsecs_prepare(fsecs_test_funct prepare);
+
+/* Estimated CPU clock rate in MHz (0 unless the cycle counter is used) */
+double get_fsecs_mhz(void);
+
+/* Samples taken by the last call to fsecs, and their relative spread */
+int get_fsecs_samples(void);
+double get_fsecs_spread(void);
@@ -0,0 +1,2577 @@
+/*
+ * libmdriver.c - The malloc lab evaluation library
+ *
+ * Loads trace files and evaluates the correctness, space utilization,
+ * and throughput of any allocator described by an mdriver_allocator_t
+ * on them. See libmdriver.h for the API.
+ *
+ * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
+ * May not be used, modified, or copied without permission.
+ */
+#define _GNU_SOURCE /* for tdestroy */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <setjmp.h>
+#include <limits.h>
+#include <search.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "libmdriver.h"
+#include "memlib.h"
+#include "fsecs.h"
+#include "ftimer.h"
+#include "clock.h"
+#include "config.h"
+#include "tracestream.h"
+#include "perfctr.h"
+#include "cachesim.h"
+#include "profile.h"
+#include "simpoint.h"
+
+/**********************
+ * Constants and macros
+ **********************/
+
+/* Misc */
+#define MAXLINE     MDRIVER_MAXLINE /* max string size */
+#define NULL_ARENA  4096 /* size of the address range the null allocator uses */
+#define PREFETCH_DIST  8 /* packed ops to look ahead for blocks[] prefetches */
+
+/* Sizing replays to fit a time budget */
+#define PILOT_OPS   1024 /* length of the first trace prefix that is timed */
+#define PILOT_SHARE  100 /* pilot replays get 1/PILOT_SHARE of the budget */
+#define MIN_SAMPLES    3 /* samples a budgeted replay leaves room for */
+
+/* The payload-touch replay and its default access model */
+#define TOUCH_RUNS     3 /* replays, of which the fastest is reported */
+#define TOUCH_STRIDE   8 /* touch every word of a payload */
+#define TOUCH_PERIOD  16 /* re-touch recent blocks every 16 requests */
+#define TOUCH_RECENT   8 /* ... the 8 most recently allocated ones */
+
+/* The features of a window that mdriver_simpoints clusters on */
+#define SIMPOINT_CLASSES 16 /* size classes (all from 2^15 on in the last) */
+#define SIMPOINT_DIM (3 + SIMPOINT_CLASSES + 1) /* + types and live bytes */
+
+/* Returns true if p is ALIGNMENT-byte aligned */
+#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+
+/******************************
+ * The key compound data types
+ *****************************/
+
+/* Records the extent of each block's payload */
+typedef struct range_t {
+    char *lo;              /* low payload address */
+    char *hi;              /* high payload address */
+} range_t;
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    enum {ALLOC, FREE, REALLOC} type; /* type of request */
+    int index;                        /* index for free() to use later */
+    int size;                         /* byte size of alloc/realloc request */
+} traceop_t;
+
+/*
+ * The timed replay loops use a pre-decoded copy of the trace in which
+ * every request is packed into 8 bytes: the request type is folded
+ * into the two low bits of the index word.
+ */
+typedef struct {
+    unsigned int op;    /* (index << 2) | type */
+    unsigned int size;  /* byte size of alloc/realloc request */
+} packedop_t;
+
+#define PACK_OP(type, index) ((((unsigned int)(index)) << 2) | (type))
+#define OP_TYPE(op)          ((op) & 0x3)
+#define OP_INDEX(op)         ((op) >> 2)
+
+/* One request of the per-request timeline written by mdriver_write_events */
+typedef struct {
+    int opnum;        /* request number in the trace */
+    int type;         /* ALLOC, FREE, or REALLOC */
+    int size;         /* payload size of the block */
+    long offset;      /* payload offset from the start of the heap */
+    double start;     /* cycles from the start of the replay */
+    double cycles;    /* cycles the request took */
+    size_t heapsize;  /* heap size after the request */
+} event_t;
+
+/* Holds the information for one trace file*/
+struct mdriver_trace {
+    int sugg_heapsize;   /* suggested heap size */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests (at most INT_MAX) */
+    int weight;          /* weight for this trace in aggregate results */
+    traceop_t *ops;      /* array of requests */
+    packedop_t *packed;  /* ... and the same requests, packed for replay */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+};
+typedef mdriver_trace_t trace_t;
+
+/* A checkpoint of a memlib allocator part way through a trace */
+struct mdriver_checkpoint {
+    char alloc[MAXLINE];  /* name of the allocator */
+    unsigned long long hash; /* of the requests of the trace */
+    long long num_ops;    /* number of requests in the trace */
+    int num_ids;          /* number of alloc/realloc ids */
+    long long opnum;      /* requests replayed before the checkpoint */
+    char *heap_lo;        /* where the heap was */
+    size_t heapsize;      /* ... its size */
+    char *heap;           /* ... and its contents */
+    size_t statesize;     /* size of the allocator's state (0: none) */
+    char *state;          /* ... as save_state copied it */
+    char **blocks;        /* blocks[] of the trace (NULL: not live) */
+    size_t *block_sizes;  /* ... and block_sizes[] */
+    double total_size;    /* payload bytes of the live blocks */
+    double max_total_size; /* ... at most, up to the checkpoint */
+};
+
+/* The first line of a checkpoint file */
+#define CHECKPOINT_MAGIC "mdriver checkpoint 3\n"
+
+/*
+ * Holds the params to the eval_speed function, which is timed by fcyc.
+ * This struct is necessary because fcyc accepts only a pointer array
+ * as input.
+ */
+typedef struct {
+    const mdriver_allocator_t *alloc;
+    trace_t *trace;
+    int first;       /* replay from this request on (a checkpoint's) */
+    int last;        /* ... up to this one (the end of the trace) */
+    int num_ops;     /* replay only this many requests (a prefix of those) */
+    int heap_mode;   /* what happens to the heap's pages before a sample */
+    size_t prefault; /* bytes of the heap mapped by HEAP_PREFAULT */
+    const mdriver_checkpoint_t *checkpoint; /* if set, start from here */
+    int restored;    /* has prepare_speed restored it already? */
+    int whole;       /* also time the whole replay once, to scale the prefix */
+    int dirty;       /* did a prefix replay leave blocks allocated? */
+    struct rusage mark; /* page faults when prepare_speed returned ... */
+    int marked;      /* ... (if set), and those counted since, */
+    double minflt;   /* summed over the samples: minor faults */
+    double majflt;   /* ... and major faults */
+} speed_t;
+
+/* Heap modes: what prepare_speed does before each timed sample */
+#define HEAP_REUSE    0 /* nothing: pages stay mapped from the last run */
+#define HEAP_PREFAULT 1 /* map the pages the trace will need */
+#define HEAP_DISCARD  2 /* unmap all pages, so the run faults them in */
+
+/********************
+ * Global variables
+ *******************/
+int mdriver_verbose = 0; /* global flag for verbose output */
+static char errbuf[MAXLINE]; /* why the last library call failed */
+
+/* Where a failed request in a timed replay returns to */
+static jmp_buf fail_env;
+static char failmsg[MAXLINE];
+
+/* Where the evaluation is (see mdriver_set_progress) */
+static mdriver_progress_t no_progress;
+static mdriver_progress_t *progress = &no_progress;
+
+/* Where the payload-touch replay sums the bytes it reads */
+static volatile int touch_sink;
+
+/* Where libc's heap started, so the cache model sees libc's addresses
+   relative to it rather than where ASLR put them */
+static void *libc_heap_lo;
+
+
+/*********************
+ * Function prototypes
+ *********************/
+
+/* these functions build trace records */
+static int alloc_trace(trace_t *trace);
+static void pack_trace(trace_t *trace);
+static void scale_op(trace_t *scaled, int i, const traceop_t *op, int base);
+
+/* these functions manipulate range trees */
+static int add_range(void **ranges, char *lo, int size,
+		     mdriver_result_t *result, int opnum);
+static void remove_range(void **ranges, char *lo);
+static void clear_ranges(void **ranges);
+
+/* Routines for evaluating correctness, space utilization, and speed */
+static int eval_valid(const mdriver_allocator_t *alloc, trace_t *trace,
+		      int check_heap, mdriver_result_t *result,
+		      void **ranges, const mdriver_checkpoint_t *ckpt,
+		      int stop);
+static int eval_complete(const mdriver_allocator_t *alloc, trace_t *trace,
+			 mdriver_result_t *result);
+static double eval_util(const mdriver_allocator_t *alloc, trace_t *trace,
+			const mdriver_checkpoint_t *ckpt, int stop);
+static void eval_speed(void *ptr);
+static void prepare_speed(void *ptr);
+static void free_prefix(speed_t *params);
+static void count_faults(speed_t *params);
+
+/* The null allocator used for calibrating the driver's replay loop */
+static int null_init(void);
+static void *null_malloc(size_t size);
+static void null_free(void *ptr);
+static void *null_realloc(void *ptr, size_t size);
+
+/* Routines for checkpoints */
+static int restore_checkpoint(const mdriver_allocator_t *alloc,
+			      trace_t *trace,
+			      const mdriver_checkpoint_t *ckpt);
+static unsigned long long trace_hash(const trace_t *trace);
+
+/* Routines for picking and timing representative windows */
+static int cmp_simpoints(const void *a, const void *b);
+static void time_simpoint_runs(const mdriver_allocator_t *alloc,
+			       trace_t *trace,
+			       const mdriver_checkpoint_t *ckpt, int first,
+			       int last, size_t prefault, double *secs);
+static void replay_range(const mdriver_allocator_t *alloc, trace_t *trace,
+			 int first, int nops);
+
+/* Routines for timing the replays of a trace within a time budget */
+static void plan_replay(speed_t *params, double budget);
+static double time_trace(speed_t *params, mdriver_result_t *result,
+			 mdriver_faults_t *pgfaults);
+
+/* Routines for the per-request timeline and the windowed replay */
+static void record_requests(const mdriver_allocator_t *alloc,
+			    trace_t *trace, event_t *events,
+			    mdriver_opcost_t *opcost,
+			    mdriver_window_t *windows, int window);
+static int size_class(int size);
+static void write_json_string(FILE *fp, const char *s);
+
+/* Routines for the payload-touch replay */
+static void eval_touch(const mdriver_allocator_t *alloc, trace_t *trace,
+		       const mdriver_access_t *access,
+		       mdriver_result_t *result);
+static void touch_requests(const mdriver_allocator_t *alloc, trace_t *trace,
+			   const mdriver_access_t *access, int *recent,
+			   int simulate);
+static int *recent_ring(const mdriver_access_t *access);
+static void sim_payload(char *p, int size, int stride, int write);
+
+/* Routines for counting instructions */
+static void eval_insns(const mdriver_allocator_t *alloc, trace_t *trace,
+		       mdriver_result_t *result);
+static double count_insns(int ctr, const mdriver_allocator_t *alloc,
+			  trace_t *trace);
+
+/* The cache model pass */
+static void eval_sim(const mdriver_allocator_t *alloc, trace_t *trace,
+		     const mdriver_options_t *opts, mdriver_result_t *result);
+
+/* Various helper routines */
+static void set_phase(int phase);
+static void malloc_error(mdriver_result_t *result, int opnum, char *msg);
+static void replay_error(char *msg);
+
+/* The allocators the library knows about */
+const mdriver_allocator_t mdriver_libc_allocator = {
+    "libc", NULL, malloc, free, realloc, NULL, NULL, 0, NULL, NULL
+};
+const mdriver_allocator_t mdriver_null_allocator = {
+    "null", null_init, null_malloc, null_free, null_realloc, NULL, NULL, 0,
+    NULL, NULL
+};
+
+/***********************
+ * The library interface
+ ***********************/
+
+/*
+ * mdriver_init - Initialize the timing package and the simulated
+ *     memory system in memlib.c. Call this once before anything else.
+ */
+int mdriver_init(void)
+{
+    init_fsecs();
+    mem_init();
+    libc_heap_lo = sbrk(0);
+    return 0;
+}
+
+/*
+ * mdriver_set_heap_limit - Give memlib allocators a heap of bytes bytes
+ *     instead of MAX_HEAP
+ */
+int mdriver_set_heap_limit(size_t bytes)
+{
+    if (bytes == 0 || mem_set_max_heap(bytes) < 0) {
+	sprintf(errbuf, "Could not allocate a heap of %lu bytes",
+		(unsigned long)bytes);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * mdriver_set_progress - Report the progress of evaluations in *p
+ *     from now on (NULL: don't report it)
+ */
+void mdriver_set_progress(mdriver_progress_t *p)
+{
+    progress = p ? p : &no_progress;
+}
+
+/*
+ * mdriver_default_options - Check correctness, and measure space
+ *     utilization and throughput like mdriver does by default
+ */
+void mdriver_default_options(mdriver_options_t *opts)
+{
+    memset(opts, 0, sizeof(mdriver_options_t));
+    opts->util = 1;
+    opts->time = 1;
+    opts->access.stride = TOUCH_STRIDE;
+    opts->access.write_alloc = 1;
+    opts->access.period = TOUCH_PERIOD;
+    opts->access.recent = TOUCH_RECENT;
+    opts->access.read_free = 1;
+    cachesim_default_config(&opts->geometry);
+    opts->profile_hz = PROFILE_HZ;
+}
+
+/*
+ * mdriver_error - Explain why the last call that returned NULL or -1
+ *     failed
+ */
+const char *mdriver_error(void)
+{
+    return errbuf;
+}
+
+/*
+ * mdriver_trace_num_ops - Return the number of requests in a trace
+ */
+int mdriver_trace_num_ops(const mdriver_trace_t *trace)
+{
+    return trace->num_ops;
+}
+
+/*
+ * mdriver_trace_info - Return the header of a trace
+ */
+void mdriver_trace_info(const mdriver_trace_t *trace, 
+			mdriver_trace_info_t *info)
+{
+    info->sugg_heapsize = trace->sugg_heapsize;
+    info->num_ids = trace->num_ids;
+    info->num_ops = trace->num_ops;
+    info->weight = trace->weight;
+}
+
+/*
+ * mdriver_eval - Evaluate the allocator alloc on trace. First check
+ *     that the allocator processes the trace correctly, then (as the
+ *     options say) measure its space utilization and throughput.
+ *     Returns result->valid, or -1 if the arguments make no sense.
+ */
+int mdriver_eval(const mdriver_allocator_t *alloc, mdriver_trace_t *trace,
+		 const mdriver_options_t *opts, mdriver_result_t *result)
+{
+    static void *ranges = NULL; /* block extents for one trace */
+    speed_t speed_params;          /* input parameters to eval_speed */
+    const mdriver_checkpoint_t *ckpt;
+    long long first, last;         /* the requests replayed */
+
+    if (!alloc || !alloc->malloc || !alloc->free || !alloc->realloc ||
+	!trace || !opts || !result) {
+	strcpy(errbuf, "mdriver_eval: missing allocator function or argument");
+	return -1;
+    }
+    if (opts->touch && (opts->access.stride < 1 || opts->access.period < 0 ||
+			opts->access.recent < 0)) {
+	strcpy(errbuf, "mdriver_eval: bad access model for the touch replay");
+	return -1;
+    }
+    if (opts->simulate && cachesim_init(&opts->geometry) < 0) {
+	strcpy(errbuf, "mdriver_eval: bad cache or TLB geometry");
+	return -1;
+    }
+    if (opts->profile && (!profile_available() || USE_ITIMER ||
+			  opts->profile_hz <= 0)) {
+	strcpy(errbuf, "mdriver_eval: can't profile (needs Linux on x86, "
+	       "ITIMER_PROF unused by the timer, and a positive rate)");
+	return -1;
+    }
+    ckpt = opts->checkpoint;
+    first = ckpt ? ckpt->opnum : 0;
+    last = (opts->last > 0) ? opts->last : trace->num_ops;
+    if (last < first || last > trace->num_ops ||
+	(last < trace->num_ops && !alloc->uses_memlib)) {
+	strcpy(errbuf, "mdriver_eval: bad last request, or not a memlib "
+	       "allocator");
+	return -1;
+    }
+    if (ckpt && (!alloc->uses_memlib || strcmp(ckpt->alloc, alloc->name) ||
+		 ckpt->num_ops != trace->num_ops ||
+		 ckpt->num_ids != trace->num_ids ||
+		 ckpt->hash != trace_hash(trace))) {
+	strcpy(errbuf, "mdriver_eval: the checkpoint is of another allocator "
+	       "or trace");
+	return -1;
+    }
+    if (ckpt && (!alloc->save_state || !alloc->restore_state)) {
+	snprintf(errbuf, MAXLINE, "mdriver_eval: allocator %.100s has no "
+		 "save_state and restore_state for checkpoints", alloc->name);
+	return -1;
+    }
+    if ((ckpt || opts->last) &&
+	(opts->faults || opts->fresh_heap || opts->opcost || opts->touch ||
+	 opts->insns || opts->simulate)) {
+	strcpy(errbuf, "mdriver_eval: a checkpoint or last request only works "
+	       "with the util, time, check_heap, and profile options");
+	return -1;
+    }
+
+    memset(result, 0, sizeof(mdriver_result_t));
+    result->ops = last - first;
+    result->errop = -1;
+
+    /* Failed requests during timed replays come back here */
+    if (setjmp(fail_env)) {
+	set_phase(MDRIVER_IDLE);
+	cachesim_on = 0;
+	profile_armed = 0;
+	profile_stop();
+	result->valid = 0;
+	result->errop = -1;
+	strcpy(result->errmsg, failmsg);
+	return 0;
+    }
+
+    if (mdriver_verbose > 1)
+	printf("Checking %s malloc for correctness, ", alloc->name);
+    set_phase(MDRIVER_CHECK);
+    if (alloc->uses_memlib)
+	result->valid = eval_valid(alloc, trace, opts->check_heap,
+				   result, &ranges, ckpt, last);
+    else
+	result->valid = eval_complete(alloc, trace, result);
+    if (!result->valid) {
+	set_phase(MDRIVER_IDLE);
+	return 0;
+    }
+    if (alloc->uses_memlib)
+	result->heapsize = mem_heapsize();
+
+    if (opts->util && alloc->uses_memlib) {
+	if (mdriver_verbose > 1)
+	    printf("efficiency, ");
+	set_phase(MDRIVER_UTIL);
+	result->util = eval_util(alloc, trace, ckpt, last);
+	if (alloc->stats)
+	    alloc->stats(&result->heap);
+    }
+
+    if (opts->time) {
+	if (mdriver_verbose > 1)
+	    printf("and performance.\n");
+	set_phase(MDRIVER_TIME);
+	set_fsecs_budget(opts->budget);
+	speed_params.alloc = alloc;
+	speed_params.trace = trace;
+	speed_params.heap_mode = HEAP_REUSE;
+	speed_params.first = first;
+	speed_params.last = last;
+	speed_params.checkpoint = ckpt;
+	speed_params.restored = 0;
+	speed_params.dirty = 0;
+	speed_params.prefault = result->heapsize;
+	if ((size_t)trace->sugg_heapsize > speed_params.prefault)
+	    speed_params.prefault = trace->sugg_heapsize;
+	set_fsecs_prepare(prepare_speed);
+	plan_replay(&speed_params, opts->budget);
+	if (opts->profile) {
+	    profile_reset();
+	    profile_start(opts->profile_hz, __builtin_frame_address(0));
+	}
+	result->secs = time_trace(&speed_params, result, &result->pgfaults);
+	if (opts->profile) {
+	    profile_stop();
+	    result->profiled = profile_samples(NULL);
+	}
+	if (opts->calibrate) {
+	    speed_params.alloc = &mdriver_null_allocator;
+	    speed_params.heap_mode = HEAP_REUSE;
+	    result->ovhd = time_trace(&speed_params, NULL, NULL);
+	}
+
+	/* Time the trace again with and without page faults */
+	if (opts->faults && alloc->uses_memlib) {
+	    speed_params.alloc = alloc;
+	    speed_params.heap_mode = HEAP_PREFAULT;
+	    result->secs_prefault = time_trace(&speed_params, NULL,
+					       &result->pgfaults_prefault);
+	    speed_params.heap_mode = HEAP_DISCARD;
+	    result->secs_discard = time_trace(&speed_params, NULL,
+					      &result->pgfaults_discard);
+	}
+
+	/* ... or only with a fresh heap for every sample */
+	else if (opts->fresh_heap && alloc->uses_memlib) {
+	    speed_params.alloc = alloc;
+	    speed_params.heap_mode = HEAP_DISCARD;
+	    result->secs_discard = time_trace(&speed_params, NULL,
+					      &result->pgfaults_discard);
+	}
+	set_fsecs_prepare(NULL);
+    }
+    else if (mdriver_verbose > 1)
+	printf("\n");
+
+    /* Where do the cycles go: malloc, free, or realloc? */
+    if (opts->opcost) {
+	if (mdriver_verbose > 1)
+	    printf("Attributing cycles to request types.\n");
+	set_phase(MDRIVER_INSTRUMENT);
+	record_requests(alloc, trace, NULL, result->opcost, NULL, 0);
+    }
+
+    /* What do the application's accesses cost with this placement? */
+    if (opts->touch) {
+	if (mdriver_verbose > 1)
+	    printf("Replaying with payload touches.\n");
+	set_phase(MDRIVER_INSTRUMENT);
+	eval_touch(alloc, trace, &opts->access, result);
+    }
+
+    /* Work that doesn't depend on the load of the machine */
+    if (opts->insns) {
+	if (mdriver_verbose > 1)
+	    printf("Counting instructions.\n");
+	set_phase(MDRIVER_INSTRUMENT);
+	eval_insns(alloc, trace, result);
+    }
+
+    /* The same accesses on any machine: misses in the cache model */
+    if (opts->simulate) {
+	if (mdriver_verbose > 1)
+	    printf("Replaying through the cache model.\n");
+	set_phase(MDRIVER_INSTRUMENT);
+	eval_sim(alloc, trace, opts, result);
+    }
+
+    set_phase(MDRIVER_IDLE);
+    return result->valid;
+}
+
+
+/*****************************************************************
+ * The following routines manipulate the range tree, which keeps
+ * track of the extent of every allocated block payload. We use the
+ * range tree to detect any overlapping allocated blocks. It is a
+ * tsearch(3) tree ordered by address, in which two ranges compare
+ * equal if they overlap, so a lookup finds any payload that overlaps
+ * a new one in O(log n) time.
+ ****************************************************************/
+
+/*
+ * cmp_ranges - Order two ranges by address, or call them equal if they
+ *     overlap
+ */
+static int cmp_ranges(const void *a, const void *b)
+{
+    const range_t *ra = (const range_t *)a, *rb = (const range_t *)b;
+
+    if (ra->hi < rb->lo)
+	return -1;
+    if (ra->lo > rb->hi)
+	return 1;
+    return 0;
+}
+
+/*
+ * add_range - As directed by request opnum, we've just called the
+ *     allocator's malloc to allocate a block of size bytes at addr lo.
+ *     After checking the block for correctness, we create a range
+ *     struct for this block and add it to the range tree.
+ */
+static int add_range(void **ranges, char *lo, int size,
+		     mdriver_result_t *result, int opnum)
+{
+    char *hi = lo + size - 1;
+    range_t *p, key;
+    void *node;
+    char msg[MAXLINE];
+
+    /* Payload addresses must be ALIGNMENT-byte aligned */
+    if (!IS_ALIGNED(lo)) {
+	sprintf(msg, "Payload address (%p) not aligned to %d bytes",
+		lo, ALIGNMENT);
+        malloc_error(result, opnum, msg);
+        return 0;
+    }
+
+    /* The payload must lie within the extent of the heap */
+    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
+		lo, hi, mem_heap_lo(), mem_heap_hi());
+	malloc_error(result, opnum, msg);
+        return 0;
+    }
+
+    /* The payload must not overlap any other payloads (a zero-size
+       payload still occupies its first byte here) */
+    key.lo = lo;
+    key.hi = (hi < lo) ? lo : hi;
+    if ((node = tfind(&key, ranges, cmp_ranges)) != NULL) {
+	p = *(range_t **)node;
+	sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+		lo, hi, p->lo, p->hi);
+	malloc_error(result, opnum, msg);
+	return 0;
+    }
+
+    /*
+     * Everything looks OK, so remember the extent of this block
+     * by creating a range struct and adding it the range tree.
+     */
+    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL) {
+	malloc_error(result, opnum, "malloc error in add_range");
+	return 0;
+    }
+    *p = key;
+    if (tsearch(p, ranges, cmp_ranges) == NULL) {
+	free(p);
+	malloc_error(result, opnum, "malloc error in add_range");
+	return 0;
+    }
+    return 1;
+}
+
+/*
+ * remove_range - Free the range record of block whose payload starts at lo
+ */
+static void remove_range(void **ranges, char *lo)
+{
+    range_t *p, key;
+    void *node;
+
+    key.lo = key.hi = lo;
+    if ((node = tfind(&key, ranges, cmp_ranges)) != NULL &&
+	(p = *(range_t **)node)->lo == lo) {
+	tdelete(&key, ranges, cmp_ranges);
+	free(p);
+    }
+}
+
+/*
+ * clear_ranges - free all of the range records for a trace
+ */
+static void clear_ranges(void **ranges)
+{
+    tdestroy(*ranges, free);
+    *ranges = NULL;
+}
+
+
+/**********************************************
+ * The following routines manipulate tracefiles
+ *********************************************/
+
+/*
+ * mdriver_read_trace - read a trace file and store it in memory
+ */
+mdriver_trace_t *mdriver_read_trace(const char *path)
+{
+    tracestream_t ts;
+    trace_req_t req;
+    trace_t *trace;
+    unsigned max_index = 0;
+    unsigned op_index;
+    int rc;
+
+    /* Allocate the trace record */
+    if ((trace = (trace_t *) calloc(1, sizeof(trace_t))) == NULL) {
+	sprintf(errbuf, "malloc 1 failed in read_trace: %s", strerror(errno));
+	return NULL;
+    }
+
+    /* Read the trace file header (ASCII or binary) */
+    if (trace_open(&ts, path) < 0) {
+	snprintf(errbuf, MAXLINE, "%.900s in read_trace", ts.errmsg);
+	free(trace);
+	return NULL;
+    }
+    trace->sugg_heapsize = ts.sugg_heapsize;
+    trace->num_ids = ts.num_ids;
+    trace->num_ops = ts.num_ops;
+    trace->weight = ts.weight;
+    if (trace->num_ids < 0 || trace->num_ops < 0) {
+	sprintf(errbuf, "Bad header in tracefile %s", path);
+	trace_close(&ts);
+	free(trace);
+	return NULL;
+    }
+
+    if (alloc_trace(trace) < 0) {
+	trace_close(&ts);
+	mdriver_free_trace(trace);
+	return NULL;
+    }
+
+    /* read every request in the trace file */
+    op_index = 0;
+    while ((rc = trace_next(&ts, &req)) > 0) {
+	if (op_index == trace->num_ops) {
+	    sprintf(errbuf, "More than %d requests in tracefile %s",
+		    trace->num_ops, path);
+	    goto bad;
+	}
+	switch(req.type) {
+	case TRACE_ALLOC:
+	    trace->ops[op_index].type = ALLOC;
+	    break;
+	case TRACE_REALLOC:
+	    trace->ops[op_index].type = REALLOC;
+	    break;
+	default:
+	    trace->ops[op_index].type = FREE;
+	    break;
+	}
+	trace->ops[op_index].index = req.index;
+	trace->ops[op_index].size = req.size;
+	if (req.type != TRACE_FREE)
+	    max_index = (req.index > max_index) ? req.index : max_index;
+	if (req.index >= trace->num_ids) {
+	    sprintf(errbuf, "Request id %u out of range in tracefile %s",
+		    req.index, path);
+	    goto bad;
+	}
+	op_index++;
+    }
+    if (rc < 0) {
+	snprintf(errbuf, MAXLINE, "%.500s in tracefile %.500s", ts.errmsg, path);
+	goto bad;
+    }
+    if (op_index != trace->num_ops ||
+	(trace->num_ids > 0 && max_index != trace->num_ids - 1)) {
+	sprintf(errbuf, "Header of tracefile %s doesn't match its requests",
+		path);
+	goto bad;
+    }
+    trace_close(&ts);
+    pack_trace(trace);
+    return trace;
+
+ bad:
+    trace_close(&ts);
+    mdriver_free_trace(trace);
+    return NULL;
+}
+
+/*
+ * mdriver_scale_trace - Build a trace that replays copies copies of
+ *     trace in one heap. Copy c uses the ids of trace shifted by
+ *     c*num_ids, so the copies are independent. The requests of the
+ *     copies are interleaved round-robin, or (MDRIVER_RANDOM) in a
+ *     random order that keeps the order of the requests of each copy.
+ */
+mdriver_trace_t *mdriver_scale_trace(const mdriver_trace_t *trace,
+				     int copies, int interleave,
+				     unsigned seed)
+{
+    trace_t *scaled;
+    int *next, *active;  /* next request of each copy, unfinished copies */
+    int nactive, i, j, c;
+
+    if (!trace || copies < 1 ||
+	(trace->num_ops > 0 && copies > INT_MAX / trace->num_ops) ||
+	(trace->num_ids > 0 && copies > INT_MAX / 4 / trace->num_ids)) {
+	strcpy(errbuf, "mdriver_scale_trace: bad trace or number of copies");
+	return NULL;
+    }
+    if ((scaled = (trace_t *) calloc(1, sizeof(trace_t))) == NULL) {
+	sprintf(errbuf, "malloc failed in scale_trace: %s", strerror(errno));
+	return NULL;
+    }
+    scaled->sugg_heapsize = (trace->sugg_heapsize < INT_MAX / copies) ?
+	trace->sugg_heapsize * copies : INT_MAX;
+    scaled->num_ids = trace->num_ids * copies;
+    scaled->num_ops = trace->num_ops * copies;
+    scaled->weight = trace->weight;
+    next = (int *)calloc(copies, sizeof(int));
+    active = (int *)malloc(copies * sizeof(int));
+    if (!next || !active || alloc_trace(scaled) < 0) {
+	if (!next || !active)
+	    sprintf(errbuf, "malloc failed in scale_trace: %s",
+		    strerror(errno));
+	free(next);
+	free(active);
+	mdriver_free_trace(scaled);
+	return NULL;
+    }
+
+    /*
+     * All copies have the same length, so round-robin takes request j
+     * of every copy in turn. A random interleaving picks one of the
+     * unfinished copies for each request.
+     */
+    i = 0;
+    if (interleave == MDRIVER_RANDOM) {
+	for (c = 0; c < copies; c++)
+	    active[c] = c;
+	nactive = (trace->num_ops > 0) ? copies : 0;
+	while (nactive > 0) {
+	    seed = seed * 1103515245 + 12345;
+	    j = (seed >> 16) % nactive;
+	    c = active[j];
+	    scale_op(scaled, i++, &trace->ops[next[c]], c * trace->num_ids);
+	    if (++next[c] == trace->num_ops)
+		active[j] = active[--nactive];
+	}
+    }
+    else {
+	for (j = 0; j < trace->num_ops; j++)
+	    for (c = 0; c < copies; c++)
+		scale_op(scaled, i++, &trace->ops[j], c * trace->num_ids);
+    }
+
+    free(next);
+    free(active);
+    pack_trace(scaled);
+    return scaled;
+}
+
+/*
+ * scale_op - Make request i of the scaled trace a copy of op whose id
+ *     is shifted by base
+ */
+static void scale_op(trace_t *scaled, int i, const traceop_t *op, int base)
+{
+    scaled->ops[i].type = op->type;
+    scaled->ops[i].index = op->index + base;
+    scaled->ops[i].size = op->size;
+}
+
+/*
+ * alloc_trace - Allocate the arrays of a trace record whose header
+ *     fields are filled in
+ */
+static int alloc_trace(trace_t *trace)
+{
+    /* We'll store each request line in the trace in this array */
+    trace->ops = (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t));
+
+    /* We'll keep an array of pointers to the allocated blocks here... */
+    trace->blocks = (char **)malloc(trace->num_ids * sizeof(char *));
+
+    /* ... along with the corresponding byte sizes of each block */
+    trace->block_sizes = (size_t *)malloc(trace->num_ids * sizeof(size_t));
+
+    /* ... and the requests packed for the timed replay loops */
+    trace->packed = (packedop_t *)
+	malloc((trace->num_ops + PREFETCH_DIST) * sizeof(packedop_t));
+
+    if (!trace->ops || !trace->blocks || !trace->block_sizes ||
+	!trace->packed) {
+	sprintf(errbuf, "malloc 2 failed in read_trace: %s", strerror(errno));
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * pack_trace - Pre-decode the requests for the timed replay loops. The
+ *     stream is padded with PREFETCH_DIST dummy requests, so that the
+ *     loops can look ahead without checking for the end of the trace.
+ */
+static void pack_trace(trace_t *trace)
+{
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	trace->packed[i].op = PACK_OP(trace->ops[i].type,
+				      trace->ops[i].index);
+	trace->packed[i].size = trace->ops[i].size;
+    }
+    for ( ; i < trace->num_ops + PREFETCH_DIST; i++) {
+	trace->packed[i].op = PACK_OP(FREE, 0);
+	trace->packed[i].size = 0;
+    }
+}
+
+/*
+ * mdriver_free_trace - Free the trace record and the four arrays it
+ *     points to, all of which were allocated in mdriver_read_trace().
+ */
+void mdriver_free_trace(mdriver_trace_t *trace)
+{
+    if (trace == NULL)
+	return;
+    free(trace->ops);         /* free the four arrays... */
+    free(trace->packed);
+    free(trace->blocks);
+    free(trace->block_sizes);
+    free(trace);              /* and the trace record itself... */
+}
+
+/**********************************************************************
+ * The following functions evaluate the correctness, space utilization,
+ * and throughput of an allocator.
+ **********************************************************************/
+
+/*
+ * eval_valid - Check an allocator that uses memlib for correctness on
+ *     the requests of trace up to stop, from the checkpoint ckpt on if
+ *     it is set
+ */
+static int eval_valid(const mdriver_allocator_t *alloc, trace_t *trace,
+		      int check_heap, mdriver_result_t *result,
+		      void **ranges, const mdriver_checkpoint_t *ckpt,
+		      int stop)
+{
+    int i, j;
+    int index;
+    int size;
+    int oldsize;
+    char *newp;
+    char *oldp;
+    char *p;
+
+    /* Reset the heap and free any records in the range tree */
+    mem_reset_brk();
+    clear_ranges(ranges);
+
+    /* Restore the checkpoint and its live blocks, or start afresh */
+    if (ckpt) {
+	if (restore_checkpoint(alloc, trace, ckpt) < 0) {
+	    malloc_error(result, ckpt->opnum, "can't restore the checkpoint: "
+			 "the heap's address range is taken or too small");
+	    return 0;
+	}
+	for (j = 0; j < trace->num_ids; j++)
+	    if (trace->blocks[j] &&
+		add_range(ranges, trace->blocks[j], trace->block_sizes[j],
+			  result, ckpt->opnum) == 0)
+		return 0;
+    }
+    else if (alloc->init && alloc->init() < 0) {
+	malloc_error(result, 0, "mm_init failed.");
+	return 0;
+    }
+
+    /* Interpret each operation in the trace in order */
+    for (i = ckpt ? ckpt->opnum : 0;  i < stop;  i++) {
+	progress->opnum = i;
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+
+	    /* Call the student's malloc */
+	    if ((p = alloc->malloc(size)) == NULL) {
+		malloc_error(result, i, "mm_malloc failed.");
+		return 0;
+	    }
+
+	    /*
+	     * Test the range of the new block for correctness and add it
+	     * to the range tree if OK. The block must be  be aligned properly,
+	     * and must not overlap any currently allocated block.
+	     */
+	    if (add_range(ranges, p, size, result, i) == 0)
+		return 0;
+
+	    /* ADDED: cgw
+	     * fill range with low byte of index.  This will be used later
+	     * if we realloc the block and wish to make sure that the old
+	     * data was copied to the new block
+	     */
+	    memset(p, index & 0xFF, size);
+
+	    /* Remember region */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+        case REALLOC: /* mm_realloc */
+
+	    /* Call the student's realloc */
+	    oldp = trace->blocks[index];
+	    if ((newp = alloc->realloc(oldp, size)) == NULL) {
+		malloc_error(result, i, "mm_realloc failed.");
+		return 0;
+	    }
+
+	    /* Remove the old region from the range tree */
+	    remove_range(ranges, oldp);
+
+	    /* Check new block for correctness and add it to range tree */
+	    if (add_range(ranges, newp, size, result, i) == 0)
+		return 0;
+
+	    /* ADDED: cgw
+	     * Make sure that the new block contains the data from the old
+	     * block and then fill in the new block with the low order byte
+	     * of the new index
+	     */
+	    oldsize = trace->block_sizes[index];
+	    if (size < oldsize) oldsize = size;
+	    for (j = 0; j < oldsize; j++) {
+	      if (newp[j] != (index & 0xFF)) {
+		malloc_error(result, i, "mm_realloc did not preserve the "
+			     "data from old block");
+		return 0;
+	      }
+	    }
+	    memset(newp, index & 0xFF, size);
+
+	    /* Remember region */
+	    trace->blocks[index] = newp;
+	    trace->block_sizes[index] = size;
+	    break;
+
+        case FREE: /* mm_free */
+
+	    /* Remove region from list and call student's free function */
+	    p = trace->blocks[index];
+	    remove_range(ranges, p);
+	    alloc->free(p);
+	    break;
+
+	default:
+	    malloc_error(result, i, "Nonexistent request type in eval_valid");
+	    return 0;
+        }
+
+	if (check_heap && alloc->checkheap)
+	    alloc->checkheap(mdriver_verbose > 1);
+    }
+
+    /* As far as we know, this is a valid malloc package */
+    return 1;
+}
+
+/*
+ * eval_util - Evaluate the space utilization of an allocator that
+ *   uses memlib on the requests of trace up to stop (from the
+ *   checkpoint ckpt on, if it is set). The idea
+ *   is to remember the high water mark "hwm" of the heap for an
+ *   optimal allocator, i.e., no gaps and no internal
+ *   fragmentation. Utilization is the ratio hwm/heapsize, where
+ *   heapsize is the size of the heap in bytes after running the
+ *   allocator on the trace. Note that our implementation of mem_sbrk()
+ *   doesn't allow the students to decrement the brk pointer, so brk
+ *   is always the high water mark of the heap.
+ *
+ */
+static double eval_util(const mdriver_allocator_t *alloc, trace_t *trace,
+			const mdriver_checkpoint_t *ckpt, int stop)
+{
+    int i;
+    int index;
+    int size, newsize, oldsize;
+    double max_total_size = 0;
+    double total_size = 0;
+    char *p;
+    char *newp, *oldp;
+
+    /* initialize the heap and the allocator, or restore the checkpoint */
+    mem_reset_brk();
+    if (ckpt) {
+	if (restore_checkpoint(alloc, trace, ckpt) < 0)
+	    replay_error("can't restore the checkpoint in eval_util");
+	total_size = ckpt->total_size;
+	max_total_size = ckpt->max_total_size;
+    }
+    else if (alloc->init && alloc->init() < 0)
+	replay_error("mm_init failed in eval_util");
+
+    for (i = ckpt ? ckpt->opnum : 0;  i < stop;  i++) {
+	progress->opnum = i;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_alloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+
+	    if ((p = alloc->malloc(size)) == NULL)
+		replay_error("mm_malloc failed in eval_util");
+
+	    /* Remember region and size */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += size;
+
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    index = trace->ops[i].index;
+	    newsize = trace->ops[i].size;
+	    oldsize = trace->block_sizes[index];
+
+	    oldp = trace->blocks[index];
+	    if ((newp = alloc->realloc(oldp,newsize)) == NULL)
+		replay_error("mm_realloc failed in eval_util");
+
+	    /* Remember region and size */
+	    trace->blocks[index] = newp;
+	    trace->block_sizes[index] = newsize;
+
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += (double)newsize - oldsize;
+
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+        case FREE: /* mm_free */
+	    index = trace->ops[i].index;
+	    size = trace->block_sizes[index];
+	    p = trace->blocks[index];
+
+	    alloc->free(p);
+
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size -= size;
+
+	    break;
+
+	default:
+	    replay_error("Nonexistent request type in eval_util");
+
+        }
+    }
+
+    return (max_total_size / (double)mem_heapsize());
+}
+
+/*
+ * REPLAY_PACKED - The body of the timed replay loop. Replays nops
+ *    packed requests of trace, from request first on, with the given
+ *    malloc, free, and realloc functions, and reports failures with
+ *    errfn(errmsg). Dispatch is
+ *    threaded: each request handler jumps straight to the handler of
+ *    the next request through a table of label addresses (a gcc
+ *    extension), so there is no central switch. The blocks[] slot of a
+ *    request PREFETCH_DIST requests ahead is prefetched, since those
+ *    loads would otherwise miss the cache on large traces.
+ */
+#define REPLAY_PACKED(trace, first, nops, xmalloc, xfree, xrealloc,	\
+		      errfn, errmsg)					\
+{									\
+    static void *dispatch[] = {						\
+	[ALLOC] = &&do_alloc, [FREE] = &&do_free,			\
+	[REALLOC] = &&do_realloc, [3] = &&do_bogus			\
+    };									\
+    packedop_t *op = (trace)->packed + (first);				\
+    packedop_t *end = op + (nops);					\
+    char **blocks = (trace)->blocks;					\
+    char *p;								\
+									\
+    if (op == end)							\
+	goto done;							\
+    goto *dispatch[OP_TYPE(op->op)];					\
+									\
+ do_alloc:								\
+    if ((p = xmalloc(op->size)) == NULL)				\
+	errfn(errmsg);							\
+    blocks[OP_INDEX(op->op)] = p;					\
+    goto next;								\
+									\
+ do_realloc:								\
+    if ((p = xrealloc(blocks[OP_INDEX(op->op)], op->size)) == NULL)	\
+	errfn(errmsg);							\
+    blocks[OP_INDEX(op->op)] = p;					\
+    goto next;								\
+									\
+ do_free:								\
+    xfree(blocks[OP_INDEX(op->op)]);					\
+    goto next;								\
+									\
+ do_bogus:								\
+    errfn("Nonexistent request type in replay");			\
+									\
+ next:									\
+    __builtin_prefetch(&blocks[OP_INDEX(op[PREFETCH_DIST].op)], 1);	\
+    if (++op != end)							\
+	goto *dispatch[OP_TYPE(op->op)];				\
+ done:									\
+    ;									\
+}
+
+/*
+ * eval_speed - This is the function that is used by fcyc() to measure
+ *    the running time of an allocator on a trace.
+ */
+static void eval_speed(void *ptr)
+{
+    speed_t *params = (speed_t *)ptr;
+    const mdriver_allocator_t *alloc = params->alloc;
+    void *(*xmalloc)(size_t) = alloc->malloc;
+    void (*xfree)(void *) = alloc->free;
+    void *(*xrealloc)(void *, size_t) = alloc->realloc;
+
+    /* Reset the heap and initialize the allocator, or pick up where
+       the checkpoint left them (prepare_speed restores it untimed) */
+    if (params->checkpoint) {
+	if (!params->restored &&
+	    restore_checkpoint(alloc, params->trace, params->checkpoint) < 0)
+	    replay_error("can't restore the checkpoint in eval_speed");
+	params->restored = 0;
+    }
+    else {
+	if (alloc->uses_memlib)
+	    mem_reset_brk();
+	if (alloc->init && alloc->init() < 0)
+	    replay_error("init failed in eval_speed");
+    }
+
+    /* Interpret each trace request (the part that -P profiles) */
+    profile_armed = 1;
+    REPLAY_PACKED(params->trace, params->first, params->num_ops,
+		  xmalloc, xfree, xrealloc,
+		  replay_error, "malloc/realloc error in eval_speed");
+    profile_armed = 0;
+
+    /* A prefix leaves blocks allocated that a heap reset won't free */
+    params->dirty = !alloc->uses_memlib &&
+	params->first + params->num_ops < params->last;
+}
+
+/*
+ * prepare_speed - Called by fsecs before each sample of eval_speed,
+ *    outside of the measured time, to map or unmap the pages of the
+ *    heap as the heap mode says. The heap is empty at that point, since
+ *    eval_speed resets it anyway. With a checkpoint (and so the
+ *    HEAP_REUSE mode), the heap is restored here, so the copy isn't
+ *    timed. The blocks that the last replay of a prefix left allocated
+ *    are freed first, and the heap is committed as far as the replay
+ *    will grow it, so that mem_sbrk doesn't spend the timed run in
+ *    mprotect. The page faults of the last sample are counted on the
+ *    way in, and the count is restarted on the way out, so the faults
+ *    of preparing a sample aren't counted.
+ */
+static void prepare_speed(void *ptr)
+{
+    speed_t *params = (speed_t *)ptr;
+
+    count_faults(params);
+    free_prefix(params);
+    if (params->checkpoint) {
+	if (restore_checkpoint(params->alloc, params->trace,
+			       params->checkpoint) < 0)
+	    replay_error("can't restore the checkpoint in prepare_speed");
+	params->restored = 1;
+    }
+    if (params->alloc->uses_memlib && mem_precommit(params->prefault) < 0)
+	replay_error("can't commit the heap in prepare_speed");
+    if (params->heap_mode == HEAP_PREFAULT)
+	mem_prefault(params->prefault);
+    else if (params->heap_mode == HEAP_DISCARD)
+	mem_discard();
+    getrusage(RUSAGE_SELF, &params->mark);
+    params->marked = 1;
+}
+
+/*
+ * count_faults - Add the page faults since prepare_speed last returned
+ *    to the counts in params
+ */
+static void count_faults(speed_t *params)
+{
+    struct rusage now;
+
+    if (!params->marked)
+	return;
+    getrusage(RUSAGE_SELF, &now);
+    params->minflt += now.ru_minflt - params->mark.ru_minflt;
+    params->majflt += now.ru_majflt - params->mark.ru_majflt;
+    params->marked = 0;
+}
+
+/*
+ * free_prefix - Free the blocks that the last replay of a prefix of the
+ *    trace left allocated. A replay of the whole (balanced) trace frees
+ *    them itself, and a memlib heap is reset before the next replay, so
+ *    only prefix replays of allocators like libc need this.
+ */
+static void free_prefix(speed_t *params)
+{
+    trace_t *trace = params->trace;
+    int i, last = params->first + params->num_ops;
+    char *live;
+
+    if (!params->dirty)
+	return;
+    params->dirty = 0;
+    if ((live = (char *)calloc(trace->num_ids + 1, 1)) == NULL)
+	replay_error("out of memory in free_prefix");
+    for (i = params->first; i < last; i++)
+	live[trace->ops[i].index] = (trace->ops[i].type != FREE);
+    for (i = 0; i < trace->num_ids; i++)
+	if (live[i])
+	    params->alloc->free(trace->blocks[i]);
+    free(live);
+}
+
+/*
+ * The null allocator - A bump allocator that hands out addresses in a
+ *    small arena without ever touching them. It does the least work any
+ *    allocator can do, so timing the replay loop with it measures the
+ *    overhead of the driver itself.
+ */
+static char null_arena[NULL_ARENA];
+static size_t null_brk = 0;
+
+static int null_init(void)
+{
+    null_brk = 0;
+    return 0;
+}
+
+static void *null_malloc(size_t size)
+{
+    char *p = null_arena + (null_brk % NULL_ARENA);
+    null_brk += size;
+    return p;
+}
+
+static void null_free(void *ptr)
+{
+}
+
+static void *null_realloc(void *ptr, size_t size)
+{
+    return null_malloc(size);
+}
+
+/*
+ * eval_complete - We run this function to make sure that an allocator
+ *    that doesn't use memlib (such as libc malloc) can run to
+ *    completion on the trace.
+ */
+static int eval_complete(const mdriver_allocator_t *alloc, trace_t *trace,
+			 mdriver_result_t *result)
+{
+    int i, newsize;
+    char *p, *newp, *oldp;
+
+    if (alloc->init && alloc->init() < 0) {
+	malloc_error(result, 0, "init failed");
+	return 0;
+    }
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	progress->opnum = i;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* malloc */
+	    if ((p = alloc->malloc(trace->ops[i].size)) == NULL) {
+		malloc_error(result, i, "malloc failed");
+		return 0;
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
+	case REALLOC: /* realloc */
+            newsize = trace->ops[i].size;
+	    oldp = trace->blocks[trace->ops[i].index];
+	    if ((newp = alloc->realloc(oldp, newsize)) == NULL) {
+		malloc_error(result, i, "realloc failed");
+		return 0;
+	    }
+	    trace->blocks[trace->ops[i].index] = newp;
+	    break;
+
+        case FREE: /* free */
+	    alloc->free(trace->blocks[trace->ops[i].index]);
+	    break;
+
+	default:
+	    malloc_error(result, i, "invalid operation type in eval_complete");
+	    return 0;
+	}
+    }
+
+    return 1;
+}
+
+/**********************************************************************
+ * The following functions time the replays of a trace. With a time
+ * budget, a large trace is timed by replaying only a prefix of it. If
+ * one replay of the whole trace still fits in the budget, the time of
+ * the prefix is scaled by how much longer that replay took than one of
+ * the prefix, so the later phases of the trace count; otherwise the
+ * time of the prefix is extrapolated linearly.
+ **********************************************************************/
+
+/*
+ * plan_replay - Decide how many requests of the trace in params each
+ *     timed run replays. Without a budget, that is the whole trace.
+ *     With a budget, time ever longer prefixes of the trace (starting
+ *     with PILOT_OPS requests, and prepared like the timed samples)
+ *     until one takes a noticeable share of the budget. If MIN_SAMPLES
+ *     whole replays fit in the budget, replay the whole trace.
+ *     Otherwise, if one whole replay fits in half of it, keep that half
+ *     for it and fit MIN_SAMPLES samples of a prefix in the other half;
+ *     if not, fit them in all of it.
+ */
+static void plan_replay(speed_t *params, double budget)
+{
+    int num_ops = params->last - params->first;
+    double secs, fit, whole;
+
+    params->num_ops = num_ops;
+    params->whole = 0;
+    if (budget <= 0)
+	return;
+
+    params->num_ops = (PILOT_OPS < num_ops) ? PILOT_OPS : num_ops;
+    while (1) {
+	prepare_speed(params);
+	secs = ftimer_gettod(eval_speed, params, 1);
+	free_prefix(params);
+	if (params->num_ops == num_ops || secs >= budget/PILOT_SHARE)
+	    break;
+	params->num_ops = (2*params->num_ops < num_ops) ?
+	    2*params->num_ops : num_ops;
+    }
+
+    whole = (secs > 0) ? secs*num_ops/params->num_ops : 0;
+    if (whole*MIN_SAMPLES <= budget) {
+	params->num_ops = num_ops;
+	return;
+    }
+    if (whole <= budget/2) {
+	params->whole = 1;
+	budget /= 2;
+    }
+    fit = params->num_ops*budget/(MIN_SAMPLES*secs);
+    if (fit > params->num_ops)
+	params->num_ops = (int)fit;
+}
+
+/*
+ * time_trace - Time the replay prefix chosen by plan_replay and return
+ *     the time scaled or extrapolated to the whole trace (from the
+ *     checkpoint on, with one). If result is not NULL, also record how
+ *     much of the trace was replayed and how confident the timing
+ *     package is in its estimate. If pgfaults is not NULL,
+ *     record the page faults per replay (also extrapolated), as
+ *     getrusage counts them between the end of prepare_speed and the
+ *     end of each sample.
+ */
+static double time_trace(speed_t *params, mdriver_result_t *result,
+			 mdriver_faults_t *pgfaults)
+{
+    double secs, prefix, whole, share = 1.0;
+    int samples, num_ops = params->num_ops;
+
+    params->marked = 0;
+    params->minflt = params->majflt = 0;
+    secs = fsecs(eval_speed, params);
+    count_faults(params);
+    free_prefix(params);
+
+    if (params->last > params->first)
+	share = (double)params->num_ops / (params->last - params->first);
+
+    if (result) {
+	result->replayed = share;
+	result->samples = get_fsecs_samples();
+	result->spread = get_fsecs_spread();
+    }
+    if (pgfaults) {
+	samples = (get_fsecs_samples() > 0) ? get_fsecs_samples() : 1;
+	pgfaults->minor = params->minflt / samples / share;
+	pgfaults->major = params->majflt / samples / share;
+    }
+
+    /* One replay of the prefix and one of the whole trace, alike */
+    if (params->whole) {
+	prepare_speed(params);
+	prefix = ftimer_gettod(eval_speed, params, 1);
+	free_prefix(params);
+	params->num_ops = params->last - params->first;
+	prepare_speed(params);
+	whole = ftimer_gettod(eval_speed, params, 1);
+	params->num_ops = num_ops;
+	if (prefix > 0 && whole > 0)
+	    return secs * whole/prefix;
+    }
+    return secs/share;
+}
+
+/*
+ * mdriver_write_profile - Write the stacks sampled in the last timed
+ *     replay to fp as folded stacks under the root frame root
+ */
+int mdriver_write_profile(FILE *fp, const char *root)
+{
+    int n, dropped;
+
+    if ((n = profile_write(fp, root)) < 0) {
+	strcpy(errbuf, "mdriver_write_profile: out of memory");
+	return -1;
+    }
+    profile_samples(&dropped);
+    if (dropped > 0 && mdriver_verbose > 1)
+	printf("Dropped %d stack samples (buffer full).\n", dropped);
+    return n;
+}
+
+/*****************************************************************
+ * Checkpoints. To look into the end of a long trace, the replays can
+ * start from a snapshot of the heap and the blocks part way through
+ * instead of replaying everything before it every time. Restoring a
+ * checkpoint copies the heap back to where it was, since the blocks
+ * in it point to each other. A checkpoint file holds the struct itself
+ * (its pointers as they were), the heap, the allocator's state, and
+ * the blocks, so it is only good for the same build of the driver.
+ ****************************************************************/
+
+/*
+ * mdriver_checkpoint - Check alloc on the first opnum requests of trace
+ *     (from the checkpoint from on, if it is set) and take a checkpoint
+ *     there
+ */
+mdriver_checkpoint_t *mdriver_checkpoint(const mdriver_allocator_t *alloc,
+					 mdriver_trace_t *trace,
+					 const mdriver_checkpoint_t *from,
+					 long long opnum)
+{
+    static void *ranges = NULL; /* block extents up to opnum */
+    mdriver_checkpoint_t *ckpt;
+    mdriver_result_t result;
+    int i, index, size, valid;
+
+    if (!alloc || !alloc->malloc || !alloc->free || !alloc->realloc ||
+	!alloc->uses_memlib || !trace || opnum < 0 || opnum > trace->num_ops) {
+	strcpy(errbuf, "mdriver_checkpoint: missing allocator function or "
+	       "argument, or not a memlib allocator");
+	return NULL;
+    }
+    if (!alloc->save_state || !alloc->restore_state) {
+	snprintf(errbuf, MAXLINE, "mdriver_checkpoint: allocator %.100s has "
+		 "no save_state and restore_state", alloc->name);
+	return NULL;
+    }
+    if (from && (strcmp(from->alloc, alloc->name) || from->opnum > opnum ||
+		 from->num_ops != trace->num_ops ||
+		 from->num_ids != trace->num_ids ||
+		 from->hash != trace_hash(trace))) {
+	strcpy(errbuf, "mdriver_checkpoint: the checkpoint to start from is "
+	       "of another allocator or trace, or later");
+	return NULL;
+    }
+
+    /* Replay and check the requests before the checkpoint */
+    memset(&result, 0, sizeof(result));
+    set_phase(MDRIVER_CHECK);
+    valid = eval_valid(alloc, trace, 0, &result, &ranges, from, opnum);
+    set_phase(MDRIVER_IDLE);
+    clear_ranges(&ranges);
+    if (!valid) {
+	snprintf(errbuf, MAXLINE, "mdriver_checkpoint: request %d: %.900s",
+		 result.errop, result.errmsg);
+	return NULL;
+    }
+
+    if ((ckpt = calloc(1, sizeof(mdriver_checkpoint_t))) == NULL) {
+	strcpy(errbuf, "mdriver_checkpoint: out of memory");
+	return NULL;
+    }
+    snprintf(ckpt->alloc, MAXLINE, "%s", alloc->name);
+    ckpt->hash = trace_hash(trace);
+    ckpt->num_ops = trace->num_ops;
+    ckpt->num_ids = trace->num_ids;
+    ckpt->opnum = opnum;
+    ckpt->heap_lo = mem_heap_lo();
+    ckpt->heapsize = mem_heapsize();
+    ckpt->statesize = alloc->save_state(NULL, 0);
+    ckpt->heap = malloc(ckpt->heapsize + 1);
+    ckpt->state = malloc(ckpt->statesize + 1);
+    ckpt->blocks = calloc(trace->num_ids + 1, sizeof(char *));
+    ckpt->block_sizes = calloc(trace->num_ids + 1, sizeof(size_t));
+    if (!ckpt->heap || !ckpt->state || !ckpt->blocks || !ckpt->block_sizes) {
+	mdriver_free_checkpoint(ckpt);
+	strcpy(errbuf, "mdriver_checkpoint: out of memory");
+	return NULL;
+    }
+    memcpy(ckpt->heap, ckpt->heap_lo, ckpt->heapsize);
+    alloc->save_state(ckpt->state, ckpt->statesize);
+
+    /* Which blocks are live, and their payload bytes (for eval_util) */
+    if (from) {
+	memcpy(ckpt->blocks, from->blocks, trace->num_ids * sizeof(char *));
+	memcpy(ckpt->block_sizes, from->block_sizes,
+	       trace->num_ids * sizeof(size_t));
+	ckpt->total_size = from->total_size;
+	ckpt->max_total_size = from->max_total_size;
+    }
+    for (i = from ? from->opnum : 0; i < opnum; i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+	if (trace->ops[i].type == FREE) {
+	    ckpt->total_size -= ckpt->block_sizes[index];
+	    ckpt->blocks[index] = NULL;
+	    ckpt->block_sizes[index] = 0;
+	    continue;
+	}
+	ckpt->total_size += (double)size - ckpt->block_sizes[index];
+	if (ckpt->total_size > ckpt->max_total_size)
+	    ckpt->max_total_size = ckpt->total_size;
+	ckpt->blocks[index] = trace->blocks[index];
+	ckpt->block_sizes[index] = size;
+    }
+    return ckpt;
+}
+
+/*
+ * mdriver_write_checkpoint - Write a checkpoint to the file path
+ */
+int mdriver_write_checkpoint(const mdriver_checkpoint_t *ckpt,
+			     const char *path)
+{
+    size_t n;
+    FILE *fp;
+    int ok;
+
+    if (!ckpt || !path) {
+	strcpy(errbuf, "mdriver_write_checkpoint: missing argument");
+	return -1;
+    }
+    if ((fp = fopen(path, "wb")) == NULL) {
+	snprintf(errbuf, MAXLINE, "mdriver_write_checkpoint: can't open %s: %s",
+		 path, strerror(errno));
+	return -1;
+    }
+    n = ckpt->num_ids;
+    ok = fputs(CHECKPOINT_MAGIC, fp) != EOF &&
+	fwrite(ckpt, sizeof(mdriver_checkpoint_t), 1, fp) == 1 &&
+	fwrite(ckpt->heap, 1, ckpt->heapsize, fp) == ckpt->heapsize &&
+	fwrite(ckpt->state, 1, ckpt->statesize, fp) == ckpt->statesize &&
+	fwrite(ckpt->blocks, sizeof(char *), n, fp) == n &&
+	fwrite(ckpt->block_sizes, sizeof(size_t), n, fp) == n;
+    if (fclose(fp) == EOF)
+	ok = 0;
+    if (!ok) {
+	snprintf(errbuf, MAXLINE, "mdriver_write_checkpoint: can't write %s: %s",
+		 path, strerror(errno));
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * mdriver_read_checkpoint - Read a checkpoint written by
+ *     mdriver_write_checkpoint, or return NULL
+ */
+mdriver_checkpoint_t *mdriver_read_checkpoint(const char *path)
+{
+    char magic[MAXLINE];
+    mdriver_checkpoint_t *ckpt;
+    size_t n;
+    FILE *fp;
+    int ok;
+
+    if (!path) {
+	strcpy(errbuf, "mdriver_read_checkpoint: missing argument");
+	return NULL;
+    }
+    if ((fp = fopen(path, "rb")) == NULL) {
+	snprintf(errbuf, MAXLINE, "mdriver_read_checkpoint: can't open %s: %s",
+		 path, strerror(errno));
+	return NULL;
+    }
+    if ((ckpt = calloc(1, sizeof(mdriver_checkpoint_t))) == NULL) {
+	fclose(fp);
+	strcpy(errbuf, "mdriver_read_checkpoint: out of memory");
+	return NULL;
+    }
+
+    ok = fgets(magic, MAXLINE, fp) && !strcmp(magic, CHECKPOINT_MAGIC) &&
+	fread(ckpt, sizeof(mdriver_checkpoint_t), 1, fp) == 1 &&
+	ckpt->num_ids >= 0 && ckpt->opnum >= 0 &&
+	ckpt->opnum <= ckpt->num_ops;
+    ckpt->alloc[MAXLINE-1] = '\0';
+    ckpt->heap = ckpt->state = NULL; /* the writer's, not ours */
+    ckpt->blocks = NULL;
+    ckpt->block_sizes = NULL;
+    if (ok) {
+	n = ckpt->num_ids;
+	ckpt->heap = malloc(ckpt->heapsize + 1);
+	ckpt->state = malloc(ckpt->statesize + 1);
+	ckpt->blocks = calloc(n + 1, sizeof(char *));
+	ckpt->block_sizes = calloc(n + 1, sizeof(size_t));
+	ok = ckpt->heap && ckpt->state && ckpt->blocks && ckpt->block_sizes &&
+	    fread(ckpt->heap, 1, ckpt->heapsize, fp) == ckpt->heapsize &&
+	    fread(ckpt->state, 1, ckpt->statesize, fp) == ckpt->statesize &&
+	    fread(ckpt->blocks, sizeof(char *), n, fp) == n &&
+	    fread(ckpt->block_sizes, sizeof(size_t), n, fp) == n;
+    }
+    fclose(fp);
+    if (!ok) {
+	mdriver_free_checkpoint(ckpt);
+	snprintf(errbuf, MAXLINE, "mdriver_read_checkpoint: %s is not a "
+		 "checkpoint of this driver, or is truncated", path);
+	return NULL;
+    }
+    return ckpt;
+}
+
+/*
+ * mdriver_free_checkpoint - Free a checkpoint
+ */
+void mdriver_free_checkpoint(mdriver_checkpoint_t *ckpt)
+{
+    if (ckpt == NULL)
+	return;
+    free(ckpt->heap);
+    free(ckpt->state);
+    free(ckpt->blocks);
+    free(ckpt->block_sizes);
+    free(ckpt);
+}
+
+/*
+ * mdriver_checkpoint_opnum - The requests replayed before a checkpoint
+ */
+long long mdriver_checkpoint_opnum(const mdriver_checkpoint_t *ckpt)
+{
+    return ckpt->opnum;
+}
+
+/*
+ * restore_checkpoint - Put the heap, the allocator's state, and the
+ *     blocks of trace back as they were at the checkpoint. Only the
+ *     blocks are restored for allocators that don't use memlib (the
+ *     null allocator that calibrates the replay). Returns -1 if the
+ *     heap can't be put back where it was, or if the allocator can't
+ *     restore its state.
+ */
+static int restore_checkpoint(const mdriver_allocator_t *alloc,
+			      trace_t *trace,
+			      const mdriver_checkpoint_t *ckpt)
+{
+    if (alloc->uses_memlib) {
+	if (!alloc->restore_state ||
+	    mem_restore(ckpt->heap_lo, ckpt->heap, ckpt->heapsize) < 0)
+	    return -1;
+	alloc->restore_state(ckpt->state);
+    }
+    memcpy(trace->blocks, ckpt->blocks, trace->num_ids * sizeof(char *));
+    memcpy(trace->block_sizes, ckpt->block_sizes,
+	   trace->num_ids * sizeof(size_t));
+    return 0;
+}
+
+/*
+ * trace_hash - A hash (64-bit FNV-1a) of the requests of trace, which
+ *     ties a checkpoint to the trace it was taken on
+ */
+static unsigned long long trace_hash(const trace_t *trace)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    int i, j, word[3];
+
+    for (i = 0; i < trace->num_ops; i++) {
+	word[0] = trace->ops[i].type;
+	word[1] = trace->ops[i].index;
+	word[2] = trace->ops[i].size;
+	for (j = 0; j < (int)sizeof(word); j++)
+	    hash = (hash ^ ((unsigned char *)word)[j]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*****************************************************************
+ * Representative windows. A huge trace usually repeats a few kinds
+ * of behavior, so timing a couple of windows of each kind estimates
+ * the time of the whole trace (after SimPoint). The windows are
+ * clustered by simpoint.c on what they ask of the allocator.
+ ****************************************************************/
+
+/*
+ * mdriver_simpoints - Cluster the windows of trace and pick the ones
+ *     that represent the clusters
+ */
+int mdriver_simpoints(const mdriver_trace_t *trace, int window, int k,
+		      mdriver_simpoint_t *points)
+{
+    double *x, *f, *cluster_ops, live = 0, max_live = 0;
+    int *sizes, *cluster, *reps, *windows;
+    int i, j, w, c, n, nc, np = 0, ops, size;
+
+    if (!trace || window < 1 || k < 1 || !points) {
+	strcpy(errbuf, "mdriver_simpoints: missing or bad argument");
+	return -1;
+    }
+    n = (trace->num_ops + window - 1) / window;
+    x = calloc(n * SIMPOINT_DIM + 1, sizeof(double));
+    sizes = calloc(trace->num_ids + 1, sizeof(int));
+    cluster = malloc((n + 1) * sizeof(int));
+    reps = malloc(k * MDRIVER_SIMPOINT_REPS * sizeof(int));
+    windows = calloc(k, sizeof(int));
+    cluster_ops = calloc(k, sizeof(double));
+    if (!x || !sizes || !cluster || !reps || !windows || !cluster_ops) {
+	strcpy(errbuf, "mdriver_simpoints: out of memory");
+	np = -1;
+	goto out;
+    }
+
+    /* The features of each window: the shares of its requests of each
+       type and size class, and the payload bytes live at its end */
+    for (i = 0; i < trace->num_ops; i++) {
+	f = &x[(i / window) * SIMPOINT_DIM];
+	j = trace->ops[i].index;
+	size = trace->ops[i].size;
+	if (trace->ops[i].type == FREE) {
+	    size = sizes[j];
+	    live -= size;
+	    sizes[j] = 0;
+	}
+	else {
+	    live += size - sizes[j];
+	    sizes[j] = size;
+	}
+	if (live > max_live)
+	    max_live = live;
+	c = size_class(size);
+	f[trace->ops[i].type] += 1;
+	f[3 + (c < SIMPOINT_CLASSES ? c : SIMPOINT_CLASSES-1)] += 1;
+	f[SIMPOINT_DIM-1] = live;
+    }
+    for (w = 0; w < n; w++) {
+	f = &x[w * SIMPOINT_DIM];
+	ops = (w < n-1) ? window : trace->num_ops - w*window;
+	for (j = 0; j < SIMPOINT_DIM-1; j++)
+	    f[j] /= ops;
+	if (max_live > 0)
+	    f[SIMPOINT_DIM-1] /= max_live;
+    }
+
+    if ((nc = simpoint_cluster(x, n, SIMPOINT_DIM, k, MDRIVER_SIMPOINT_REPS,
+			       cluster, reps)) < 0) {
+	strcpy(errbuf, "mdriver_simpoints: out of memory");
+	np = -1;
+	goto out;
+    }
+    for (w = 0; w < n; w++) {
+	windows[cluster[w]]++;
+	cluster_ops[cluster[w]] += (w < n-1) ? window : trace->num_ops - w*window;
+    }
+    for (c = 0; c < nc; c++)
+	for (j = 0; j < MDRIVER_SIMPOINT_REPS; j++) {
+	    if ((w = reps[c*MDRIVER_SIMPOINT_REPS + j]) < 0)
+		continue;
+	    points[np].first = (long long)w * window;
+	    points[np].ops = (w < n-1) ? window : trace->num_ops - w*window;
+	    points[np].cluster = c;
+	    points[np].windows = windows[c];
+	    points[np].cluster_ops = cluster_ops[c];
+	    np++;
+	}
+    qsort(points, np, sizeof(mdriver_simpoint_t), cmp_simpoints);
+
+ out:
+    free(x);
+    free(sizes);
+    free(cluster);
+    free(reps);
+    free(windows);
+    free(cluster_ops);
+    return np;
+}
+
+/*
+ * cmp_simpoints - qsort comparison of two windows by their position
+ */
+static int cmp_simpoints(const void *a, const void *b)
+{
+    long long x = ((const mdriver_simpoint_t *)a)->first;
+    long long y = ((const mdriver_simpoint_t *)b)->first;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * mdriver_time_simpoint - Check alloc up to the end of the window
+ *     point (from the checkpoint ckpt on), and time the window in
+ *     MDRIVER_SIMPOINT_RUNS replays from the checkpoint
+ */
+int mdriver_time_simpoint(const mdriver_allocator_t *alloc,
+			  mdriver_trace_t *trace,
+			  const mdriver_checkpoint_t *ckpt,
+			  const mdriver_simpoint_t *point, double *secs)
+{
+    static void *ranges = NULL; /* block extents up to the window's end */
+    mdriver_result_t result;
+    size_t prefault;
+    int valid;
+
+    if (!alloc || !alloc->malloc || !alloc->free || !alloc->realloc ||
+	!alloc->uses_memlib || !trace || !ckpt || !point || !secs) {
+	strcpy(errbuf, "mdriver_time_simpoint: missing allocator function "
+	       "or argument, or not a memlib allocator");
+	return -1;
+    }
+    if (!alloc->save_state || !alloc->restore_state) {
+	snprintf(errbuf, MAXLINE, "mdriver_time_simpoint: allocator %.100s "
+		 "has no save_state and restore_state", alloc->name);
+	return -1;
+    }
+    if (strcmp(ckpt->alloc, alloc->name) || ckpt->num_ops != trace->num_ops ||
+	ckpt->num_ids != trace->num_ids || ckpt->hash != trace_hash(trace) ||
+	point->first < ckpt->opnum || point->ops < 1 ||
+	point->first + point->ops > trace->num_ops) {
+	strcpy(errbuf, "mdriver_time_simpoint: the checkpoint is of another "
+	       "allocator or trace, or past the window");
+	return -1;
+    }
+
+    /* Check the requests up to the end of the window */
+    memset(&result, 0, sizeof(result));
+    set_phase(MDRIVER_CHECK);
+    valid = eval_valid(alloc, trace, 0, &result, &ranges, ckpt,
+		       point->first + point->ops);
+    set_phase(MDRIVER_IDLE);
+    clear_ranges(&ranges);
+    if (!valid) {
+	snprintf(errbuf, MAXLINE, "mdriver_time_simpoint: request %d: %.900s",
+		 result.errop, result.errmsg);
+	return -1;
+    }
+    prefault = mem_heapsize();
+    if ((size_t)trace->sugg_heapsize > prefault)
+	prefault = trace->sugg_heapsize;
+
+    /* Failed requests during the timed replays come back here */
+    if (setjmp(fail_env)) {
+	set_phase(MDRIVER_IDLE);
+	strcpy(errbuf, failmsg);
+	return -1;
+    }
+    set_phase(MDRIVER_TIME);
+    time_simpoint_runs(alloc, trace, ckpt, point->first,
+		       point->first + point->ops, prefault, secs);
+    set_phase(MDRIVER_IDLE);
+    return 0;
+}
+
+/*
+ * time_simpoint_runs - Time the requests [first, last) of trace in
+ *     MDRIVER_SIMPOINT_RUNS replays, after one more that only warms up.
+ *     Each restores the checkpoint (once, untimed), replays the
+ *     requests from it up to first to warm up the heap, the caches, and
+ *     the TLB, and reads the cycle counter around the rest of the same
+ *     replay.
+ */
+static void time_simpoint_runs(const mdriver_allocator_t *alloc,
+			       trace_t *trace,
+			       const mdriver_checkpoint_t *ckpt, int first,
+			       int last, size_t prefault, double *secs)
+{
+    static double Mhz = 0;
+    double cycles;
+    int run;
+
+    if (Mhz <= 0 && (Mhz = get_fsecs_mhz()) <= 0)
+	Mhz = mhz(0);
+    for (run = -1; run < MDRIVER_SIMPOINT_RUNS; run++) {
+	if (restore_checkpoint(alloc, trace, ckpt) < 0)
+	    replay_error("can't restore the checkpoint of a window");
+	if (mem_precommit(prefault) < 0)
+	    replay_error("can't commit the heap for a window");
+	replay_range(alloc, trace, ckpt->opnum, first - ckpt->opnum);
+	start_counter();
+	replay_range(alloc, trace, first, last - first);
+	cycles = get_counter();
+	if (run >= 0)
+	    secs[run] = cycles / (Mhz * 1e6);
+    }
+}
+
+/*
+ * replay_range - Replay nops requests of trace from request first on,
+ *     as the timed replays do
+ */
+static void replay_range(const mdriver_allocator_t *alloc, trace_t *trace,
+			 int first, int nops)
+{
+    void *(*xmalloc)(size_t) = alloc->malloc;
+    void (*xfree)(void *) = alloc->free;
+    void *(*xrealloc)(void *, size_t) = alloc->realloc;
+
+    REPLAY_PACKED(trace, first, nops, xmalloc, xfree, xrealloc,
+		  replay_error, "malloc/realloc error in a window replay");
+}
+
+/*****************************************************************
+ * Instrumented replays: the per-request timeline, and the cycles of
+ * each request type. These are separate replays, since reading the
+ * cycle counter around every request would distort the timed
+ * replays. The timeline events go into a preallocated ring buffer
+ * during the replay and are only formatted once it is over.
+ ****************************************************************/
+
+/*
+ * mdriver_write_events - Replay trace with per-request timing and
+ *     write the requests to fp as Chrome trace events
+ */
+int mdriver_write_events(const mdriver_allocator_t *alloc,
+			 mdriver_trace_t *trace, const char *name, int pid,
+			 FILE *fp)
+{
+    static event_t *events = NULL; /* ring buffer of MDRIVER_MAXEVENTS */
+    static double Mhz = 0;
+    static char *typenames[] = {"malloc", "free", "realloc"};
+    size_t heapsize;
+    event_t *e;
+    int first, i;
+
+    if (!alloc || !alloc->malloc || !alloc->free || !alloc->realloc ||
+	!trace || !name || !fp) {
+	strcpy(errbuf, "mdriver_write_events: missing allocator function or argument");
+	return -1;
+    }
+    if (events == NULL &&
+	(events = malloc(MDRIVER_MAXEVENTS * sizeof(event_t))) == NULL) {
+	strcpy(errbuf, "mdriver_write_events: out of memory");
+	return -1;
+    }
+    if (Mhz <= 0 && (Mhz = get_fsecs_mhz()) <= 0)
+	Mhz = mhz(0);
+
+    if (setjmp(fail_env)) {
+	set_phase(MDRIVER_IDLE);
+	strcpy(errbuf, failmsg);
+	return -1;
+    }
+    set_phase(MDRIVER_INSTRUMENT);
+    record_requests(alloc, trace, events, NULL, NULL, 0);
+    set_phase(MDRIVER_IDLE);
+
+    /* Only the last MDRIVER_MAXEVENTS requests are still in the ring */
+    first = trace->num_ops - MDRIVER_MAXEVENTS;
+    if (first < 0)
+	first = 0;
+
+    fprintf(fp, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+	    "\"args\":{\"name\":", pid);
+    write_json_string(fp, name);
+    fprintf(fp, ",\"dropped\":%d}}", first);
+
+    heapsize = 0;
+    for (i = first; i < trace->num_ops; i++) {
+	e = &events[i % MDRIVER_MAXEVENTS];
+	fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+		"\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,"
+		"\"args\":{\"op\":%d,\"size\":%d,\"offset\":%ld,"
+		"\"cycles\":%.0f,\"heap\":%lu}}",
+		typenames[e->type], alloc->name, pid, e->start/Mhz,
+		e->cycles/Mhz, e->opnum, e->size, e->offset, e->cycles,
+		(unsigned long)e->heapsize);
+	if (alloc->uses_memlib && (i == first || e->heapsize != heapsize))
+	    fprintf(fp, ",\n{\"name\":\"heap\",\"ph\":\"C\",\"pid\":%d,"
+		    "\"ts\":%.3f,\"args\":{\"bytes\":%lu}}",
+		    pid, (e->start + e->cycles)/Mhz,
+		    (unsigned long)e->heapsize);
+	heapsize = e->heapsize;
+    }
+    return trace->num_ops - first;
+}
+
+/*
+ * mdriver_eval_windows - Replay trace with per-request timing and
+ *     describe its windows of window requests
+ */
+int mdriver_eval_windows(const mdriver_allocator_t *alloc,
+			 mdriver_trace_t *trace, int window,
+			 mdriver_window_t *windows)
+{
+    static double Mhz = 0;
+    mdriver_window_t *run;
+    volatile int n;             /* live across the setjmp below */
+    int i, r;
+
+    if (!alloc || !alloc->malloc || !alloc->free || !alloc->realloc ||
+	!trace || window < 1 || !windows) {
+	strcpy(errbuf, "mdriver_eval_windows: missing allocator function or argument");
+	return -1;
+    }
+    n = (trace->num_ops + window - 1) / window;
+    if ((run = malloc(n * sizeof(mdriver_window_t))) == NULL) {
+	strcpy(errbuf, "mdriver_eval_windows: out of memory");
+	return -1;
+    }
+    if (Mhz <= 0 && (Mhz = get_fsecs_mhz()) <= 0)
+	Mhz = mhz(0);
+
+    if (setjmp(fail_env)) {
+	set_phase(MDRIVER_IDLE);
+	strcpy(errbuf, failmsg);
+	free(run);
+	return -1;
+    }
+    set_phase(MDRIVER_INSTRUMENT);
+    for (r = 0; r < MDRIVER_WINDOW_RUNS; r++) {
+	record_requests(alloc, trace, NULL, NULL, run, window);
+	for (i = 0; i < n; i++)
+	    if (r == 0 || run[i].cycles < windows[i].cycles)
+		windows[i] = run[i];
+    }
+    set_phase(MDRIVER_IDLE);
+
+    for (i = 0; i < n; i++)
+	windows[i].secs = windows[i].cycles / (Mhz * 1e6);
+    free(run);
+    return n;
+}
+
+/*
+ * record_requests - Replay trace, timing every request. If events is
+ *     not NULL, record the requests in that ring buffer. If opcost is
+ *     not NULL, add up the calls and cycles of each request type. If
+ *     windows is not NULL, add them up for every window of window
+ *     requests, by request type and by size class.
+ */
+static void record_requests(const mdriver_allocator_t *alloc,
+			    trace_t *trace, event_t *events,
+			    mdriver_opcost_t *opcost,
+			    mdriver_window_t *windows, int window)
+{
+    char *p, *base = NULL;
+    event_t scratch, *e = &scratch;
+    mdriver_window_t *w;
+    size_t heapstart = 0;
+    int i, index, optype, c;
+
+    if (alloc->uses_memlib) {
+	mem_reset_brk();
+	base = mem_heap_lo();
+    }
+    if (alloc->init && alloc->init() < 0)
+	replay_error("init failed in instrumented replay");
+    if (opcost)
+	memset(opcost, 0, MDRIVER_NOPTYPES*sizeof(mdriver_opcost_t));
+    if (windows)
+	memset(windows, 0, ((trace->num_ops + window - 1) / window) *
+	       sizeof(mdriver_window_t));
+    if (alloc->uses_memlib)
+	heapstart = mem_heapsize(); /* the first window doesn't get init's */
+
+    start_counter();
+    for (i = 0; i < trace->num_ops; i++) {
+	progress->opnum = i;
+	if (events)
+	    e = &events[i % MDRIVER_MAXEVENTS];
+	index = trace->ops[i].index;
+	e->opnum = i;
+	e->type = trace->ops[i].type;
+
+	switch (trace->ops[i].type) {
+	case ALLOC:
+	    e->size = trace->ops[i].size;
+	    e->start = get_counter();
+	    p = alloc->malloc(e->size);
+	    e->cycles = get_counter() - e->start;
+	    if (p == NULL)
+		replay_error("malloc failed in instrumented replay");
+	    optype = MDRIVER_MALLOC;
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = e->size;
+	    break;
+
+	case REALLOC:
+	    e->size = trace->ops[i].size;
+	    e->start = get_counter();
+	    p = alloc->realloc(trace->blocks[index], e->size);
+	    e->cycles = get_counter() - e->start;
+	    if (p == NULL)
+		replay_error("realloc failed in instrumented replay");
+	    optype = (p == trace->blocks[index]) ?
+		MDRIVER_REALLOC_INPLACE : MDRIVER_REALLOC_MOVED;
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = e->size;
+	    break;
+
+	default: /* FREE */
+	    p = trace->blocks[index];
+	    e->size = trace->block_sizes[index];
+	    e->start = get_counter();
+	    alloc->free(p);
+	    e->cycles = get_counter() - e->start;
+	    optype = MDRIVER_FREE;
+	    break;
+	}
+
+	if (opcost) {
+	    opcost[optype].calls++;
+	    opcost[optype].cycles += e->cycles;
+	}
+
+	e->offset = (long)(p - base);
+	e->heapsize = alloc->uses_memlib ? mem_heapsize() : 0;
+
+	if (windows) {
+	    w = &windows[i / window];
+	    if (w->ops++ == 0) {
+		w->first = i;
+		if (i > 0)
+		    heapstart = windows[i/window - 1].heapsize;
+	    }
+	    w->cycles += e->cycles;
+	    w->opcost[optype].calls++;
+	    w->opcost[optype].cycles += e->cycles;
+	    c = size_class(e->size);
+	    w->sizecost[c].calls++;
+	    w->sizecost[c].cycles += e->cycles;
+	    w->heapsize = e->heapsize;
+	    w->heap_growth = (long)e->heapsize - (long)heapstart;
+	}
+    }
+}
+
+/*
+ * size_class - The size class of a request of size bytes: the smallest
+ *     c with size <= 2^c, capped at MDRIVER_NSIZECLASSES-1
+ */
+static int size_class(int size)
+{
+    int c = 0;
+
+    while (c < MDRIVER_NSIZECLASSES-1 && size > (1 << c))
+	c++;
+    return c;
+}
+
+/*
+ * write_json_string - Write s to fp as a quoted JSON string
+ */
+static void write_json_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++) {
+	if (*s == '"' || *s == '\\')
+	    fputc('\\', fp);
+	if ((unsigned char)*s >= ' ')
+	    fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/*****************************************************************
+ * The payload-touch replay. The timed replays never touch the
+ * payloads, so an allocator that scatters related blocks all over
+ * the heap looks as fast as one that packs them together. This
+ * replay also makes the accesses an application would make, and
+ * counts the cycles and last-level cache misses of the whole run:
+ * the allocator's and the application's together.
+ ****************************************************************/
+
+/*
+ * eval_touch - Replay trace TOUCH_RUNS times touching the payloads as
+ *     the access model says, and record the cycles and LLC misses of
+ *     the fastest replay
+ */
+static void eval_touch(const mdriver_allocator_t *alloc, trace_t *trace,
+		       const mdriver_access_t *access,
+		       mdriver_result_t *result)
+{
+    static int ctr = -2;        /* the LLC miss counter (-1: none) */
+    int *recent = recent_ring(access);
+    double cycles, misses;
+    int run;
+
+    if (ctr == -2)
+	ctr = perfctr_open(PERFCTR_CACHE_MISSES);
+
+    for (run = 0; run < TOUCH_RUNS; run++) {
+	if (alloc->uses_memlib)
+	    mem_reset_brk();
+	if (alloc->init && alloc->init() < 0)
+	    replay_error("init failed in touch replay");
+
+	perfctr_start(ctr);
+	start_counter();
+	touch_requests(alloc, trace, access, recent, 0);
+	cycles = get_counter();
+	misses = perfctr_stop(ctr);
+
+	if (run == 0 || cycles < result->touch_cycles) {
+	    result->touch_cycles = cycles;
+	    result->touch_misses = misses;
+	}
+    }
+}
+
+/*
+ * recent_ring - Room for the ring of the access->recent most recently
+ *     allocated ids
+ */
+static int *recent_ring(const mdriver_access_t *access)
+{
+    static int *recent = NULL;
+    static int max_recent = 0;
+
+    if (access->recent > max_recent) {
+	free(recent);
+	if ((recent = malloc(access->recent * sizeof(int))) == NULL) {
+	    max_recent = 0;
+	    replay_error("out of memory in touch replay");
+	}
+	max_recent = access->recent;
+    }
+    return recent;
+}
+
+/*
+ * WRITE_PAYLOAD, READ_PAYLOAD - Write val to, or read (into
+ *     touch_sink), one byte every stride bytes of the size-byte
+ *     payload at p
+ */
+#define WRITE_PAYLOAD(p, size, stride, val)				\
+{									\
+    char *q_, *end_ = (p) + (size);					\
+    for (q_ = (p); q_ < end_; q_ += (stride))				\
+	*q_ = (val);							\
+}
+#define READ_PAYLOAD(p, size, stride)					\
+{									\
+    char *q_, *end_ = (p) + (size);					\
+    int sum_ = 0;							\
+    for (q_ = (p); q_ < end_; q_ += (stride))				\
+	sum_ += *q_;							\
+    touch_sink += sum_;							\
+}
+
+/*
+ * touch_requests - Replay trace once, touching the payloads. recent
+ *     has room for the access->recent ids of the ring of recently
+ *     allocated blocks. Freed blocks are set to NULL in blocks[], so
+ *     the re-touches skip them. If simulate is set, the touches are
+ *     fed to the cache model instead of made.
+ */
+static void touch_requests(const mdriver_allocator_t *alloc, trace_t *trace,
+			   const mdriver_access_t *access, int *recent,
+			   int simulate)
+{
+    int stride = access->stride;
+    int countdown = access->period;
+    int head = 0, nrecent = 0;
+    int i, j, index, size;
+    char *p;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	progress->opnum = i;
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+
+	switch (trace->ops[i].type) {
+	case ALLOC:
+	case REALLOC:
+	    if (trace->ops[i].type == ALLOC)
+		p = alloc->malloc(size);
+	    else
+		p = alloc->realloc(trace->blocks[index], size);
+	    if (p == NULL)
+		replay_error("malloc/realloc failed in touch replay");
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    if (access->write_alloc) {
+		if (simulate)
+		    sim_payload(p, size, stride, 1);
+		else
+		    WRITE_PAYLOAD(p, size, stride, (char)i);
+	    }
+	    if (access->recent > 0) {
+		recent[head] = index;
+		head = (head + 1) % access->recent;
+		if (nrecent < access->recent)
+		    nrecent++;
+	    }
+	    break;
+
+	default: /* FREE */
+	    p = trace->blocks[index];
+	    if (access->read_free) {
+		if (simulate)
+		    sim_payload(p, trace->block_sizes[index], stride, 0);
+		else
+		    READ_PAYLOAD(p, trace->block_sizes[index], stride);
+	    }
+	    alloc->free(p);
+	    trace->blocks[index] = NULL;
+	    break;
+	}
+
+	/* Every period requests, go back to the recent live blocks */
+	if (access->period > 0 && --countdown == 0) {
+	    countdown = access->period;
+	    for (j = 0; j < nrecent; j++)
+		if ((p = trace->blocks[recent[j]]) == NULL)
+		    continue;
+		else if (simulate)
+		    sim_payload(p, trace->block_sizes[recent[j]], stride,
+				0);
+		else
+		    READ_PAYLOAD(p, trace->block_sizes[recent[j]], stride);
+	}
+	if (simulate)
+	    cachesim_end_op();
+    }
+}
+
+/*****************************************************************
+ * Counting instructions. The number of instructions an allocator
+ * retires on a trace depends only on its code and the trace, not on
+ * the load of the machine or its clock, so it scores the same from
+ * run to run and host to host (given the same compiler and libc).
+ ****************************************************************/
+
+/*
+ * eval_insns - Count the user-level instructions of one replay of
+ *     trace by alloc, less those of the driver's replay loop (one
+ *     replay by the null allocator)
+ */
+static void eval_insns(const mdriver_allocator_t *alloc, trace_t *trace,
+		       mdriver_result_t *result)
+{
+    static int ctr = -2;  /* the instruction counter (-1: none) */
+    double total, loop;
+
+    if (ctr == -2)
+	ctr = perfctr_open(PERFCTR_INSTRUCTIONS);
+    if (ctr < 0) {
+	result->insns = -1;
+	return;
+    }
+    total = count_insns(ctr, alloc, trace);
+    loop = count_insns(ctr, &mdriver_null_allocator, trace);
+    if (total < 0 || loop < 0)
+	result->insns = -1;
+    else
+	result->insns = (total > loop) ? total - loop : 0;
+}
+
+/*
+ * count_insns - The instructions of one untimed eval_speed replay
+ */
+static double count_insns(int ctr, const mdriver_allocator_t *alloc,
+			  trace_t *trace)
+{
+    speed_t params;
+
+    memset(&params, 0, sizeof(params));
+    params.alloc = alloc;
+    params.trace = trace;
+    params.num_ops = trace->num_ops;
+    params.heap_mode = HEAP_REUSE;
+    perfctr_start(ctr);
+    eval_speed(&params);
+    return perfctr_stop(ctr);
+}
+
+/*****************************************************************
+ * The cache model pass. Timings differ from host to host, but the
+ * misses of a fixed cache and TLB model (cachesim.c) fed with a fixed
+ * sequence of accesses don't. The allocator's accesses reach the
+ * model only if it was built with the hooks of memtrace.h enabled
+ * ("make mdriver-sim"); the payload accesses are those of the touch
+ * replay's access model, if the touch option is set.
+ ****************************************************************/
+
+/*
+ * eval_sim - Replay trace once through the cache model, and record what
+ *     it counted for the allocator and for the payloads. The model
+ *     starts cold after the allocator's init function.
+ */
+static void eval_sim(const mdriver_allocator_t *alloc, trace_t *trace,
+		     const mdriver_options_t *opts, mdriver_result_t *result)
+{
+    mdriver_access_t none;
+    const mdriver_access_t *access = &opts->access;
+    int source;
+
+    /* Without the touch option, only the allocator's own accesses */
+    if (!opts->touch) {
+	memset(&none, 0, sizeof(none));
+	none.stride = 1;
+	access = &none;
+    }
+
+    if (alloc->uses_memlib)
+	mem_reset_brk();
+    if (alloc->init && alloc->init() < 0)
+	replay_error("init failed in cache model replay");
+    cachesim_reset(alloc->uses_memlib ? mem_heap_lo() : libc_heap_lo);
+    cachesim_source = CACHESIM_META;
+    cachesim_on = 1;
+    touch_requests(alloc, trace, access, recent_ring(access), 1);
+    cachesim_on = 0;
+
+    for (source = 0; source < CACHESIM_NSOURCES; source++)
+	cachesim_stats(source, &result->sim[source]);
+}
+
+/*
+ * sim_payload - Feed the accesses that WRITE_PAYLOAD or READ_PAYLOAD
+ *     make to a payload to the cache model: one byte every stride bytes
+ */
+static void sim_payload(char *p, int size, int stride, int write)
+{
+    char *q, *end = p + size;
+
+    cachesim_source = CACHESIM_PAYLOAD;
+    for (q = p; q < end; q += stride)
+	cachesim_access(q, 1, write);
+    cachesim_source = CACHESIM_META;
+}
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/*
+ * set_phase - Report that the evaluation entered phase (the request is
+ *     not known until a request-by-request pass starts)
+ */
+static void set_phase(int phase)
+{
+    progress->opnum = -1;
+    progress->phase = phase;
+}
+
+/*
+ * malloc_error - Record an error returned by the allocator on request
+ *     opnum of the trace
+ */
+static void malloc_error(mdriver_result_t *result, int opnum, char *msg)
+{
+    result->errop = opnum;
+    snprintf(result->errmsg, MAXLINE, "%s", msg);
+}
+
+/*
+ * replay_error - Abandon the evaluation of a trace when the allocator
+ *     fails during a replay it already got through while being checked
+ */
+static void replay_error(char *msg)
+{
+    snprintf(failmsg, MAXLINE, "%s", msg);
+    longjmp(fail_env, 1);
+}
@@ -0,0 +1,356 @@
+#ifndef __LIBMDRIVER_H_
+#define __LIBMDRIVER_H_
+
+/*
+ * libmdriver.h - The malloc lab evaluation library
+ *
+ * The library loads trace files and evaluates any allocator described
+ * by an mdriver_allocator_t on them: correctness, space utilization,
+ * and throughput. mdriver is a thin front end to it. To evaluate an
+ * allocator from another program:
+ *
+ *     mdriver_result_t result;
+ *     mdriver_options_t opts;
+ *     mdriver_trace_t *trace;
+ *
+ *     mdriver_init();
+ *     mdriver_default_options(&opts);
+ *     if ((trace = mdriver_read_trace("traces/amptjp-bal.rep")) == NULL)
+ *         ... mdriver_error() says why ...
+ *     mdriver_eval(&my_allocator, trace, &opts, &result);
+ *     mdriver_free_trace(trace);
+ *
+ * All functions return NULL or -1 on failure instead of terminating
+ * the program, so the library can also be called through ctypes.
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include "cachesim.h"
+
+#define MDRIVER_MAXLINE 1024 /* max string size */
+
+/*
+ * What an allocator reports about its heap through the optional stats
+ * hook. Fields the allocator doesn't know should be left alone; they
+ * are zero when the hook is called.
+ */
+typedef struct {
+    size_t heap_bytes;  /* bytes of memory the allocator holds */
+    size_t free_bytes;  /* ... of which are in free blocks */
+    int free_blocks;    /* number of free blocks */
+} mdriver_heapstats_t;
+
+/*
+ * An allocator under test. malloc, free, and realloc are required, the
+ * hooks may be NULL. Allocators that get their memory from memlib (like
+ * the mm.c packages) set uses_memlib: their heap is reset before each
+ * run, their blocks are checked against the extent of the heap, and
+ * their space utilization is measured. Checkpoints need save_state
+ * and restore_state, for the state the allocator keeps outside the
+ * heap: save_state returns the size of the state, and copies it to buf
+ * if it fits in size bytes. An allocator with no such state returns 0.
+ * The checkpoint functions fail for allocators without them.
+ */
+typedef struct {
+    const char *name;
+    int (*init)(void);                        /* <0 on failure */
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void (*checkheap)(int verbose);           /* check heap consistency */
+    void (*stats)(mdriver_heapstats_t *stats);/* report heap state */
+    int uses_memlib;
+    size_t (*save_state)(void *buf, size_t size); /* for checkpoints */
+    void (*restore_state)(const void *buf);
+} mdriver_allocator_t;
+
+/* The libc malloc package and the null allocator used for calibration */
+extern const mdriver_allocator_t mdriver_libc_allocator;
+extern const mdriver_allocator_t mdriver_null_allocator;
+
+/* Request types that cycles are attributed to (see the opcost result) */
+#define MDRIVER_MALLOC          0
+#define MDRIVER_FREE            1
+#define MDRIVER_REALLOC_INPLACE 2 /* realloc returned the same block */
+#define MDRIVER_REALLOC_MOVED   3 /* realloc moved the block */
+#define MDRIVER_NOPTYPES        4
+
+/* The calls of one request type and the cycles spent in them */
+typedef struct {
+    double calls;
+    double cycles;
+} mdriver_opcost_t;
+
+/*
+ * One window of consecutive requests of the windowed replay (see
+ * mdriver_eval_windows). Requests of payload size s are in size class
+ * c if 2^(c-1) < s <= 2^c; frees count with the size of their block.
+ */
+#define MDRIVER_NSIZECLASSES 32
+typedef struct {
+    int first;        /* first request of the window */
+    int ops;          /* requests in the window */
+    double cycles;    /* cycles spent in the allocator */
+    double secs;      /* ... in seconds */
+    long heap_growth; /* bytes the memlib heap grew by */
+    size_t heapsize;  /* ... to this size at the end of the window */
+    mdriver_opcost_t opcost[MDRIVER_NOPTYPES];     /* by request type */
+    mdriver_opcost_t sizecost[MDRIVER_NSIZECLASSES]; /* by size class */
+} mdriver_window_t;
+
+/* Page faults taken by one replay of a trace */
+typedef struct {
+    double minor;     /* faults served without I/O (first touches) */
+    double major;     /* faults that needed I/O */
+} mdriver_faults_t;
+
+/*
+ * The access model of the payload-touch replay, which plays the part
+ * of the application: it writes or reads one byte every stride bytes
+ * of the payloads it touches, so the cost of scattering blocks across
+ * the heap shows up as cache misses.
+ */
+typedef struct {
+    int stride;       /* bytes between the bytes touched in a payload */
+    int write_alloc;  /* write each payload after malloc and realloc? */
+    int period;       /* requests between re-touches (0: no re-touches) */
+    int recent;       /* ... of this many recently allocated live blocks */
+    int read_free;    /* read each payload before it is freed? */
+} mdriver_access_t;
+
+/* A trace file loaded in memory (opaque) */
+typedef struct mdriver_trace mdriver_trace_t;
+
+/*
+ * A checkpoint of a memlib allocator part way through a trace (opaque):
+ * the heap's contents and brk, the allocator's state outside the heap,
+ * and the blocks of the trace that are live. With the checkpoint
+ * option, mdriver_eval starts its replays from there instead of from
+ * the first request.
+ */
+typedef struct mdriver_checkpoint mdriver_checkpoint_t;
+
+/*
+ * A window of a trace that represents a cluster of windows with
+ * similar requests (see mdriver_simpoints). Timing the windows that
+ * represent a cluster estimates the time of all of its windows.
+ * Request numbers here and in checkpoints are 64-bit, so that their
+ * files outlast the int request count of the trace loader.
+ */
+#define MDRIVER_SIMPOINT_REPS 2 /* windows that represent a cluster */
+typedef struct {
+    long long first;  /* first request of the window */
+    long long ops;    /* requests in the window */
+    int cluster;      /* the cluster it represents */
+    int windows;      /* windows of the trace in the cluster */
+    double cluster_ops; /* requests in those windows */
+} mdriver_simpoint_t;
+
+/* The header of a trace file */
+typedef struct {
+    int sugg_heapsize;  /* suggested heap size */
+    int num_ids;        /* number of alloc/realloc ids */
+    int num_ops;        /* number of requests (at most INT_MAX) */
+    int weight;         /* weight of the trace in aggregate results */
+} mdriver_trace_info_t;
+
+/* What mdriver_eval does besides checking correctness */
+typedef struct {
+    int util;         /* measure space utilization (memlib allocators) */
+    int time;         /* measure throughput */
+    int calibrate;    /* also time the null allocator on the trace */
+    int check_heap;   /* call checkheap after every request when checking */
+    double budget;    /* max secs spent timing the trace (0 = no limit) */
+    int faults;       /* also time with a prefaulted and a discarded heap */
+    int fresh_heap;   /* also time with the heap's pages discarded before
+			 every sample (secs_discard, as with faults) */
+    int opcost;       /* attribute cycles to request types (extra replay) */
+    int touch;        /* replay touching the payloads (extra replays) */
+    mdriver_access_t access; /* how the touch replay touches payloads */
+    int simulate;     /* replay through the cache model (extra replay) */
+    cachesim_config_t geometry; /* ... of this cache and TLB */
+    int insns;        /* count retired instructions (extra replays) */
+    int profile;      /* sample the stacks of the timed replays ... */
+    int profile_hz;   /* ... this many times per CPU second */
+    const mdriver_checkpoint_t *checkpoint; /* replay from here (NULL: from
+					       the start; only with util,
+					       time, check_heap, and profile) */
+    long long last;   /* ... up to this request (0: the end; memlib only) */
+} mdriver_options_t;
+
+/* Summarizes the important stats for some allocator on some trace */
+typedef struct {
+    double ops;       /* number of ops (malloc/free/realloc) in the trace,
+			 from the checkpoint on if there is one */
+    int valid;        /* was the trace processed correctly by the allocator? */
+    double secs;      /* number of secs needed to run the trace */
+    double util;      /* space utilization (always 0 without memlib) */
+    double ovhd;      /* secs the driver itself needs to replay the trace */
+    double replayed;  /* fraction of the trace replayed by each sample */
+    int samples;      /* number of timed samples */
+    double spread;    /* relative spread of the best samples (<0: unknown) */
+    mdriver_heapstats_t heap; /* reported by the stats hook, if any */
+    size_t heapsize;  /* high-water mark of the memlib heap */
+    double secs_prefault; /* secs with the heap's pages mapped beforehand */
+    double secs_discard;  /* secs with the heap's pages discarded before */
+    mdriver_faults_t pgfaults;          /* ... in the replays timed for secs */
+    mdriver_faults_t pgfaults_prefault; /* ... for secs_prefault */
+    mdriver_faults_t pgfaults_discard;  /* ... for secs_discard */
+    mdriver_opcost_t opcost[MDRIVER_NOPTYPES]; /* by MDRIVER_ request type */
+    double touch_cycles;  /* cycles of the payload-touch replay */
+    double touch_misses;  /* ... and its LLC misses (<0: not available) */
+    cachesim_stats_t sim[CACHESIM_NSOURCES]; /* cache model, by source */
+    int profiled;     /* stacks sampled (see mdriver_write_profile) */
+    double insns;     /* instructions of one replay, net of the driver's
+			 (<0: not available) */
+
+    /* defined only if valid is false */
+    int errop;        /* request that failed (-1: not a single request) */
+    char errmsg[MDRIVER_MAXLINE]; /* what went wrong */
+
+    /* Note: secs and util are only defined if valid is true, ovhd
+       only if the driver overhead was calibrated, secs_prefault only
+       if faults was set, secs_discard only if faults or fresh_heap
+       was set, opcost only if opcost was set, touch_cycles and
+       touch_misses only if touch was set, sim only if simulate was
+       set, insns only if insns was set, and profiled only if profile
+       was set */
+} mdriver_result_t;
+
+/*
+ * Where an evaluation is, for a supervisor that watches it from
+ * another process through shared memory. opnum is the request that the
+ * passes that go request by request are at, and -1 in the timed
+ * replays, which are not slowed down to report it.
+ */
+#define MDRIVER_IDLE       0 /* not evaluating */
+#define MDRIVER_CHECK      1 /* checking correctness */
+#define MDRIVER_UTIL       2 /* measuring space utilization */
+#define MDRIVER_TIME       3 /* timing replays */
+#define MDRIVER_INSTRUMENT 4 /* replays with -E, -I, -O, -S, or -T instrumentation */
+typedef struct {
+    volatile int phase;  /* MDRIVER_ phase */
+    volatile int opnum;  /* request number within the trace (or -1) */
+} mdriver_progress_t;
+
+/* Verbosity of the library's progress messages (0, 1, or 2) */
+extern int mdriver_verbose;
+
+/* Initialize the timing package and the simulated memory system */
+int mdriver_init(void);
+
+/* Give memlib allocators a heap of bytes bytes instead of MAX_HEAP */
+int mdriver_set_heap_limit(size_t bytes);
+
+/* Report the progress of evaluations in *progress (NULL: stop) */
+void mdriver_set_progress(mdriver_progress_t *progress);
+
+/* Fill in the options mdriver uses by default */
+void mdriver_default_options(mdriver_options_t *opts);
+
+/* Load a trace file (at most INT_MAX requests), or return NULL */
+mdriver_trace_t *mdriver_read_trace(const char *path);
+void mdriver_free_trace(mdriver_trace_t *trace);
+int mdriver_trace_num_ops(const mdriver_trace_t *trace);
+
+/* 
+ * Build a trace that replays copies independent copies of trace (with
+ * remapped ids) in one heap, interleaved round-robin or at random.
+ * Free it with mdriver_free_trace. Returns NULL on failure.
+ */
+#define MDRIVER_ROUND_ROBIN 0
+#define MDRIVER_RANDOM      1
+mdriver_trace_t *mdriver_scale_trace(const mdriver_trace_t *trace,
+				     int copies, int interleave,
+				     unsigned seed);
+void mdriver_trace_info(const mdriver_trace_t *trace, 
+			mdriver_trace_info_t *info);
+
+/* Evaluate alloc on trace. Returns result->valid, or -1 on bad args */
+int mdriver_eval(const mdriver_allocator_t *alloc, mdriver_trace_t *trace,
+		 const mdriver_options_t *opts, mdriver_result_t *result);
+
+/*
+ * Check alloc on the first opnum requests of trace and take a
+ * checkpoint there. If from is not NULL, only the requests after that
+ * earlier checkpoint are replayed. Checkpoints can be written to a file
+ * and read back by another run of the same program on the same trace,
+ * if the heap's address range is free in that run. Returns NULL on
+ * failure.
+ */
+mdriver_checkpoint_t *mdriver_checkpoint(const mdriver_allocator_t *alloc,
+					 mdriver_trace_t *trace,
+					 const mdriver_checkpoint_t *from,
+					 long long opnum);
+int mdriver_write_checkpoint(const mdriver_checkpoint_t *ckpt,
+			     const char *path);
+mdriver_checkpoint_t *mdriver_read_checkpoint(const char *path);
+void mdriver_free_checkpoint(mdriver_checkpoint_t *ckpt);
+long long mdriver_checkpoint_opnum(const mdriver_checkpoint_t *ckpt);
+
+/*
+ * Replay trace once more, timing each request with the cycle counter,
+ * and append one Chrome trace event per request (plus a "heap" counter
+ * for memlib allocators) to fp, as process pid named name. Every event
+ * is written as a comma and a JSON object, so the caller opens the
+ * traceEvents array with an element of its own. Only the last
+ * MDRIVER_MAXEVENTS requests of a longer trace are kept. Returns the
+ * number of events, or -1 if the allocator failed.
+ */
+#define MDRIVER_MAXEVENTS (1<<18)
+int mdriver_write_events(const mdriver_allocator_t *alloc,
+			 mdriver_trace_t *trace, const char *name, int pid,
+			 FILE *fp);
+
+/*
+ * Replay trace MDRIVER_WINDOW_RUNS more times, timing each request
+ * with the cycle counter, and describe every window of window
+ * consecutive requests in windows[], from the replay in which the
+ * window was fastest. windows needs room for ceil(num_ops/window)
+ * windows. Returns their number, or -1 if the allocator failed.
+ */
+#define MDRIVER_WINDOW_RUNS 3
+int mdriver_eval_windows(const mdriver_allocator_t *alloc,
+			 mdriver_trace_t *trace, int window,
+			 mdriver_window_t *windows);
+
+/*
+ * Split trace into windows of window requests and cluster them into at
+ * most k clusters, on their mix of request types and sizes and on the
+ * payload bytes live at their end. Put up to MDRIVER_SIMPOINT_REPS
+ * windows per cluster, those closest to its center, in points (room
+ * for k*MDRIVER_SIMPOINT_REPS), in trace order. Returns their number,
+ * or -1 on failure.
+ */
+int mdriver_simpoints(const mdriver_trace_t *trace, int window, int k,
+		      mdriver_simpoint_t *points);
+
+/*
+ * Check alloc on trace from the checkpoint ckpt (at or before the
+ * window point) to the end of the window, and time the window in
+ * MDRIVER_SIMPOINT_RUNS replays (after one that is not timed), putting
+ * their secs in secs[]. Each replay restores the checkpoint once,
+ * untimed, and replays the requests up to the window untimed too, so
+ * that the window runs on a warm heap, caches, and TLB, as it does
+ * within a replay of the whole trace. Copying the checkpoint back
+ * flushes the caches, so the further ahead of the window it is, the
+ * warmer the window runs. Returns 0, or -1 on failure.
+ */
+#define MDRIVER_SIMPOINT_RUNS 5
+int mdriver_time_simpoint(const mdriver_allocator_t *alloc,
+			  mdriver_trace_t *trace,
+			  const mdriver_checkpoint_t *ckpt,
+			  const mdriver_simpoint_t *point, double *secs);
+
+/*
+ * Write the stacks sampled in the timed replays of the last
+ * mdriver_eval with the profile option to fp as folded stacks (one
+ * "root;caller;...;callee count" line per distinct stack), ready for
+ * flamegraph.pl. Returns the number of samples, or -1 on failure.
+ */
+int mdriver_write_profile(FILE *fp, const char *root);
+
+/* Explain why the last call that returned NULL or -1 failed */
+const char *mdriver_error(void);
+
+#endif /* __LIBMDRIVER_H_ */
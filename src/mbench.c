@@ -0,0 +1,414 @@
+/*
+ * mbench.c - Microbenchmarks for the malloc package in mm.c
+ *
+ * Runs synthetic request patterns against the mm.h interface, without
+ * any trace files, and reports the time and the last-level cache
+ * misses per request. Each pattern stresses a different path of the
+ * allocator (fitting, splitting, coalescing, growing the heap), so a
+ * regression in one of them shows up in one row of the table instead
+ * of being averaged into the throughput of a whole trace.
+ *
+ * Every benchmark runs on a fresh heap: mem_reset_brk and mm_init,
+ * then an untimed setup phase, then the timed requests. The fastest of
+ * several repetitions is reported.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "perfctr.h"
+
+/**********************
+ * Constants and macros
+ **********************/
+#define DEFAULT_BLOCKS 4000 /* blocks live at once in most benchmarks */
+#define DEFAULT_REPS      5 /* repetitions of each benchmark */
+#define LADDER_TOP    65536 /* realloc ladders grow blocks to this size */
+#define MIXED_MAX      1024 /* max size of the randomly sized blocks */
+#define SEED              1 /* seed of the random free orders and sizes */
+
+/*
+ * A benchmark: an untimed setup and the timed requests. run returns
+ * the number of requests it made, or -1 if the allocator failed.
+ */
+typedef struct {
+    char *name;
+    size_t size;     /* block size (0: random sizes up to MIXED_MAX) */
+    void (*setup)(int n, size_t size);
+    int (*run)(int n, size_t size);
+} bench_t;
+
+/********************
+ * Global variables
+ *******************/
+static char **blocks;   /* the blocks allocated by a benchmark */
+static int *order;      /* the order in which they are freed */
+static size_t *sizes;   /* and their sizes */
+
+/*********************
+ * Function prototypes
+ *********************/
+
+/* The benchmarks */
+static void setup_none(int n, size_t size);
+static void setup_random(int n, size_t size);
+static void setup_holes(int n, size_t size);
+static int run_pairs(int n, size_t size);
+static int run_lifo(int n, size_t size);
+static int run_fifo(int n, size_t size);
+static int run_random(int n, size_t size);
+static int run_ladder(int n, size_t size);
+static int run_holes(int n, size_t size);
+static int run_phases(int n, size_t size);
+
+/* Various helper routines */
+static int alloc_blocks(int n, size_t size);
+static double get_secs(void);
+static void usage(void);
+static void unix_error(char *msg);
+
+/*
+ * The benchmark table. Rows with the same name are the same pattern
+ * on different block sizes.
+ */
+static bench_t benches[] = {
+    /* malloc/free pairs across the size spectrum */
+    {"pairs",      16, setup_none,   run_pairs},
+    {"pairs",      64, setup_none,   run_pairs},
+    {"pairs",     256, setup_none,   run_pairs},
+    {"pairs",    1024, setup_none,   run_pairs},
+    {"pairs",    4096, setup_none,   run_pairs},
+    /* allocate n blocks, then free them in some order */
+    {"lifo",       64, setup_none,   run_lifo},
+    {"fifo",       64, setup_none,   run_fifo},
+    {"random",     64, setup_random, run_random},
+    {"random",      0, setup_random, run_random},
+    /* grow blocks by doubling them with realloc, like a vector */
+    {"ladder",     16, setup_none,   run_ladder},
+    /* allocate past a long list of free blocks too small to fit */
+    {"holes",      32, setup_holes,  run_holes},
+    /* allocate everything, then free everything */
+    {"phases",      0, setup_random, run_phases},
+};
+#define NBENCHES (sizeof(benches) / sizeof(bench_t))
+
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int n = DEFAULT_BLOCKS;   /* number of blocks (set by -n) */
+    int reps = DEFAULT_REPS;  /* repetitions (set by -r) */
+    char *only = NULL;        /* run only this benchmark (set by -b) */
+    int ctr, ops, bestops, i, r;
+    double secs, misses, bestsecs, bestmisses;
+    char c;
+
+    while ((c = getopt(argc, argv, "b:n:r:h")) != EOF) {
+        switch (c) {
+	case 'b': /* Run only the rows of one benchmark */
+	    only = optarg;
+	    break;
+	case 'n': /* Number of blocks */
+	    n = atoi(optarg);
+	    break;
+	case 'r': /* Number of repetitions */
+	    reps = atoi(optarg);
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (n < 1 || reps < 1) {
+	usage();
+	exit(1);
+    }
+
+    /* Room for the holes benchmark, which allocates 2n blocks */
+    if ((blocks = (char **)calloc(2*n, sizeof(char *))) == NULL ||
+	(order = (int *)calloc(2*n, sizeof(int))) == NULL ||
+	(sizes = (size_t *)calloc(2*n, sizeof(size_t))) == NULL)
+	unix_error("calloc in main failed");
+
+    mem_init();
+    if ((ctr = perfctr_open(PERFCTR_CACHE_MISSES)) < 0)
+	printf("Cache misses are not available (perf_event)\n");
+
+    printf("%-8s%6s%10s%10s%10s\n", "bench", "size", "ops", "ns/op",
+	   "miss/op");
+    for (i = 0; i < (int)NBENCHES; i++) {
+	if (only && strcmp(only, benches[i].name))
+	    continue;
+
+	bestops = 0;
+	bestsecs = 0;
+	bestmisses = -1;
+	for (r = 0; r < reps; r++) {
+	    mem_reset_brk();
+	    if (mm_init() < 0) {
+		bestops = -1;
+		break;
+	    }
+	    benches[i].setup(n, benches[i].size);
+
+	    secs = get_secs();
+	    perfctr_start(ctr);
+	    ops = benches[i].run(n, benches[i].size);
+	    misses = perfctr_stop(ctr);
+	    secs = get_secs() - secs;
+
+	    if (ops < 0) {
+		bestops = -1;
+		break;
+	    }
+	    if (r == 0 || secs < bestsecs) {
+		bestops = ops;
+		bestsecs = secs;
+		bestmisses = misses;
+	    }
+	}
+
+	if (benches[i].size)
+	    printf("%-8s%6d", benches[i].name, (int)benches[i].size);
+	else
+	    printf("%-8s%6s", benches[i].name, "mixed");
+	if (bestops <= 0)
+	    printf("%10s%10s%10s\n", "failed", "-", "-");
+	else if (bestmisses < 0)
+	    printf("%10d%10.1f%10s\n", bestops, bestsecs*1e9/bestops, "-");
+	else
+	    printf("%10d%10.1f%10.3f\n", bestops, bestsecs*1e9/bestops,
+		   bestmisses/bestops);
+    }
+
+    perfctr_close(ctr);
+    exit(0);
+}
+
+
+/*****************************************************************
+ * The benchmarks. A size of 0 means the sizes chosen by the setup.
+ ****************************************************************/
+
+/*
+ * setup_none - Nothing to set up: the benchmark starts on an empty heap
+ */
+static void setup_none(int n, size_t size)
+{
+}
+
+/*
+ * setup_random - Choose a random free order of n blocks and, if size is
+ *     0, random block sizes
+ */
+static void setup_random(int n, size_t size)
+{
+    int i, j, tmp;
+
+    srand(SEED);
+    for (i = 0; i < n; i++) {
+	order[i] = i;
+	sizes[i] = size ? size : 1 + rand() % MIXED_MAX;
+    }
+    for (i = n-1; i > 0; i--) {
+	j = rand() % (i+1);
+	tmp = order[i];
+	order[i] = order[j];
+	order[j] = tmp;
+    }
+}
+
+/*
+ * setup_holes - Allocate 2n blocks and free every other one. This
+ *     leaves n free blocks that can't be coalesced, since each is
+ *     surrounded by allocated blocks.
+ */
+static void setup_holes(int n, size_t size)
+{
+    int i;
+
+    memset(blocks, 0, 2*n*sizeof(char *));
+    for (i = 0; i < 2*n; i++)
+	if ((blocks[i] = mm_malloc(size)) == NULL)
+	    return;
+    for (i = 0; i < 2*n; i += 2)
+	mm_free(blocks[i]);
+}
+
+/*
+ * run_pairs - n mallocs, each immediately freed
+ */
+static int run_pairs(int n, size_t size)
+{
+    char *p;
+    int i;
+
+    for (i = 0; i < n; i++) {
+	if ((p = mm_malloc(size)) == NULL)
+	    return -1;
+	mm_free(p);
+    }
+    return 2*n;
+}
+
+/*
+ * run_lifo - Allocate n blocks, and free the last one first
+ */
+static int run_lifo(int n, size_t size)
+{
+    int i;
+
+    if (alloc_blocks(n, size) < 0)
+	return -1;
+    for (i = n-1; i >= 0; i--)
+	mm_free(blocks[i]);
+    return 2*n;
+}
+
+/*
+ * run_fifo - Allocate n blocks, and free the first one first
+ */
+static int run_fifo(int n, size_t size)
+{
+    int i;
+
+    if (alloc_blocks(n, size) < 0)
+	return -1;
+    for (i = 0; i < n; i++)
+	mm_free(blocks[i]);
+    return 2*n;
+}
+
+/*
+ * run_random - Allocate n blocks, and free them in random order
+ */
+static int run_random(int n, size_t size)
+{
+    int i;
+
+    if (alloc_blocks(n, size) < 0)
+	return -1;
+    for (i = 0; i < n; i++)
+	mm_free(blocks[order[i]]);
+    return 2*n;
+}
+
+/*
+ * run_ladder - Grow n/100 blocks from size to LADDER_TOP bytes by
+ *     doubling them with realloc, freeing each block at the top
+ */
+static int run_ladder(int n, size_t size)
+{
+    int ladders = (n >= 100) ? n/100 : 1;
+    int i, ops = 0;
+    size_t s;
+    char *p;
+
+    for (i = 0; i < ladders; i++) {
+	if ((p = mm_malloc(size)) == NULL)
+	    return -1;
+	for (s = 2*size; s <= LADDER_TOP; s *= 2, ops++)
+	    if ((p = mm_realloc(p, s)) == NULL)
+		return -1;
+	mm_free(p);
+	ops += 2;
+    }
+    return ops;
+}
+
+/*
+ * run_holes - With the n holes left by setup_holes, allocate n/10
+ *     blocks that are too large for any of them. A first-fit search
+ *     of a single free list visits every hole each time.
+ */
+static int run_holes(int n, size_t size)
+{
+    int m = (n >= 10) ? n/10 : 1;
+    int i;
+
+    if (blocks[2*n-1] == NULL) /* setup_holes ran out of memory */
+	return -1;
+    for (i = 0; i < m; i++)
+	if (mm_malloc(2*size + 8) == NULL)
+	    return -1;
+    return m;
+}
+
+/*
+ * run_phases - Allocate n blocks of the sizes chosen by setup_random,
+ *     then free all of them in allocation order
+ */
+static int run_phases(int n, size_t size)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+	if ((blocks[i] = mm_malloc(sizes[i])) == NULL)
+	    return -1;
+    for (i = 0; i < n; i++)
+	mm_free(blocks[i]);
+    return 2*n;
+}
+
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/*
+ * alloc_blocks - Allocate blocks[0..n-1], of size bytes each or of the
+ *     sizes chosen by setup_random if size is 0
+ */
+static int alloc_blocks(int n, size_t size)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+	if ((blocks[i] = mm_malloc(size ? size : sizes[i])) == NULL)
+	    return -1;
+    return 0;
+}
+
+/*
+ * get_secs - The time of day in seconds
+ */
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1e6;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mbench [-h] [-b <bench>] [-n <blocks>] [-r <reps>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b <bench>   Run only the rows of benchmark <bench>.\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-n <blocks>  Number of blocks (default %d).\n",
+	    DEFAULT_BLOCKS);
+    fprintf(stderr, "\t-r <reps>    Repetitions of each benchmark (default %d).\n",
+	    DEFAULT_REPS);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    perror(msg);
+    exit(1);
+}
@@ -2,7 +2,8 @@
  * mdriver.c - CS:APP Malloc Lab Driver
  * 
  * Uses a collection of trace files to tests a malloc/free/realloc
- * implementation in mm.c.
+ * implementation in mm.c. The evaluation itself is done by the
+ * library in libmdriver.c.
  *
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
@@ -15,10 +16,15 @@
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#include <math.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "mm.h"
-#include "memlib.h"
-#include "fsecs.h"
+#include "libmdriver.h"
 #include "config.h"
 
 /**********************
@@ -29,67 +35,75 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define MAXMIX      1024 /* max number of traces in a workload-mix profile */
 
-/* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
-
-/****************************** 
- * The key compound data types 
- *****************************/
-
-/* Records the extent of each block's payload */
-typedef struct range_t {
-    char *lo;              /* low payload address */
-    char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
-} range_t;
-
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    int sugg_heapsize;   /* suggested heap size (unused) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
+/* Summarizes the important stats for some malloc function on some trace */
+typedef mdriver_result_t stats_t;
 
-/* 
- * Holds the params to the xxx_speed functions, which are timed by fcyc. 
- * This struct is necessary because fcyc accepts only a pointer array
- * as input.
+/*
+ * What the child process that evaluates a trace reports back, in
+ * memory shared with the driver. If the child dies, progress says
+ * where.
  */
 typedef struct {
-    trace_t *trace;  
-    range_t *ranges;
-} speed_t;
-
-/* Summarizes the important stats for some malloc function on some trace */
-typedef struct {
-    /* defined for both libc malloc and student malloc package (mm.c) */
-    double ops;      /* number of ops (malloc/free/realloc) in the trace */
-    int valid;       /* was the trace processed correctly by the allocator? */
-    double secs;     /* number of secs needed to run the trace */
-
-    /* defined only for the student malloc package */
-    double util;     /* space utilization for this trace (always 0 for libc) */
-
-    /* Note: secs and util are only defined if valid is true */
-} stats_t; 
+    stats_t stats;               /* the result of the evaluation */
+    mdriver_progress_t progress; /* where the evaluation is */
+    int finished;                /* did the evaluation return? */
+    int events_failed;           /* did writing the timeline fail? */
+    char events_msg[MAXLINE];    /* ... and why */
+} watch_t;
 
 /********************
  * Global variables
  *******************/
-int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int calibrate = 0; /* If set, measure the driver overhead (set by -c) */
+static double budget = 0; /* If set, secs to spend timing a trace (set by -B) */
+static int mix = 0;       /* If set, a workload-mix profile is used (-m) */
+static int faults = 0;    /* If set, time with and without page faults (-F) */
+static int fresh_heap = 0; /* If set, also time on a fresh heap (-D) */
+static char *eventfile = NULL; /* If set, per-request timeline file (-E) */
+static int opcost = 0;    /* If set, attribute cycles to request types (-O) */
+static int touch = 0;     /* If set, replay touching the payloads (-T) */
+static char *access_model = NULL; /* If set, how they are touched (-A) */
+static int simulate = 0;  /* If set, replay through the cache model (-S) */
+static char *geometry = NULL; /* If set, the model's geometry (-G) */
+static char *profilefile = NULL; /* If set, folded stacks file (-P) */
+static FILE *profilefp = NULL;   /* ... open for the traces */
+static int profile_hz = PROFILE_HZ; /* ... sampled at this rate (-p) */
+static int thru_metric = THRU_METRIC; /* THRU_TIME or THRU_MODEL (-I) */
+static int window = 0;    /* If set, requests per window of a report (-w) */
+static double window_factor = WINDOW_FACTOR; /* ... that flags windows this
+						much slower than the median */
+static int calibrate_libc = 0; /* If set, cap with libc on this host (-L) */
+static char *checkpoint_file = NULL; /* If set, replay from a checkpoint in
+					this file (-C or -R) ... */
+static long long checkpoint_at = -1; /* ... taken at this request first
+					 (-C) */
+static char *simpoint_file = NULL; /* If set, estimate from representative
+				      windows indexed in this file (-s or -e) */
+static int simpoint_k = 0; /* ... picked from this many clusters first (-s) */
+static int simpoint_window = 0; /* ... of this many requests each (-s) */
+static int copies = 1;    /* Copies of each trace replayed at once (-K) */
+static int interleave = MDRIVER_ROUND_ROBIN; /* ... and how (set by -i) */
+static double heap_limit = 0; /* If set, size of the simulated heap (-H) */
+static int isolate = 1;   /* If set, evaluate traces in children (reset by -X) */
+static double cpu_limit = TRACE_CPU_LIMIT; /* CPU secs per trace (set by -W) */
+static watch_t *watch;    /* shared with the child that evaluates a trace */
+
+/* What the evaluation was doing, by MDRIVER_ phase */
+static char *phasenames[] = {
+    "", " while checking correctness", " while measuring utilization",
+    " while timing", " in an instrumented replay"
+};
+
+/* Column titles of the MDRIVER_ request types */
+static char *opnames[MDRIVER_NOPTYPES] = {"malloc", "free", "re-in", "re-mv"};
+
+/* How the perf index weighs utilization and caps throughput */
+static double util_weight = UTIL_WEIGHT;
+static double libc_thruput = AVG_LIBC_THRUPUT;
+static double model_libc_thruput = MODEL_LIBC_THRUPUT; /* ... with -I */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
 /* Directory where default tracefiles are found */
@@ -100,36 +114,78 @@ static char *default_tracefiles[] = {
     DEFAULT_TRACEFILES, NULL
 };
 
+/* The student's malloc package in mm.c */
+static const mdriver_allocator_t mm_allocator = {
+    "mm", mm_init, mm_malloc, mm_free, mm_realloc, NULL, NULL, 1,
+    mm_save_state, mm_restore_state /* NULL unless mm.c defines them */
+};
+
 
 /********************* 
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
-static int add_range(range_t **ranges, char *lo, int size, 
-		     int tracenum, int opnum);
-static void remove_range(range_t **ranges, char *lo);
-static void clear_ranges(range_t **ranges);
-
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(char *tracedir, char *filename);
-static void free_trace(trace_t *trace);
-
-/* Routines for evaluating the correctness and speed of libc malloc */
-static int eval_libc_valid(trace_t *trace, int tracenum);
-static void eval_libc_speed(void *ptr);
-
-/* Routines for evaluating correctnes, space utilization, and speed 
-   of the student's malloc package in mm.c */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
-static void eval_mm_speed(void *ptr);
+/* Load a trace file from tracedir, or die trying */
+static mdriver_trace_t *read_trace(char *tracedir, char *filename);
+
+/* Evaluate a trace, in a supervised child process unless -X */
+static void eval_trace(const mdriver_allocator_t *alloc, 
+		       mdriver_trace_t *trace, mdriver_options_t *opts, 
+		       char *name, int pid, FILE *eventfp);
+static void run_trace(const mdriver_allocator_t *alloc, 
+		      mdriver_trace_t *trace, mdriver_options_t *opts, 
+		      char *name, int pid, FILE *eventfp);
+static double trace_cpu_limit(void);
+static void trace_died(mdriver_trace_t *trace, int status, int timedout,
+		       struct rusage *usage, double limit);
+static double wall_secs(void);
+
+/* Estimate the secs of a trace from representative windows (-s, -e) */
+static void run_simpoints(const mdriver_allocator_t *alloc,
+			  mdriver_trace_t *trace, mdriver_options_t *opts);
+static double estimate_secs(const mdriver_allocator_t *alloc,
+			    mdriver_trace_t *trace,
+			    mdriver_simpoint_t *points, int n,
+			    double *spread);
+static int write_simpoints(char *path, mdriver_simpoint_t *points, int n,
+			   int window, double util, double bias);
+static int read_simpoints(char *path, mdriver_simpoint_t **points,
+			  int *window, double *util, double *bias);
+
+/* Read the traces, weights, and perf index weighting of a workload mix */
+static int read_profile(char *path, char ***tracefiles, double **weights);
+static void free_tracefiles(char **tracefiles, double *weights);
+
+/* The libc throughput cap calibrated on this host (-L) */
+static void libc_key(char *key, char **tracefiles, double *weights, int n);
+static double cached_libc_thruput(char *key);
+static void cache_libc_thruput(char *key, double thruput);
+static double libc_throughput(int n, stats_t *stats, double *weights);
 
 /* Various helper routines */
-static void printresults(int n, stats_t *stats);
+static void printresults(int n, stats_t *stats, double *weights);
+static void printovhd(double ops, double secs, double ovhd);
+static void printconfidence(int n, stats_t *stats);
+static void printfaults(int n, stats_t *stats);
+static void printopshares(mdriver_opcost_t *opcost);
+static void printopcosts(int n, stats_t *stats);
+static void printtouch(int n, stats_t *stats);
+static void printsim(int n, stats_t *stats);
+static void printmodel(int n, stats_t *stats);
+static int printwindows(const mdriver_allocator_t *alloc,
+			mdriver_trace_t *trace, char *name);
+static int cmp_doubles(const void *a, const void *b);
+static void parse_window(char *arg);
+static void parse_checkpoint(char *arg);
+static void parse_simpoints(char *arg);
+static double model_secs(stats_t *stats);
+static void parse_access(char *arg, mdriver_access_t *access);
+static void parse_geometry(char *arg, cachesim_config_t *config);
+static double parse_secs(char *arg);
+static double parse_bytes(char *arg);
 static void usage(void);
 static void unix_error(char *msg);
-static void malloc_error(int tracenum, int opnum, char *msg);
+static void malloc_error(int tracenum, stats_t *stats);
 static void app_error(char *msg);
 
 /**************
@@ -141,11 +197,12 @@ int main(int argc, char **argv)
     char c;
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
-    trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
+    double *weights = NULL;    /* weight of each trace (<0: use its header) */
+    mdriver_trace_info_t info; /* the header of a trace file */
+    mdriver_trace_t *trace = NULL; /* stores a single trace file in memory */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
-    speed_t speed_params;      /* input parameters to the xx_speed routines */ 
+    mdriver_options_t opts;    /* what the library measures */
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
@@ -153,26 +210,40 @@ int main(int argc, char **argv)
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
+    double ovhd, weight, prefault, discard, minflt, majflt;
+    double cycles, misses, thru_cap, thru;
+    char libc_cache_key[MAXLINE]; /* CPU model, metric, and traces (-L) */
+
+    FILE *eventfp = NULL;      /* the per-request timeline (-E) */
+    int samples;               /* stacks written to the profile (-P) */
     int numcorrect;
     
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:A:B:C:e:E:G:H:K:m:p:P:R:s:w:W:hvVgalcDFILOSTXi")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
 	    break;
         case 'f': /* Use one specific trace file only (relative to curr dir) */
+	    free_tracefiles(tracefiles, weights);
+	    weights = NULL;
             num_tracefiles = 1;
-            if ((tracefiles = realloc(tracefiles, 2*sizeof(char *))) == NULL)
-		unix_error("ERROR: realloc failed in main");
+            if ((tracefiles = malloc(2*sizeof(char *))) == NULL)
+		unix_error("ERROR: malloc failed in main");
 	    strcpy(tracedir, "./"); 
             tracefiles[0] = strdup(optarg);
             tracefiles[1] = NULL;
+	    mix = 0;
             break;
+	case 'm': /* Use the traces and weights of a workload-mix profile */
+	    free_tracefiles(tracefiles, weights);
+	    num_tracefiles = read_profile(optarg, &tracefiles, &weights);
+	    mix = 1;
+	    break;
 	case 't': /* Directory where the traces are located */
-	    if (num_tracefiles == 1) /* ignore if -f already encountered */
+	    if (num_tracefiles == 1 && !mix) /* ignore if -f already encountered */
 		break;
 	    strcpy(tracedir, optarg);
 	    if (tracedir[strlen(tracedir)-1] != '/') 
@@ -184,11 +255,96 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'c': /* Calibrate the driver overhead with a null allocator */
+            calibrate = 1;
+            break;
+        case 'C': /* Take a checkpoint and replay from it */
+            parse_checkpoint(optarg);
+            break;
+        case 'R': /* Replay from a checkpoint taken before */
+            checkpoint_file = optarg;
+            checkpoint_at = -1;
+            break;
+        case 's': /* Pick representative windows, estimate, and compare */
+            parse_simpoints(optarg);
+            break;
+        case 'e': /* Estimate from representative windows picked before */
+            simpoint_file = optarg;
+            simpoint_k = 0;
+            break;
+        case 'E': /* Write a per-request timeline of each trace */
+            eventfile = optarg;
+            break;
+        case 'D': /* Also time with a fresh heap for every sample */
+            fresh_heap = 1;
+            break;
+        case 'F': /* Time with a prefaulted and with a discarded heap */
+            faults = 1;
+            break;
+        case 'H': /* Size of the simulated heap */
+            heap_limit = parse_bytes(optarg);
+            break;
+        case 'K': /* Replay this many copies of each trace in one heap */
+            if ((copies = atoi(optarg)) < 1) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'i': /* Interleave the copies at random */
+            interleave = MDRIVER_RANDOM;
+            break;
+        case 'I': /* Score throughput with the cost model */
+            thru_metric = THRU_MODEL;
+            break;
+        case 'L': /* Cap throughput with libc on this host */
+            calibrate_libc = 1;
+            break;
+        case 'O': /* Attribute cycles to malloc, free, and realloc */
+            opcost = 1;
+            break;
+        case 'T': /* Replay once more, touching the payloads */
+            touch = 1;
+            break;
+        case 'A': /* Access model of the payload-touch replay */
+            access_model = optarg;
+            touch = 1;
+            break;
+        case 'P': /* Sample the stacks of the timed replays */
+            profilefile = optarg;
+            break;
+        case 'p': /* Sampling rate of the profiler */
+            if ((profile_hz = atoi(optarg)) <= 0) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'S': /* Replay once more through the cache model */
+            simulate = 1;
+            break;
+        case 'G': /* Geometry of the cache model */
+            geometry = optarg;
+            simulate = 1;
+            break;
+        case 'w': /* Report throughput and heap growth by window */
+            parse_window(optarg);
+            break;
+        case 'W': /* CPU time limit for evaluating each trace */
+            if ((cpu_limit = parse_secs(optarg)) <= 0) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'X': /* Evaluate the traces in the driver process itself */
+            isolate = 0;
+            break;
+        case 'B': /* Time budget for timing each trace */
+            budget = parse_secs(optarg);
+            break;
         case 'v': /* Print per-trace performance breakdown */
-            verbose = 1;
+            mdriver_verbose = 1;
             break;
         case 'V': /* Be more verbose than -v */
-            verbose = 2;
+            mdriver_verbose = 2;
             break;
         case 'h': /* Print this message */
 	    usage();
@@ -232,14 +388,93 @@ int main(int argc, char **argv)
 	printf("Using default tracefiles in %s\n", tracedir);
     }
 
-    /* Initialize the timing package */
-    init_fsecs();
+    /* Without a profile, each trace is weighted as its header says */
+    if (!mix) {
+	if ((weights = (double *)malloc(num_tracefiles*sizeof(double))) == NULL)
+	    unix_error("weights malloc in main failed");
+	for (i=0; i < num_tracefiles; i++)
+	    weights[i] = -1;
+    }
+
+    /* A checkpoint is of one trace, and only for the basic measurements */
+    if (checkpoint_file || simpoint_file) {
+	if (num_tracefiles != 1)
+	    app_error("ERROR: -C, -R, -s, and -e take a single trace (-f)");
+	if (run_libc || calibrate_libc || eventfile || window || opcost ||
+	    touch || simulate || thru_metric == THRU_MODEL || faults ||
+	    fresh_heap || (checkpoint_file && simpoint_file))
+	    app_error("ERROR: -C, -R, -s, and -e don't combine with each "
+		      "other or with -D, -E, -F, -I, -l, -L, -O, -S, -T, or -w");
+    }
+
+    /*
+     * The stack samples of -P run inside the timed replays, so a
+     * profiled perf index is no score. Without the frame pointers of
+     * mdriver-prof, the samples only have their innermost function.
+     */
+    if (profilefile && autograder)
+	app_error("ERROR: -P slows the timed replays, "
+		  "so it can't be used with -g");
+#ifndef MDRIVER_PROF
+    if (profilefile)
+	printf("Note: -P only records whole stacks in mdriver-prof "
+	       "(make mdriver-prof)\n");
+#endif
+
+    /* Initialize the timing package and the simulated memory system */
+    if (mdriver_init() < 0)
+	app_error((char *)mdriver_error());
+    if (heap_limit > 0 && mdriver_set_heap_limit((size_t)heap_limit) < 0)
+	app_error((char *)mdriver_error());
+    mdriver_default_options(&opts);
+
+    /* The child that evaluates a trace reports back in shared memory */
+    watch = (watch_t *)mmap(NULL, sizeof(watch_t), PROT_READ|PROT_WRITE,
+			    MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (watch == MAP_FAILED)
+	unix_error("mmap of the shared results failed");
+    mdriver_set_progress(&watch->progress);
+    opts.calibrate = calibrate;
+    opts.budget = budget;
+    opts.faults = faults;
+    opts.fresh_heap = fresh_heap;
+    opts.opcost = opcost;
+    opts.touch = touch;
+    if (access_model)
+	parse_access(access_model, &opts.access);
+    opts.simulate = simulate;
+    if (geometry)
+	parse_geometry(geometry, &opts.geometry);
+    opts.insns = (thru_metric == THRU_MODEL);
+    opts.profile = (profilefile != NULL);
+    opts.profile_hz = profile_hz;
+    if (profilefile && (profilefp = fopen(profilefile, "w")) == NULL)
+	unix_error(profilefile);
+
+    /*
+     * With -L, the throughput cap is libc's throughput on this host,
+     * from the cache if libc has been timed on it and on these traces
+     * before, and measured (and cached) below otherwise or with -l.
+     */
+    if (calibrate_libc) {
+	libc_key(libc_cache_key, tracefiles, weights, num_tracefiles);
+	if (!run_libc && (thru = cached_libc_thruput(libc_cache_key)) > 0) {
+	    if (thru_metric == THRU_MODEL)
+		model_libc_thruput = thru;
+	    else
+		libc_thruput = thru;
+	    printf("Using the cached libc throughput of %.0f Kops as the cap\n",
+		   thru/1e3);
+	}
+	else
+	    run_libc = 1;
+    }
 
     /*
      * Optionally run and evaluate the libc malloc package 
      */
     if (run_libc) {
-	if (verbose > 1)
+	if (mdriver_verbose > 1)
 	    printf("\nTesting libc malloc\n");
 	
 	/* Allocate libc stats array, with one stats_t struct per tracefile */
@@ -250,104 +485,293 @@ int main(int argc, char **argv)
 	/* Evaluate the libc malloc package using the K-best scheme */
 	for (i=0; i < num_tracefiles; i++) {
 	    trace = read_trace(tracedir, tracefiles[i]);
-	    libc_stats[i].ops = trace->num_ops;
-	    if (verbose > 1)
-		printf("Checking libc malloc for correctness, ");
-	    libc_stats[i].valid = eval_libc_valid(trace, i);
-	    if (libc_stats[i].valid) {
-		speed_params.trace = trace;
-		if (verbose > 1)
-		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+	    mdriver_trace_info(trace, &info);
+	    if (weights[i] < 0)
+		weights[i] = info.weight;
+	    eval_trace(&mdriver_libc_allocator, trace, &opts, 
+		       tracefiles[i], i+1, NULL);
+	    libc_stats[i] = watch->stats;
+	    if (!libc_stats[i].valid) {
+		malloc_error(i, &libc_stats[i]);
+		unix_error("System message");
 	    }
-	    free_trace(trace);
+	    mdriver_free_trace(trace);
 	}
 
 	/* Display the libc results in a compact table */
-	if (verbose) {
+	if (mdriver_verbose) {
 	    printf("\nResults for libc malloc:\n");
-	    printresults(num_tracefiles, libc_stats);
+	    printresults(num_tracefiles, libc_stats, weights);
+	    if (budget > 0)
+		printconfidence(num_tracefiles, libc_stats);
+	    if (touch)
+		printtouch(num_tracefiles, libc_stats);
+	    if (simulate)
+		printsim(num_tracefiles, libc_stats);
+	}
+
+	/* Calibrate the cap, and remember it for the next run */
+	if (calibrate_libc) {
+	    thru = libc_throughput(num_tracefiles, libc_stats, weights);
+	    if (thru_metric == THRU_MODEL)
+		model_libc_thruput = thru;
+	    else
+		libc_thruput = thru;
+	    cache_libc_thruput(libc_cache_key, thru);
+	    printf("Calibrated the libc throughput cap: %.0f Kops\n", thru/1e3);
 	}
     }
 
     /*
      * Always run and evaluate the student's mm package
      */
-    if (verbose > 1)
+    if (mdriver_verbose > 1)
 	printf("\nTesting mm malloc\n");
 
     /* Allocate the mm stats array, with one stats_t struct per tracefile */
     mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
     if (mm_stats == NULL)
 	unix_error("mm_stats calloc in main failed");
-    
-    /* Initialize the simulated memory system in memlib.c */
-    mem_init(); 
+
+    /* 
+     * The timeline is a Chrome trace event file (for chrome://tracing
+     * or Perfetto) with one process per trace. The library writes the
+     * events after an element of our own.
+     */
+    if (eventfile) {
+	if ((eventfp = fopen(eventfile, "w")) == NULL)
+	    unix_error(eventfile);
+	fprintf(eventfp, "{\"traceEvents\":[\n{\"name\":\"process_name\","
+		"\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"mdriver\"}}");
+    }
 
     /* Evaluate student's mm malloc package using the K-best scheme */
     for (i=0; i < num_tracefiles; i++) {
 	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
+	mdriver_trace_info(trace, &info);
+	if (weights[i] < 0)
+	    weights[i] = info.weight;
+	eval_trace(&mm_allocator, trace, &opts, tracefiles[i], i+1, eventfp);
+	mm_stats[i] = watch->stats;
+	if (mm_stats[i].valid && thru_metric == THRU_MODEL &&
+	    mm_stats[i].insns < 0)
+	    app_error("ERROR: -I needs instruction counts, which perf_event "
+		      "does not provide here");
+	if (!mm_stats[i].valid)
+	    malloc_error(i, &mm_stats[i]);
+	else if (watch->events_failed) {
+	    errors++;
+	    printf("ERROR [trace %d]: %s\n", i, watch->events_msg);
+	}
+	mdriver_free_trace(trace);
+    }
+
+    if (eventfp) {
+	fprintf(eventfp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+	if (fclose(eventfp) == EOF)
+	    unix_error(eventfile);
+    }
+    if (profilefp) {
+	if (fclose(profilefp) == EOF)
+	    unix_error(profilefile);
+	for (i=0, samples=0; i < num_tracefiles; i++)
+	    samples += mm_stats[i].profiled +
+		(run_libc ? libc_stats[i].profiled : 0);
+	printf("Wrote %d stack samples to %s\n", samples, profilefile);
     }
 
     /* Display the mm results in a compact table */
-    if (verbose) {
+    if (mdriver_verbose) {
 	printf("\nResults for mm malloc:\n");
-	printresults(num_tracefiles, mm_stats);
+	printresults(num_tracefiles, mm_stats, weights);
+	if (budget > 0)
+	    printconfidence(num_tracefiles, mm_stats);
+	if (faults || fresh_heap)
+	    printfaults(num_tracefiles, mm_stats);
+	if (opcost)
+	    printopcosts(num_tracefiles, mm_stats);
+	if (touch)
+	    printtouch(num_tracefiles, mm_stats);
+	if (simulate)
+	    printsim(num_tracefiles, mm_stats);
+	if (thru_metric == THRU_MODEL)
+	    printmodel(num_tracefiles, mm_stats);
 	printf("\n");
     }
 
     /* 
-     * Accumulate the aggregate statistics for the student's mm package 
+     * Accumulate the aggregate statistics for the student's mm package.
+     * Each trace counts as much as its weight: utilization is the
+     * weighted average, and throughput is the weighted ops over the 
+     * weighted secs. 
      */
     secs = 0;
     ops = 0;
     util = 0;
+    weight = 0;
     numcorrect = 0;
     for (i=0; i < num_tracefiles; i++) {
-	secs += mm_stats[i].secs;
-	ops += mm_stats[i].ops;
-	util += mm_stats[i].util;
+	if (thru_metric == THRU_MODEL)
+	    secs += weights[i] * model_secs(&mm_stats[i]);
+	else
+	    secs += weights[i] * mm_stats[i].secs;
+	ops += weights[i] * mm_stats[i].ops;
+	util += weights[i] * mm_stats[i].util;
+	weight += weights[i];
 	if (mm_stats[i].valid)
 	    numcorrect++;
     }
-    avg_mm_util = util/num_tracefiles;
+    if (weight <= 0)
+	app_error("ERROR: The trace weights add up to zero");
+    avg_mm_util = util/weight;
 
     /* 
      * Compute and print the performance index 
      */
     if (errors == 0) {
 	avg_mm_throughput = ops/secs;
+	thru_cap = (thru_metric == THRU_MODEL) ? model_libc_thruput : libc_thruput;
 
-	p1 = UTIL_WEIGHT * avg_mm_util;
-	if (avg_mm_throughput > AVG_LIBC_THRUPUT) {
-	    p2 = (double)(1.0 - UTIL_WEIGHT);
+	p1 = util_weight * avg_mm_util;
+	if (avg_mm_throughput > thru_cap) {
+	    p2 = (double)(1.0 - util_weight);
 	} 
 	else {
-	    p2 = ((double) (1.0 - UTIL_WEIGHT)) * 
-		(avg_mm_throughput/AVG_LIBC_THRUPUT);
+	    p2 = ((double) (1.0 - util_weight)) * 
+		(avg_mm_throughput/thru_cap);
 	}
 	
 	perfindex = (p1 + p2)*100.0;
-	printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100\n",
+	printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100%s\n",
 	       p1*100, 
 	       p2*100, 
-	       perfindex);
-	
+	       perfindex,
+	       (profilefile && thru_metric != THRU_MODEL) ?
+	       " (profiled: the samples slow the timed runs)" : "");
+	if (thru_metric == THRU_MODEL)
+	    printf("Modeled thru = %.0f Kops (%s)\n", avg_mm_throughput/1e3,
+		   simulate ? "instructions and cache model misses" :
+		   "instructions");
+
+	/* 
+	 * The perf index is based on the measured time (or with -I, on
+	 * the cost model), never on the calibrated time. The
+	 * allocator-only throughput is reported next to it for comparing
+	 * fast allocators, where the driver's replay loop is a large
+	 * share of the measured time.
+	 */
+	if (calibrate) {
+	    ovhd = 0;
+	    for (i=0; i < num_tracefiles; i++)
+		ovhd += weights[i] * mm_stats[i].ovhd;
+	    printf("Driver overhead = %.0f%% of measured time", 
+		   (ovhd/secs)*100.0);
+	    if (secs > ovhd)
+		printf(", allocator-only thru = %.0f Kops\n", 
+		       (ops/1e3)/(secs - ovhd));
+	    else
+		printf(", allocator-only thru not measurable\n");
+	}
+
+	/* 
+	 * Page faults are part of the measured time the first time the
+	 * allocator touches a page. Report the faults of the timed runs,
+	 * and the throughput with the heap mapped beforehand and with
+	 * every page faulted in anew.
+	 */
+	if (faults || fresh_heap) {
+	    minflt = 0;
+	    majflt = 0;
+	    for (i=0; i < num_tracefiles; i++) {
+		minflt += weights[i] * mm_stats[i].pgfaults.minor;
+		majflt += weights[i] * mm_stats[i].pgfaults.major;
+	    }
+	    printf("Page faults per replay = %.0f minor, %.0f major\n",
+		   minflt/weight, majflt/weight);
+	}
+	if (fresh_heap && !faults) {
+	    discard = 0;
+	    minflt = 0;
+	    for (i=0; i < num_tracefiles; i++) {
+		discard += weights[i] * mm_stats[i].secs_discard;
+		minflt += weights[i] * mm_stats[i].pgfaults_discard.minor;
+	    }
+	    printf("Fresh-heap thru = %.0f Kops (%.0f minor faults per replay)\n",
+		   (ops/1e3)/discard, minflt/weight);
+	}
+	if (faults) {
+	    prefault = 0;
+	    discard = 0;
+	    for (i=0; i < num_tracefiles; i++) {
+		prefault += weights[i] * mm_stats[i].secs_prefault;
+		discard += weights[i] * mm_stats[i].secs_discard;
+	    }
+	    printf("Fault-free thru = %.0f Kops, fault-inclusive thru = %.0f Kops\n",
+		   (ops/1e3)/prefault, (ops/1e3)/discard);
+	}
+
+	/*
+	 * The payload-touch replay charges the allocator for the cache
+	 * misses its placement causes the application.
+	 */
+	if (touch) {
+	    cycles = 0;
+	    misses = 0;
+	    for (i=0; i < num_tracefiles; i++) {
+		cycles += weights[i] * mm_stats[i].touch_cycles;
+		if (mm_stats[i].touch_misses < 0 || misses < 0)
+		    misses = -1;
+		else
+		    misses += weights[i] * mm_stats[i].touch_misses;
+	    }
+	    printf("Payload-touch replay = %.0f cycles/op", cycles/ops);
+	    if (misses >= 0)
+		printf(", %.3f LLC misses/op\n", misses/ops);
+	    else
+		printf(", LLC misses not available\n");
+	}
+
+	/*
+	 * The cache model gives the same misses on every machine, so
+	 * they can be compared across hosts and runs.
+	 */
+	if (simulate) {
+	    cachesim_stats_t sim[CACHESIM_NSOURCES];
+	    int source;
+
+	    memset(sim, 0, sizeof(sim));
+	    for (i=0; i < num_tracefiles; i++) {
+		for (source = 0; source < CACHESIM_NSOURCES; source++) {
+		    sim[source].accesses += 
+			weights[i] * mm_stats[i].sim[source].accesses;
+		    sim[source].misses += 
+			weights[i] * mm_stats[i].sim[source].misses;
+		    sim[source].tlb_misses += 
+			weights[i] * mm_stats[i].sim[source].tlb_misses;
+		    sim[source].load_bytes += 
+			weights[i] * mm_stats[i].sim[source].load_bytes;
+		    sim[source].store_bytes += 
+			weights[i] * mm_stats[i].sim[source].store_bytes;
+		    sim[source].lines += 
+			weights[i] * mm_stats[i].sim[source].lines;
+		}
+	    }
+	    if (sim[CACHESIM_META].accesses == 0)
+		printf("Cache model: mm.c is not instrumented (build mdriver-sim)\n");
+	    else {
+		printf("Metadata traffic = %.1f bytes loaded, %.1f bytes stored, "
+		       "%.2f lines/op\n", sim[CACHESIM_META].load_bytes/ops,
+		       sim[CACHESIM_META].store_bytes/ops,
+		       sim[CACHESIM_META].lines/ops);
+		printf("Cache model: allocator %.3f misses/op, %.3f TLB misses/op\n",
+		       sim[CACHESIM_META].misses/ops,
+		       sim[CACHESIM_META].tlb_misses/ops);
+	    }
+	    if (touch)
+		printf("Cache model: payloads %.3f misses/op, %.3f TLB misses/op\n",
+		       sim[CACHESIM_PAYLOAD].misses/ops,
+		       sim[CACHESIM_PAYLOAD].tlb_misses/ops);
+	}
     }
     else { /* There were errors */
 	perfindex = 0.0;
@@ -363,548 +787,716 @@ int main(int argc, char **argv)
 }
 
 
-/*****************************************************************
- * The following routines manipulate the range list, which keeps 
- * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
- ****************************************************************/
-
 /*
- * add_range - As directed by request opnum in trace tracenum,
- *     we've just called the student's mm_malloc to allocate a block of 
- *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ * eval_trace - Evaluate alloc on trace into watch->stats, and write its
+ *     timeline (as process pid) if eventfp is set. Unless -X, the
+ *     evaluation runs in a child process with a CPU time limit and a
+ *     wall-clock limit, so an allocator that crashes or loops forever
+ *     only fails this trace.
  */
-static int add_range(range_t **ranges, char *lo, int size, 
-		     int tracenum, int opnum)
+static void eval_trace(const mdriver_allocator_t *alloc, 
+		       mdriver_trace_t *trace, mdriver_options_t *opts, 
+		       char *name, int pid, FILE *eventfp)
 {
-    char *hi = lo + size - 1;
-    range_t *p;
-    char msg[MAXLINE];
-
-    assert(size > 0);
-
-    /* Payload addresses must be ALIGNMENT-byte aligned */
-    if (!IS_ALIGNED(lo)) {
-	sprintf(msg, "Payload address (%p) not aligned to %d bytes", 
-		lo, ALIGNMENT);
-        malloc_error(tracenum, opnum, msg);
-        return 0;
+    double limit_secs = trace_cpu_limit();
+    double wall_limit = TRACE_WALL_FACTOR * limit_secs;
+    double start;
+    struct rlimit limit;
+    struct rusage usage;
+    int status, timedout = 0, delay = 1000;
+    pid_t child, rc;
+
+    if (!isolate) {
+	run_trace(alloc, trace, opts, name, pid, eventfp);
+	return;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
-	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
-		lo, hi, mem_heap_lo(), mem_heap_hi());
-	malloc_error(tracenum, opnum, msg);
-        return 0;
+    /* Don't let the child inherit buffered output */
+    fflush(stdout);
+    if (eventfp)
+	fflush(eventfp);
+    if (profilefp)
+	fflush(profilefp);
+    watch->finished = 0;
+    watch->progress.phase = MDRIVER_IDLE;
+    watch->progress.opnum = -1;
+
+    if ((child = fork()) < 0)
+	unix_error("fork in eval_trace failed");
+    if (child == 0) {
+	/* SIGXCPU at the soft limit, SIGKILL a second later */
+	limit.rlim_cur = (rlim_t)(limit_secs + 0.5);
+	limit.rlim_max = limit.rlim_cur + 1;
+	setrlimit(RLIMIT_CPU, &limit);
+	run_trace(alloc, trace, opts, name, pid, eventfp);
+	fflush(stdout);
+	if (eventfp)
+	    fflush(eventfp);
+	if (profilefp)
+	    fflush(profilefp);
+	_exit(0);
     }
 
-    /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-		    lo, hi, p->lo, p->hi);
-	    malloc_error(tracenum, opnum, msg);
-	    return 0;
-        }
+    /* Wait for the child, polling every few ms up to the wall limit */
+    start = wall_secs();
+    while ((rc = wait4(child, &status, WNOHANG, &usage)) == 0) {
+	if (wall_secs() - start > wall_limit) {
+	    kill(child, SIGKILL);
+	    rc = wait4(child, &status, 0, &usage);
+	    timedout = 1;
+	    break;
+	}
+	usleep(delay);
+	if (delay < 10000)
+	    delay *= 2;
     }
+    if (rc < 0)
+	unix_error("wait4 in eval_trace failed");
 
-    /* 
-     * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
-     */
-    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-	unix_error("malloc error in add_range");
-    p->next = *ranges;
-    p->lo = lo;
-    p->hi = hi;
-    *ranges = p;
-    return 1;
+    if (timedout || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+	!watch->finished)
+	trace_died(trace, status, timedout, &usage, limit_secs);
 }
 
-/* 
- * remove_range - Free the range record of block whose payload starts at lo 
+/*
+ * run_trace - Evaluate alloc on trace into watch->stats (from the
+ *     checkpoint of -C or -R), and write its timeline if eventfp is
+ *     set, its window report with -w, and its sampled stacks (under
+ *     the root frame "alloc;trace") if profilefp is set
  */
-static void remove_range(range_t **ranges, char *lo)
+static void run_trace(const mdriver_allocator_t *alloc, 
+		      mdriver_trace_t *trace, mdriver_options_t *opts, 
+		      char *name, int pid, FILE *eventfp)
 {
-    range_t *p;
-    range_t **prevpp = ranges;
-    int size;
+    char root[MAXLINE];
+    mdriver_checkpoint_t *ckpt = NULL;
+
+    watch->events_failed = 0;
+    if (simpoint_file && alloc->uses_memlib) {
+	run_simpoints(alloc, trace, opts);
+	watch->finished = 1;
+	return;
+    }
+    if (checkpoint_file && alloc->uses_memlib) {
+	if (checkpoint_at >= 0) {
+	    if ((ckpt = mdriver_checkpoint(alloc, trace, NULL, checkpoint_at)) &&
+		mdriver_write_checkpoint(ckpt, checkpoint_file) < 0) {
+		mdriver_free_checkpoint(ckpt);
+		ckpt = NULL;
+	    }
+	    if (ckpt)
+		printf("Wrote the checkpoint at request %lld to %s\n",
+		       checkpoint_at, checkpoint_file);
+	}
+	else
+	    ckpt = mdriver_read_checkpoint(checkpoint_file);
+	if (ckpt == NULL) {
+	    memset(&watch->stats, 0, sizeof(stats_t));
+	    watch->stats.ops = mdriver_trace_num_ops(trace);
+	    watch->stats.errop = -1;
+	    snprintf(watch->stats.errmsg, MDRIVER_MAXLINE, "%s",
+		     mdriver_error());
+	    watch->finished = 1;
+	    return;
+	}
+	if (mdriver_verbose)
+	    printf("Replaying %s from request %lld\n", name,
+		   mdriver_checkpoint_opnum(ckpt));
+	opts->checkpoint = ckpt;
+    }
 
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
+    if (mdriver_eval(alloc, trace, opts, &watch->stats) < 0) {
+	watch->stats.valid = 0;
+	watch->stats.errop = -1;
+	snprintf(watch->stats.errmsg, MDRIVER_MAXLINE, "%s", mdriver_error());
+    }
+    if (watch->stats.valid && eventfp &&
+	mdriver_write_events(alloc, trace, name, pid, eventfp) < 0) {
+	watch->events_failed = 1;
+	snprintf(watch->events_msg, MAXLINE, "%s", mdriver_error());
     }
+    if (watch->stats.valid && window > 0 &&
+	printwindows(alloc, trace, name) < 0) {
+	watch->events_failed = 1;
+	snprintf(watch->events_msg, MAXLINE, "%s", mdriver_error());
+    }
+    snprintf(root, MAXLINE, "%s;%s", alloc->name, name);
+    if (watch->stats.valid && profilefp &&
+	mdriver_write_profile(profilefp, root) < 0) {
+	watch->events_failed = 1;
+	snprintf(watch->events_msg, MAXLINE, "%s", mdriver_error());
+    }
+    opts->checkpoint = NULL;
+    mdriver_free_checkpoint(ckpt);
+    watch->finished = 1;
 }
 
 /*
- * clear_ranges - free all of the range records for a trace 
+ * run_simpoints - With -s, pick the representative windows of trace,
+ *     write their checkpoints (simpoint_file.0, .1, ...), evaluate the
+ *     whole trace into watch->stats as usual, estimate it from the
+ *     windows, and write an index of them (simpoint_file) with the
+ *     bias of the estimate. With -e, estimate from the windows of the
+ *     index instead, and report the estimate in watch->stats (with the
+ *     utilization of -s), with the bias of -s and the spread of the
+ *     timed runs as its error bound.
  */
-static void clear_ranges(range_t **ranges)
+static void run_simpoints(const mdriver_allocator_t *alloc,
+			  mdriver_trace_t *trace, mdriver_options_t *opts)
 {
-    range_t *p;
-    range_t *pnext;
+    stats_t *stats = &watch->stats;
+    mdriver_simpoint_t *points = NULL;
+    mdriver_checkpoint_t *ckpt = NULL, *prev = NULL;
+    char path[MAXLINE];
+    double secs, spread, ops = mdriver_trace_num_ops(trace), util = 0;
+    double bias = 0, replayed = 0;
+    long long warmup;
+    int i, n = 0, window = simpoint_window;
+
+    memset(stats, 0, sizeof(stats_t));
+    stats->ops = ops;
+    stats->errop = -1;
+    strcpy(msg, "out of memory");
+
+    if (simpoint_k > 0) {
+	points = malloc(simpoint_k * MDRIVER_SIMPOINT_REPS *
+			sizeof(mdriver_simpoint_t));
+	if (points == NULL ||
+	    (n = mdriver_simpoints(trace, window, simpoint_k, points)) < 0)
+	    goto fail;
+
+	/* One checkpoint SIMPOINT_WARMUP requests ahead of each, taken
+	   from the last */
+	warmup = SIMPOINT_WARMUP > window ? SIMPOINT_WARMUP : window;
+	for (i = 0; i < n; i++) {
+	    snprintf(path, MAXLINE, "%s.%d", simpoint_file, i);
+	    ckpt = mdriver_checkpoint(alloc, trace, prev,
+				      points[i].first > warmup ?
+				      points[i].first - warmup : 0);
+	    mdriver_free_checkpoint(prev);
+	    prev = ckpt;
+	    if (!ckpt || mdriver_write_checkpoint(ckpt, path) < 0) {
+		snprintf(msg, MAXLINE, "%s", mdriver_error());
+		goto fail;
+	    }
+	}
+	mdriver_free_checkpoint(prev);
+	prev = NULL;
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+	/* The whole trace, to measure the bias of the estimate against */
+	if (mdriver_eval(alloc, trace, opts, stats) < 0) {
+	    snprintf(msg, MAXLINE, "%s", mdriver_error());
+	    goto fail;
+	}
+	if (!stats->valid)
+	    goto done;
     }
-    *ranges = NULL;
+    else if ((n = read_simpoints(simpoint_file, &points, &window, &util,
+				 &bias)) < 0)
+	goto fail;
+
+    if ((secs = estimate_secs(alloc, trace, points, n, &spread)) < 0)
+	goto fail;
+    for (i = 0; i < n; i++)
+	replayed += points[i].ops / ops;
+    if (simpoint_k > 0) {
+	bias = stats->secs/secs - 1;
+	printf("Estimated %.0f Kops from %d windows of %d requests; the "
+	       "whole trace: %.0f Kops (estimate off by %+.1f%%, runs "
+	       "spread %.1f%%)\n", (ops/1e3)/secs, n, window,
+	       (ops/1e3)/stats->secs, 100*bias, 100*spread);
+	if (write_simpoints(simpoint_file, points, n, window, stats->util,
+			    bias) < 0)
+	    goto fail;
+    }
+    else {
+	printf("Estimated %.0f Kops (+-%.1f%%: off by %+.1f%% when -s "
+	       "measured it, runs spread %.1f%%) from %d windows of %d "
+	       "requests\n", (ops/1e3)/secs, 100*(fabs(bias) + spread),
+	       100*bias, 100*spread, n, window);
+	stats->valid = 1;
+	stats->secs = secs;
+	stats->util = util;
+	stats->replayed = replayed;
+	stats->samples = MDRIVER_SIMPOINT_RUNS;
+	stats->spread = fabs(bias) + spread;
+    }
+    goto done;
+
+ fail:
+    memset(stats, 0, sizeof(stats_t));
+    stats->ops = ops;
+    stats->errop = -1;
+    snprintf(stats->errmsg, MDRIVER_MAXLINE, "%s", msg);
+ done:
+    mdriver_free_checkpoint(prev);
+    free(points);
 }
 
-
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
 /*
- * read_trace - read a trace file and store it in memory
+ * estimate_secs - Time the representative windows of a trace, and
+ *     estimate the secs of the whole trace: the requests of each
+ *     cluster take as long as those of its windows did on average.
+ *     The checkpoints are read back one at a time, and each window is
+ *     timed within replays that warm up from its checkpoint (see
+ *     mdriver_time_simpoint). The estimate is from the fastest run of
+ *     each window; *spread gets how much slower the estimate of the
+ *     median run is, relative to it. Returns -1 (and a message in msg)
+ *     if a window fails.
  */
-static trace_t *read_trace(char *tracedir, char *filename)
+static double estimate_secs(const mdriver_allocator_t *alloc,
+			    mdriver_trace_t *trace,
+			    mdriver_simpoint_t *points, int n,
+			    double *spread)
 {
-    FILE *tracefile;
-    trace_t *trace;
-    char type[MAXLINE];
+    mdriver_checkpoint_t *ckpt;
     char path[MAXLINE];
-    unsigned index, size;
-    unsigned max_index = 0;
-    unsigned op_index;
-
-    if (verbose > 1)
-	printf("Reading tracefile: %s\n", filename);
+    double (*secs)[MDRIVER_SIMPOINT_RUNS+1]; /* of each run, then fastest */
+    double est[MDRIVER_SIMPOINT_RUNS+1], mean, median, lo;
+    int i, j, m, r;
+
+    if ((secs = malloc((n + 1) * sizeof(*secs))) == NULL)
+	unix_error("malloc in estimate_secs failed");
+    for (i = 0; i < n; i++) {
+	snprintf(path, MAXLINE, "%s.%d", simpoint_file, i);
+	if ((ckpt = mdriver_read_checkpoint(path)) == NULL ||
+	    mdriver_time_simpoint(alloc, trace, ckpt, &points[i],
+				  secs[i]) < 0) {
+	    snprintf(msg, MAXLINE, "window at request %lld: %.900s",
+		     points[i].first, mdriver_error());
+	    mdriver_free_checkpoint(ckpt);
+	    free(secs);
+	    return -1;
+	}
+	mdriver_free_checkpoint(ckpt);
 
-    /* Allocate the trace record */
-    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
-	unix_error("malloc 1 failed in read_trance");
-	
-    /* Read the trace file header */
-    strcpy(path, tracedir);
-    strcat(path, filename);
-    if ((tracefile = fopen(path, "r")) == NULL) {
-	sprintf(msg, "Could not open %s in read_trace", path);
-	unix_error(msg);
+	/* The fastest run of the window goes last */
+	for (lo = secs[i][0], r = 1; r < MDRIVER_SIMPOINT_RUNS; r++)
+	    if (secs[i][r] < lo)
+		lo = secs[i][r];
+	secs[i][MDRIVER_SIMPOINT_RUNS] = lo;
     }
-    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-    fscanf(tracefile, "%d", &(trace->num_ids));     
-    fscanf(tracefile, "%d", &(trace->num_ops));     
-    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-    
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks = 
-	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-	unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes = 
-	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-	unix_error("malloc 4 failed in read_trace");
-    
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-	switch(type[0]) {
-	case 'a':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = ALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'r':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = REALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'f':
-	    fscanf(tracefile, "%ud", &index);
-	    trace->ops[op_index].type = FREE;
-	    trace->ops[op_index].index = index;
-	    break;
-	default:
-	    printf("Bogus type character (%c) in tracefile %s\n", 
-		   type[0], path);
-	    exit(1);
+
+    /* The estimate of each run, and of the fastest runs */
+    for (r = 0; r <= MDRIVER_SIMPOINT_RUNS; r++) {
+	est[r] = 0;
+	for (i = 0; i < n; i++) {
+	    for (j = 0; j < i && points[j].cluster != points[i].cluster; j++)
+		;
+	    if (j < i)
+		continue;
+	    for (mean = 0, m = 0, j = i; j < n; j++)
+		if (points[j].cluster == points[i].cluster) {
+		    mean += secs[j][r] / points[j].ops;
+		    m++;
+		}
+	    est[r] += points[i].cluster_ops * mean / m;
 	}
-	op_index++;
-	
     }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-    
-    return trace;
+    free(secs);
+
+    if (est[MDRIVER_SIMPOINT_RUNS] <= 0) {
+	snprintf(msg, MAXLINE, "the windows are too short to time; pick "
+		 "longer ones with -s");
+	return -1;
+    }
+    qsort(est, MDRIVER_SIMPOINT_RUNS, sizeof(double), cmp_doubles);
+    median = est[MDRIVER_SIMPOINT_RUNS / 2];
+    *spread = (median - est[MDRIVER_SIMPOINT_RUNS]) / median;
+    return est[MDRIVER_SIMPOINT_RUNS];
 }
 
 /*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
+ * write_simpoints - Write the index of the representative windows of
+ *     -s: the window size, the utilization of the whole trace, the
+ *     bias of the estimate, and one line per window. Returns -1 (and a
+ *     message in msg) on failure.
  */
-void free_trace(trace_t *trace)
+static int write_simpoints(char *path, mdriver_simpoint_t *points, int n,
+			   int window, double util, double bias)
 {
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);      
-    free(trace->block_sizes);
-    free(trace);              /* and the trace record itself... */
-}
+    FILE *fp;
+    int i;
 
-/**********************************************************************
- * The following functions evaluate the correctness, space utilization,
- * and throughput of the libc and mm malloc packages.
- **********************************************************************/
+    if ((fp = fopen(path, "w")) == NULL) {
+	snprintf(msg, MAXLINE, "can't open %s: %s", path, strerror(errno));
+	return -1;
+    }
+    fprintf(fp, "mdriver simpoints 2\nwindow %d util %.17g bias %.17g\n",
+	    window, util, bias);
+    fprintf(fp, "# first ops cluster windows cluster_ops\n");
+    for (i = 0; i < n; i++)
+	fprintf(fp, "%lld %lld %d %d %.0f\n", points[i].first, points[i].ops,
+		points[i].cluster, points[i].windows, points[i].cluster_ops);
+    if (fclose(fp) == EOF) {
+	snprintf(msg, MAXLINE, "can't write %s: %s", path, strerror(errno));
+	return -1;
+    }
+    return 0;
+}
 
 /*
- * eval_mm_valid - Check the mm malloc package for correctness
+ * read_simpoints - Read the index written by write_simpoints into a
+ *     new array of points. Returns the number of points, or -1 (and a
+ *     message in msg) on failure.
  */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) 
+static int read_simpoints(char *path, mdriver_simpoint_t **points,
+			  int *window, double *util, double *bias)
 {
-    int i, j;
-    int index;
-    int size;
-    int oldsize;
-    char *newp;
-    char *oldp;
-    char *p;
-    
-    /* Reset the heap and free any records in the range list */
-    mem_reset_brk();
-    clear_ranges(ranges);
-
-    /* Call the mm package's init function */
-    if (mm_init() < 0) {
-	malloc_error(tracenum, 0, "mm_init failed.");
-	return 0;
+    char line[MAXLINE];
+    mdriver_simpoint_t p;
+    FILE *fp;
+    int n = 0;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+	snprintf(msg, MAXLINE, "can't open %s: %s", path, strerror(errno));
+	return -1;
     }
+    if (!fgets(line, MAXLINE, fp) || strcmp(line, "mdriver simpoints 2\n") ||
+	!fgets(line, MAXLINE, fp) ||
+	sscanf(line, "window %d util %lf bias %lf", window, util, bias) != 3 ||
+	*window < 1) {
+	fclose(fp);
+	snprintf(msg, MAXLINE, "%s is not an index of -s", path);
+	return -1;
+    }
+    *points = NULL;
+    while (fgets(line, MAXLINE, fp)) {
+	if (line[0] == '#')
+	    continue;
+	if (sscanf(line, "%lld %lld %d %d %lf", &p.first, &p.ops, &p.cluster,
+		   &p.windows, &p.cluster_ops) != 5 || p.first < 0 ||
+	    p.ops < 1) {
+	    fclose(fp);
+	    snprintf(msg, MAXLINE, "%s: bad line: %.900s", path, line);
+	    return -1;
+	}
+	*points = realloc(*points, (n + 1) * sizeof(mdriver_simpoint_t));
+	if (*points == NULL)
+	    unix_error("realloc in read_simpoints failed");
+	(*points)[n++] = p;
+    }
+    fclose(fp);
+    return n;
+}
 
-    /* Interpret each operation in the trace in order */
-    for (i = 0;  i < trace->num_ops;  i++) {
-	index = trace->ops[i].index;
-	size = trace->ops[i].size;
-
-        switch (trace->ops[i].type) {
-
-        case ALLOC: /* mm_malloc */
+/*
+ * trace_cpu_limit - The CPU time limit of the child that evaluates a
+ *     trace: -W, or with -s, -W for picking the windows and writing
+ *     their checkpoints, -W for the whole trace, and -W for each window
+ *     it may pick, and with -e, -W for each window of the index. Each
+ *     window is timed in MDRIVER_SIMPOINT_RUNS replays that restore its
+ *     checkpoint, which take long for a big heap.
+ */
+static double trace_cpu_limit(void)
+{
+    mdriver_simpoint_t *points;
+    double util, bias;
+    int n, window;
+
+    if (simpoint_k > 0)
+	return (2 + simpoint_k * MDRIVER_SIMPOINT_REPS) * cpu_limit;
+    if (simpoint_file &&
+	(n = read_simpoints(simpoint_file, &points, &window, &util,
+			    &bias)) > 0) {
+	free(points);
+	return n * cpu_limit;
+    }
+    return cpu_limit;
+}
 
-	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
-		malloc_error(tracenum, i, "mm_malloc failed.");
-		return 0;
-	    }
-	    
-	    /* 
-	     * Test the range of the new block for correctness and add it 
-	     * to the range list if OK. The block must be  be aligned properly,
-	     * and must not overlap any currently allocated block. 
-	     */ 
-	    if (add_range(ranges, p, size, tracenum, i) == 0)
-		return 0;
-	    
-	    /* ADDED: cgw
-	     * fill range with low byte of index.  This will be used later
-	     * if we realloc the block and wish to make sure that the old
-	     * data was copied to the new block
-	     */
-	    memset(p, index & 0xFF, size);
-
-	    /* Remember region */
-	    trace->blocks[index] = p;
-	    trace->block_sizes[index] = size;
-	    break;
+/*
+ * trace_died - Record in watch->stats how and where the child that
+ *     evaluated trace died: killed by a signal (SIGXCPU, or SIGKILL
+ *     after the CPU time in usage reached limit, means the CPU time
+ *     limit), killed by the driver after the wall-clock limit, or
+ *     exited without finishing.
+ */
+static void trace_died(mdriver_trace_t *trace, int status, int timedout,
+		       struct rusage *usage, double limit)
+{
+    stats_t *stats = &watch->stats;
+    int phase = watch->progress.phase;
+    double cpu;
+    int sig;
+
+    if (phase < MDRIVER_IDLE || phase > MDRIVER_INSTRUMENT)
+	phase = MDRIVER_IDLE;
+    memset(stats, 0, sizeof(stats_t));
+    stats->ops = mdriver_trace_num_ops(trace);
+    stats->valid = 0;
+    stats->errop = watch->progress.opnum;
+
+    if (timedout)
+	snprintf(stats->errmsg, MAXLINE, 
+		 "Timed out after %.0f secs (wall clock)%s",
+		 TRACE_WALL_FACTOR * limit, phasenames[phase]);
+    else if (WIFSIGNALED(status)) {
+	sig = WTERMSIG(status);
+	cpu = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec/1e6 +
+	    usage->ru_stime.tv_sec + usage->ru_stime.tv_usec/1e6;
+	if (sig == SIGXCPU || (sig == SIGKILL && cpu >= limit))
+	    snprintf(stats->errmsg, MAXLINE, 
+		     "Exceeded the CPU time limit of %.0f secs%s",
+		     limit, phasenames[phase]);
+	else
+	    snprintf(stats->errmsg, MAXLINE, "Killed by signal %d (%s)%s",
+		     sig, strsignal(sig), phasenames[phase]);
+    }
+    else
+	snprintf(stats->errmsg, MAXLINE, "Exited with status %d%s",
+		 WEXITSTATUS(status), phasenames[phase]);
+}
 
-        case REALLOC: /* mm_realloc */
-	    
-	    /* Call the student's realloc */
-	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp, size)) == NULL) {
-		malloc_error(tracenum, i, "mm_realloc failed.");
-		return 0;
-	    }
-	    
-	    /* Remove the old region from the range list */
-	    remove_range(ranges, oldp);
-	    
-	    /* Check new block for correctness and add it to range list */
-	    if (add_range(ranges, newp, size, tracenum, i) == 0)
-		return 0;
-	    
-	    /* ADDED: cgw
-	     * Make sure that the new block contains the data from the old 
-	     * block and then fill in the new block with the low order byte
-	     * of the new index
-	     */
-	    oldsize = trace->block_sizes[index];
-	    if (size < oldsize) oldsize = size;
-	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
-		malloc_error(tracenum, i, "mm_realloc did not preserve the "
-			     "data from old block");
-		return 0;
-	      }
-	    }
-	    memset(newp, index & 0xFF, size);
+/*
+ * wall_secs - The time of day in seconds
+ */
+static double wall_secs(void)
+{
+    struct timeval tv;
 
-	    /* Remember region */
-	    trace->blocks[index] = newp;
-	    trace->block_sizes[index] = size;
-	    break;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1e6;
+}
 
-        case FREE: /* mm_free */
-	    
-	    /* Remove region from list and call student's free function */
-	    p = trace->blocks[index];
-	    remove_range(ranges, p);
-	    mm_free(p);
-	    break;
+/*
+ * read_trace - read a trace file in tracedir and store it in memory.
+ *     With -K, replace it by that many interleaved copies.
+ */
+static mdriver_trace_t *read_trace(char *tracedir, char *filename)
+{
+    mdriver_trace_t *trace, *scaled;
+    char path[MAXLINE];
 
-	default:
-	    app_error("Nonexistent request type in eval_mm_valid");
-        }
+    if (mdriver_verbose > 1)
+	printf("Reading tracefile: %s\n", filename);
 
+    strcpy(path, tracedir);
+    strcat(path, filename);
+    if ((trace = mdriver_read_trace(path)) == NULL)
+	app_error((char *)mdriver_error());
+    if (copies > 1) {
+	if ((scaled = mdriver_scale_trace(trace, copies, interleave, 1)) == NULL)
+	    app_error((char *)mdriver_error());
+	mdriver_free_trace(trace);
+	trace = scaled;
     }
-
-    /* As far as we know, this is a valid malloc package */
-    return 1;
+    return trace;
 }
 
-/* 
- * eval_mm_util - Evaluate the space utilization of the student's package
- *   The idea is to remember the high water mark "hwm" of the heap for 
- *   an optimal allocator, i.e., no gaps and no internal fragmentation.
- *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
- *   
- */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
-{   
+/*
+ * libc_key - The key of a libc calibration in the cache: the CPU
+ *     model (from /proc/cpuinfo), the throughput metric (the cost
+ *     model counts cache misses only with -S), and a hash of
+ *     what the traces make libc do (their contents, weights, and the
+ *     scaling of -K). Any change to the traces makes a new key.
+ */
+static void libc_key(char *key, char **tracefiles, double *weights, int n)
+{
+    unsigned long long hash = 14695981039346656037ULL; /* FNV-1a */
+    char buf[MAXLINE], model[MAXLINE], *p;
+    size_t len, j;
+    FILE *fp;
     int i;
-    int index;
-    int size, newsize, oldsize;
-    int max_total_size = 0;
-    int total_size = 0;
-    char *p;
-    char *newp, *oldp;
-
-    /* initialize the heap and the mm malloc package */
-    mem_reset_brk();
-    if (mm_init() < 0)
-	app_error("mm_init failed in eval_mm_util");
-
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
-
-        case ALLOC: /* mm_alloc */
-	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
-
-	    if ((p = mm_malloc(size)) == NULL) 
-		app_error("mm_malloc failed in eval_mm_util");
-	    
-	    /* Remember region and size */
-	    trace->blocks[index] = p;
-	    trace->block_sizes[index] = size;
-	    
-	    /* Keep track of current total size
-	     * of all allocated blocks */
-	    total_size += size;
-	    
-	    /* Update statistics */
-	    max_total_size = (total_size > max_total_size) ?
-		total_size : max_total_size;
-	    break;
-
-	case REALLOC: /* mm_realloc */
-	    index = trace->ops[i].index;
-	    newsize = trace->ops[i].size;
-	    oldsize = trace->block_sizes[index];
-
-	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
-		app_error("mm_realloc failed in eval_mm_util");
-
-	    /* Remember region and size */
-	    trace->blocks[index] = newp;
-	    trace->block_sizes[index] = newsize;
-	    
-	    /* Keep track of current total size
-	     * of all allocated blocks */
-	    total_size += (newsize - oldsize);
-	    
-	    /* Update statistics */
-	    max_total_size = (total_size > max_total_size) ?
-		total_size : max_total_size;
-	    break;
-
-        case FREE: /* mm_free */
-	    index = trace->ops[i].index;
-	    size = trace->block_sizes[index];
-	    p = trace->blocks[index];
-	    
-	    mm_free(p);
-	    
-	    /* Keep track of current total size
-	     * of all allocated blocks */
-	    total_size -= size;
-	    
-	    break;
-
-	default:
-	    app_error("Nonexistent request type in eval_mm_util");
 
-        }
+    /* What every trace asks of the allocator, and how much it counts */
+    for (i = 0; i < n; i++) {
+	strcpy(buf, tracedir);
+	strcat(buf, tracefiles[i]);
+	if ((fp = fopen(buf, "rb")) == NULL)
+	    unix_error(buf);
+	while ((len = fread(buf, 1, MAXLINE, fp)) > 0)
+	    for (j = 0; j < len; j++)
+		hash = (hash ^ (unsigned char)buf[j]) * 1099511628211ULL;
+	fclose(fp);
+	sprintf(buf, "%g/%d/%d;", weights[i], copies, interleave);
+	for (p = buf; *p; p++)
+	    hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    strcpy(model, "unknown");
+    if ((fp = fopen("/proc/cpuinfo", "r")) != NULL) {
+	while (fgets(buf, MAXLINE, fp))
+	    if (!strncmp(buf, "model name", 10) && (p = strchr(buf, ':'))) {
+		for (p++; *p == ' ' || *p == '\t'; p++)
+		    ;
+		p[strcspn(p, "\n")] = '\0';
+		strncpy(model, p, MAXLINE-1);
+		model[MAXLINE-1] = '\0';
+		break;
+	    }
+	fclose(fp);
+    }
+    snprintf(key, MAXLINE, "%016llx %s %.900s", hash,
+	     thru_metric == THRU_TIME ? "time" :
+	     simulate ? "model+sim" : "model", model);
 }
 
-
 /*
- * eval_mm_speed - This is the function that is used by fcyc()
- *    to measure the running time of the mm malloc package.
+ * cached_libc_thruput - The libc throughput (ops/sec) cached under key,
+ *     or 0 if there is none. Each line of the cache is a throughput
+ *     followed by its key.
  */
-static void eval_mm_speed(void *ptr)
+static double cached_libc_thruput(char *key)
 {
-    int i, index, size, newsize;
-    char *p, *newp, *oldp, *block;
-    trace_t *trace = ((speed_t *)ptr)->trace;
+    char line[2*MAXLINE], *p;
+    double thruput = 0;
+    FILE *fp;
 
-    /* Reset the heap and initialize the mm package */
-    mem_reset_brk();
-    if (mm_init() < 0) 
-	app_error("mm_init failed in eval_mm_speed");
-
-    /* Interpret each trace request */
-    for (i = 0;  i < trace->num_ops;  i++)
-        switch (trace->ops[i].type) {
+    if ((fp = fopen(LIBC_CACHE, "r")) == NULL)
+	return 0;
+    while (fgets(line, sizeof(line), fp)) {
+	line[strcspn(line, "\n")] = '\0';
+	if ((p = strchr(line, ' ')) != NULL && !strcmp(p+1, key))
+	    thruput = atof(line);
+    }
+    fclose(fp);
+    return thruput;
+}
 
-        case ALLOC: /* mm_malloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
-		app_error("mm_malloc error in eval_mm_speed");
-            trace->blocks[index] = p;
-            break;
+/*
+ * cache_libc_thruput - Cache the libc throughput under key, replacing
+ *     any older calibration under the same key. A cache that can't be
+ *     written only costs a calibration next time.
+ */
+static void cache_libc_thruput(char *key, double thruput)
+{
+    char line[2*MAXLINE], tmp[MAXLINE], *p;
+    FILE *in, *out;
 
-	case REALLOC: /* mm_realloc */
-	    index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
-	    oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL)
-		app_error("mm_realloc error in eval_mm_speed");
-            trace->blocks[index] = newp;
-            break;
+    sprintf(tmp, "%s.tmp", LIBC_CACHE);
+    if ((out = fopen(tmp, "w")) == NULL) {
+	printf("Warning: can't write %s: %s\n", tmp, strerror(errno));
+	return;
+    }
+    if ((in = fopen(LIBC_CACHE, "r")) != NULL) {
+	while (fgets(line, sizeof(line), in)) {
+	    line[strcspn(line, "\n")] = '\0';
+	    if ((p = strchr(line, ' ')) != NULL && strcmp(p+1, key))
+		fprintf(out, "%s\n", line);
+	}
+	fclose(in);
+    }
+    fprintf(out, "%.0f %s\n", thruput, key);
+    if (fclose(out) == EOF || rename(tmp, LIBC_CACHE) < 0)
+	printf("Warning: can't write %s: %s\n", LIBC_CACHE, strerror(errno));
+}
 
-        case FREE: /* mm_free */
-            index = trace->ops[i].index;
-            block = trace->blocks[index];
-            mm_free(block);
-            break;
+/*
+ * libc_throughput - The weighted throughput of libc on the traces, in
+ *     the metric of the perf index
+ */
+static double libc_throughput(int n, stats_t *stats, double *weights)
+{
+    double ops = 0, secs = 0;
+    int i;
 
-	default:
-	    app_error("Nonexistent request type in eval_mm_valid");
-        }
+    for (i = 0; i < n; i++) {
+	ops += weights[i] * stats[i].ops;
+	if (thru_metric == THRU_MODEL) {
+	    if (stats[i].insns < 0)
+		app_error("ERROR: -I needs instruction counts, which perf_event "
+			  "does not provide here");
+	    secs += weights[i] * model_secs(&stats[i]);
+	}
+	else
+	    secs += weights[i] * stats[i].secs;
+    }
+    if (secs <= 0)
+	app_error("ERROR: libc took no time on the traces");
+    return ops/secs;
 }
 
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
+ * read_profile - Read a workload-mix profile. Each line of a profile
+ *     is blank, a "#" comment, or one of these directives:
+ *
+ *         trace <file> [<weight>]   evaluate <file> (relative to the
+ *                                   trace directory) with this weight,
+ *                                   by default the one in its header
+ *         tracedir <dir>            where the traces are located
+ *         util_weight <w>           replaces UTIL_WEIGHT
+ *         libc_thruput <ops/sec>    replaces AVG_LIBC_THRUPUT
  *
+ *     Returns the number of traces and sets *tracefiles to a
+ *     null-terminated array of their names and *weights to their
+ *     weights (<0 for the weight in the trace header).
  */
-static int eval_libc_valid(trace_t *trace, int tracenum)
+static int read_profile(char *path, char ***tracefiles, double **weights)
 {
-    int i, newsize;
-    char *p, *newp, *oldp;
+    FILE *fp;
+    char line[MAXLINE], key[MAXLINE], arg[MAXLINE];
+    double value;
+    int n = 0, linenum = 0, fields;
 
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
-
-        case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
-		malloc_error(tracenum, i, "libc malloc failed");
-		unix_error("System message");
-	    }
-	    trace->blocks[trace->ops[i].index] = p;
-	    break;
-
-	case REALLOC: /* realloc */
-            newsize = trace->ops[i].size;
-	    oldp = trace->blocks[trace->ops[i].index];
-	    if ((newp = realloc(oldp, newsize)) == NULL) {
-		malloc_error(tracenum, i, "libc realloc failed");
-		unix_error("System message");
+    if ((fp = fopen(path, "r")) == NULL) {
+	sprintf(msg, "Could not open profile %s", path);
+	unix_error(msg);
+    }
+    *tracefiles = (char **)malloc((MAXMIX+1) * sizeof(char *));
+    *weights = (double *)malloc(MAXMIX * sizeof(double));
+    if (*tracefiles == NULL || *weights == NULL)
+	unix_error("malloc failed in read_profile");
+
+    while (fgets(line, MAXLINE, fp) != NULL) {
+	linenum++;
+	fields = sscanf(line, "%s %s %lf", key, arg, &value);
+	if (fields < 1 || key[0] == '#')
+	    continue;
+	if (!strcmp(key, "trace") && fields >= 2) {
+	    if (n == MAXMIX)
+		app_error("ERROR: Too many traces in profile");
+	    (*tracefiles)[n] = strdup(arg);
+	    (*weights)[n] = (fields == 3) ? value : -1;
+	    if ((*weights)[n] < 0 && fields == 3) {
+		sprintf(msg, "ERROR [%s, line %d]: negative weight", 
+			path, linenum);
+		app_error(msg);
 	    }
-	    trace->blocks[trace->ops[i].index] = newp;
-	    break;
-	    
-        case FREE: /* free */
-	    free(trace->blocks[trace->ops[i].index]);
-	    break;
-
-	default:
-	    app_error("invalid operation type  in eval_libc_valid");
+	    n++;
+	}
+	else if (!strcmp(key, "tracedir") && fields >= 2) {
+	    strcpy(tracedir, arg);
+	    if (tracedir[strlen(tracedir)-1] != '/') 
+		strcat(tracedir, "/"); /* path always ends with "/" */
+	}
+	else if (!strcmp(key, "util_weight") && fields >= 2)
+	    util_weight = atof(arg);
+	else if (!strcmp(key, "libc_thruput") && fields >= 2)
+	    libc_thruput = atof(arg);
+	else {
+	    sprintf(msg, "ERROR [%s, line %d]: bad directive \"%.64s\"", 
+		    path, linenum, key);
+	    app_error(msg);
 	}
     }
+    fclose(fp);
 
-    return 1;
+    if (n == 0) {
+	sprintf(msg, "ERROR: No traces in profile %s", path);
+	app_error(msg);
+    }
+    if (util_weight < 0 || util_weight > 1 || libc_thruput <= 0) {
+	sprintf(msg, "ERROR: Bad perf index weighting in profile %s", path);
+	app_error(msg);
+    }
+    (*tracefiles)[n] = NULL;
+    return n;
 }
 
-/* 
- * eval_libc_speed - This is the function that is used by fcyc() to
- *    measure the running time of the libc malloc package on the set
- *    of traces.
+/*
+ * free_tracefiles - Free the trace file names and weights of an
+ *     earlier -f or -m option that a later one replaces
  */
-static void eval_libc_speed(void *ptr)
+static void free_tracefiles(char **tracefiles, double *weights)
 {
     int i;
-    int index, size, newsize;
-    char *p, *newp, *oldp, *block;
-    trace_t *trace = ((speed_t *)ptr)->trace;
-
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
-        case ALLOC: /* malloc */
-	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
-	    if ((p = malloc(size)) == NULL)
-		unix_error("malloc failed in eval_libc_speed");
-	    trace->blocks[index] = p;
-	    break;
 
-	case REALLOC: /* realloc */
-	    index = trace->ops[i].index;
-	    newsize = trace->ops[i].size;
-	    oldp = trace->blocks[index];
-	    if ((newp = realloc(oldp, newsize)) == NULL)
-		unix_error("realloc failed in eval_libc_speed\n");
-	    
-	    trace->blocks[index] = newp;
-	    break;
-	    
-        case FREE: /* free */
-	    index = trace->ops[i].index;
-	    block = trace->blocks[index];
-	    free(block);
-	    break;
-	}
-    }
+    if (tracefiles != NULL)
+	for (i = 0; tracefiles[i] != NULL; i++)
+	    free(tracefiles[i]);
+    free(tracefiles);
+    free(weights);
 }
 
 /*************************************
@@ -915,58 +1507,408 @@ static void eval_libc_speed(void *ptr)
 /*
  * printresults - prints a performance summary for some malloc package
  */
-static void printresults(int n, stats_t *stats) 
+static void printresults(int n, stats_t *stats, double *weights) 
 {
     int i;
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double ovhd = 0;
+    double weight = 0;
+    mdriver_opcost_t opcosts[MDRIVER_NOPTYPES];
+    int j;
+
+    memset(opcosts, 0, sizeof(opcosts));
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
+    printf("%5s%7s %5s%8s%10s%6s", 
 	   "trace", " valid", "util", "ops", "secs", "Kops");
+    if (mix)
+	printf("%8s", "weight");
+    if (calibrate)
+	printf("%10s%8s", "ovhd", "adjKops");
+    if (opcost)
+	for (j = 0; j < MDRIVER_NOPTYPES; j++)
+	    printf("%7s", opnames[j]);
+    printf("\n");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
 		   (stats[i].ops/1e3)/stats[i].secs);
-	    secs += stats[i].secs;
-	    ops += stats[i].ops;
-	    util += stats[i].util;
+	    if (mix)
+		printf("%8.2f", weights[i]);
+	    if (calibrate)
+		printovhd(stats[i].ops, stats[i].secs, stats[i].ovhd);
+	    if (opcost)
+		printopshares(stats[i].opcost);
+	    printf("\n");
+	    secs += weights[i] * stats[i].secs;
+	    ops += weights[i] * stats[i].ops;
+	    util += weights[i] * stats[i].util;
+	    ovhd += weights[i] * stats[i].ovhd;
+	    weight += weights[i];
+	    for (j = 0; j < MDRIVER_NOPTYPES; j++)
+		opcosts[j].cycles += weights[i] * stats[i].opcost[j].cycles;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s%6s\n", 
+	    printf("%2d%10s%6s%8s%10s%6s", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
 		   "-");
+	    if (mix)
+		printf("%8.2f", weights[i]);
+	    if (calibrate)
+		printf("%10s%8s", "-", "-");
+	    if (opcost)
+		for (j = 0; j < MDRIVER_NOPTYPES; j++)
+		    printf("%7s", "-");
+	    printf("\n");
 	}
     }
 
-    /* Print the aggregate results for the set of traces */
-    if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+    /* 
+     * Print the aggregate results for the set of traces. With a 
+     * workload mix, these are the weighted totals.
+     */
+    if (errors == 0 && weight > 0) {
+	printf("%12s%5.0f%%%8.0f%10.6f%6.0f", 
 	       "Total       ",
-	       (util/n)*100.0,
+	       (util/weight)*100.0,
 	       ops, 
 	       secs,
 	       (ops/1e3)/secs);
+	if (mix)
+	    printf("%8.2f", weight);
+	if (calibrate)
+	    printovhd(ops, secs, ovhd);
+	if (opcost)
+	    printopshares(opcosts);
+	printf("\n");
     }
     else {
-	printf("%12s%6s%8s%10s%6s\n", 
+	printf("%12s%6s%8s%10s%6s", 
 	       "Total       ",
 	       "-", 
 	       "-", 
 	       "-", 
 	       "-");
+	if (mix)
+	    printf("%8s", "-");
+	if (calibrate)
+	    printf("%10s%8s", "-", "-");
+	if (opcost)
+	    for (j = 0; j < MDRIVER_NOPTYPES; j++)
+		printf("%7s", "-");
+	printf("\n");
+    }
+
+}
+
+/*
+ * printconfidence - prints how each trace was timed within the time
+ *     budget: the share of the trace replayed by each sample, the
+ *     number of samples, and the relative spread of the best samples
+ */
+static void printconfidence(int n, stats_t *stats) 
+{
+    int i;
+
+    printf("%5s%9s%8s%8s\n", "trace", "replayed", "samples", "spread");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid)
+	    printf("%2d%12s%8s%8s\n", i, "-", "-", "-");
+	else if (stats[i].spread < 0)
+	    printf("%2d%11.0f%%%8d%8s\n", i, stats[i].replayed*100.0,
+		   stats[i].samples, "-");
+	else
+	    printf("%2d%11.0f%%%8d%7.1f%%\n", i, stats[i].replayed*100.0,
+		   stats[i].samples, stats[i].spread*100.0);
+    }
+}
+
+/*
+ * printfaults - prints the high-water mark of the heap of each trace
+ *     and the minor and major page faults per timed replay. With -F,
+ *     also prints the throughput (and minor faults) with the heap's
+ *     pages mapped before each run (fault-free), and with -F or -D,
+ *     with them discarded before each run (fault-inclusive).
+ */
+static void printfaults(int n, stats_t *stats) 
+{
+    int i;
+
+    printf("%5s%9s%8s%8s", "trace", "heap KB", "minflt", "majflt");
+    if (faults)
+	printf("%10s%8s", "prefault", "minflt");
+    printf("%10s%8s", "discard", "minflt");
+    printf("\n");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid) {
+	    printf("%2d%12s%8s%8s", i, "-", "-", "-");
+	    if (faults)
+		printf("%10s%8s", "-", "-");
+	    printf("%10s%8s", "-", "-");
+	    printf("\n");
+	    continue;
+	}
+	printf("%2d%12.0f%8.0f%8.0f", i, stats[i].heapsize/1e3,
+	       stats[i].pgfaults.minor, stats[i].pgfaults.major);
+	if (faults)
+	    printf("%10.0f%8.0f",
+		   (stats[i].ops/1e3)/stats[i].secs_prefault,
+		   stats[i].pgfaults_prefault.minor);
+	printf("%10.0f%8.0f", (stats[i].ops/1e3)/stats[i].secs_discard,
+	       stats[i].pgfaults_discard.minor);
+	printf("\n");
+    }
+}
+
+/*
+ * printopshares - prints the share of the cycles of a trace spent in
+ *     each request type
+ */
+static void printopshares(mdriver_opcost_t *opcost)
+{
+    double total = 0;
+    int j;
+
+    for (j = 0; j < MDRIVER_NOPTYPES; j++)
+	total += opcost[j].cycles;
+    for (j = 0; j < MDRIVER_NOPTYPES; j++)
+	printf("%6.0f%%", (total > 0) ? opcost[j].cycles/total*100.0 : 0.0);
+}
+
+/*
+ * printopcosts - prints the number of calls of each request type and
+ *     their average cycles per call, for each trace
+ */
+static void printopcosts(int n, stats_t *stats) 
+{
+    mdriver_opcost_t *c;
+    int i, j;
+
+    printf("%5s", "trace");
+    for (j = 0; j < MDRIVER_NOPTYPES; j++)
+	printf("%9s%8s", opnames[j], "cyc/op");
+    printf("\n");
+    for (i=0; i < n; i++) {
+	printf("%2d   ", i);
+	for (j = 0; j < MDRIVER_NOPTYPES; j++) {
+	    c = &stats[i].opcost[j];
+	    if (!stats[i].valid)
+		printf("%9s%8s", "-", "-");
+	    else if (c->calls == 0)
+		printf("%9.0f%8s", c->calls, "-");
+	    else
+		printf("%9.0f%8.0f", c->calls, c->cycles/c->calls);
+	}
+	printf("\n");
     }
+}
+
+/*
+ * printtouch - prints the cycles and LLC misses of the payload-touch
+ *     replay of each trace, in total and per request
+ */
+static void printtouch(int n, stats_t *stats) 
+{
+    int i;
 
+    printf("%5s%10s%10s%8s%10s%8s\n", "trace", "ops", "Mcycles", "cyc/op",
+	   "misses", "miss/op");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid) {
+	    printf("%2d%13s%10s%8s%10s%8s\n", i, "-", "-", "-", "-", "-");
+	    continue;
+	}
+	printf("%2d%13.0f%10.1f%8.0f", i, stats[i].ops,
+	       stats[i].touch_cycles/1e6, stats[i].touch_cycles/stats[i].ops);
+	if (stats[i].touch_misses < 0)
+	    printf("%10s%8s\n", "-", "-");
+	else
+	    printf("%10.0f%8.3f\n", stats[i].touch_misses,
+		   stats[i].touch_misses/stats[i].ops);
+    }
+}
+
+/*
+ * printsim - prints the metadata traffic (bytes loaded and stored,
+ *     distinct lines touched), cache misses, and TLB misses the cache
+ *     model counted for the allocator (and the misses for the
+ *     payloads, with -T) on each trace, per request, next to its Kops
+ */
+static void printsim(int n, stats_t *stats) 
+{
+    cachesim_stats_t *meta, *payload;
+    int i;
+
+    printf("%5s%10s%6s%8s%8s%8s%8s%8s", "trace", "ops", "Kops", "ldB/op",
+	   "stB/op", "line/op", "miss/op", "tlb/op");
+    if (touch)
+	printf("%8s%8s", "pmiss", "ptlb");
+    printf("\n");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid) {
+	    printf("%2d%13s%6s%8s%8s%8s%8s%8s", i, "-", "-", "-", "-", "-",
+		   "-", "-");
+	    if (touch)
+		printf("%8s%8s", "-", "-");
+	    printf("\n");
+	    continue;
+	}
+	meta = &stats[i].sim[CACHESIM_META];
+	payload = &stats[i].sim[CACHESIM_PAYLOAD];
+	printf("%2d%13.0f%6.0f%8.1f%8.1f%8.2f%8.3f%8.3f", i, stats[i].ops,
+	       (stats[i].ops/1e3)/stats[i].secs,
+	       meta->load_bytes/stats[i].ops, meta->store_bytes/stats[i].ops,
+	       meta->lines/stats[i].ops, meta->misses/stats[i].ops,
+	       meta->tlb_misses/stats[i].ops);
+	if (touch)
+	    printf("%8.3f%8.3f", payload->misses/stats[i].ops,
+		   payload->tlb_misses/stats[i].ops);
+	printf("\n");
+    }
+}
+
+/*
+ * printmodel - prints the instructions of each trace, per request, and
+ *     the throughput that the cost model of config.h makes of them (and
+ *     of the cache model's misses, with -S)
+ */
+static void printmodel(int n, stats_t *stats) 
+{
+    int i;
+
+    printf("%5s%10s%10s%8s%10s\n", "trace", "ops", "Minsns", "ins/op",
+	   "modelKops");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid) {
+	    printf("%2d%13s%10s%8s%10s\n", i, "-", "-", "-", "-");
+	    continue;
+	}
+	printf("%2d%13.0f%10.2f%8.1f%10.0f\n", i, stats[i].ops,
+	       stats[i].insns/1e6, stats[i].insns/stats[i].ops,
+	       (stats[i].ops/1e3)/model_secs(&stats[i]));
+    }
+}
+
+/*
+ * printwindows - Replays trace in windows of window requests and
+ *     prints the throughput and heap growth of each. Windows whose
+ *     cycles per request exceed window_factor times the median of the
+ *     trace are flagged with the request type and the size class that
+ *     take most of their cycles. Returns -1 if the allocator failed.
+ */
+static int printwindows(const mdriver_allocator_t *alloc,
+			mdriver_trace_t *trace, char *name)
+{
+    mdriver_window_t *windows, *w;
+    double *cost, median;
+    int i, j, n, type, class, flagged = 0;
+
+    n = (mdriver_trace_num_ops(trace) + window - 1) / window;
+    windows = (mdriver_window_t *)malloc(n * sizeof(mdriver_window_t));
+    cost = (double *)malloc(n * sizeof(double));
+    if (windows == NULL || cost == NULL)
+	unix_error("malloc in printwindows failed");
+    if ((n = mdriver_eval_windows(alloc, trace, window, windows)) < 0) {
+	free(windows);
+	free(cost);
+	return -1;
+    }
+
+    /* The median cost of a request in a window of this trace */
+    for (i = 0; i < n; i++)
+	cost[i] = windows[i].cycles / windows[i].ops;
+    qsort(cost, n, sizeof(double), cmp_doubles);
+    median = (n % 2) ? cost[n/2] : (cost[n/2 - 1] + cost[n/2]) / 2;
+
+    printf("\nWindows of %d requests of %s malloc on %s "
+	   "(median %.0f cyc/op):\n", window, alloc->name, name, median);
+    printf("%6s%9s%10s%8s%10s\n", "window", "first", "Kops", "cyc/op",
+	   "heap KB");
+    for (i = 0; i < n; i++) {
+	w = &windows[i];
+	printf("%5d%c%9d", i,
+	       w->cycles / w->ops > window_factor * median ? '*' : ' ',
+	       w->first);
+	if (w->secs > 0)
+	    printf("%10.0f", (w->ops/1e3) / w->secs);
+	else
+	    printf("%10s", "-");
+	printf("%8.0f%+10.1f", w->cycles / w->ops, w->heap_growth/1024.0);
+	if (w->cycles / w->ops <= window_factor * median) {
+	    printf("\n");
+	    continue;
+	}
+
+	/* What the cycles of a slow window went to */
+	flagged++;
+	for (type = 0, j = 1; j < MDRIVER_NOPTYPES; j++)
+	    if (w->opcost[j].cycles > w->opcost[type].cycles)
+		type = j;
+	for (class = 0, j = 1; j < MDRIVER_NSIZECLASSES; j++)
+	    if (w->sizecost[j].cycles > w->sizecost[class].cycles)
+		class = j;
+	printf("  %s %.0f%%, ", opnames[type],
+	       100 * w->opcost[type].cycles / w->cycles);
+	if (class == 0)
+	    printf("0-1");
+	else
+	    printf("%lu-%lu", (1UL << (class-1)) + 1, 1UL << class);
+	printf(" bytes %.0f%%\n", 100 * w->sizecost[class].cycles / w->cycles);
+    }
+    printf("%d of %d windows over %.1fx the median cyc/op\n",
+	   flagged, n, window_factor);
+
+    free(windows);
+    free(cost);
+    return n;
+}
+
+/*
+ * cmp_doubles - qsort comparison of two doubles
+ */
+static int cmp_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * model_secs - The secs that the cost model of config.h charges for a
+ *     replay of a trace: its instructions, and the cache and TLB
+ *     misses of the allocator in the cache model (0 without -S)
+ */
+static double model_secs(stats_t *stats)
+{
+    double cycles = MODEL_INSN_CYCLES * stats->insns;
+
+    if (simulate)
+	cycles += MODEL_MISS_CYCLES * stats->sim[CACHESIM_META].misses +
+	    MODEL_TLB_CYCLES * stats->sim[CACHESIM_META].tlb_misses;
+    return cycles / MODEL_HZ;
+}
+
+/*
+ * printovhd - prints the driver overhead and the allocator-only
+ *     throughput (Kops with the overhead subtracted) for some trace
+ */
+static void printovhd(double ops, double secs, double ovhd)
+{
+    if (secs > ovhd)
+	printf("%10.6f%8.0f", ovhd, (ops/1e3)/(secs - ovhd));
+    else /* the allocator is indistinguishable from the null allocator */
+	printf("%10.6f%8s", ovhd, "-");
 }
 
 /* 
@@ -988,12 +1930,178 @@ void unix_error(char *msg)
 }
 
 /*
- * malloc_error - Report an error returned by the mm_malloc package
+ * malloc_error - Report an error returned by the malloc package
  */
-void malloc_error(int tracenum, int opnum, char *msg)
+void malloc_error(int tracenum, stats_t *stats)
 {
     errors++;
-    printf("ERROR [trace %d, line %d]: %s\n", tracenum, LINENUM(opnum), msg);
+    if (stats->errop < 0)
+	printf("ERROR [trace %d]: %s\n", tracenum, stats->errmsg);
+    else
+	printf("ERROR [trace %d, line %d]: %s\n", tracenum, 
+	       LINENUM(stats->errop), stats->errmsg);
+}
+
+/*
+ * parse_window - Parse the argument of -w: requests per window,
+ *     optionally followed by the factor over the median cost of a
+ *     request that flags a window (e.g. "1000" or "500,3")
+ */
+static void parse_window(char *arg)
+{
+    char *end;
+
+    window = (int)strtol(arg, &end, 10);
+    if (*end == ',')
+	window_factor = strtod(end+1, &end);
+    if (window < 1 || window_factor <= 0 || *end != '\0') {
+	usage();
+	exit(1);
+    }
+}
+
+/*
+ * parse_checkpoint - Parse the argument of -C: the request to take the
+ *     checkpoint at and the file to write it to (e.g. "3000000,late.ckpt")
+ */
+static void parse_checkpoint(char *arg)
+{
+    char *end;
+
+    checkpoint_at = strtoll(arg, &end, 10);
+    if (checkpoint_at < 0 || *end != ',' || end[1] == '\0') {
+	usage();
+	exit(1);
+    }
+    checkpoint_file = end+1;
+}
+
+/*
+ * parse_simpoints - Parse the argument of -s: the number of clusters,
+ *     the requests per window, and the index file to write (e.g.
+ *     "8,100000,big.sp")
+ */
+static void parse_simpoints(char *arg)
+{
+    char *end;
+
+    simpoint_k = (int)strtol(arg, &end, 10);
+    if (simpoint_k >= 1 && *end == ',')
+	simpoint_window = (int)strtol(end+1, &end, 10);
+    if (simpoint_k < 1 || simpoint_window < 1 || *end != ',' ||
+	end[1] == '\0') {
+	usage();
+	exit(1);
+    }
+    simpoint_file = end+1;
+}
+
+/*
+ * parse_secs - Convert a positive time such as "2", "2s", or "500ms" to
+ *     seconds
+ */
+static double parse_secs(char *arg)
+{
+    char *unit;
+    double secs = strtod(arg, &unit);
+
+    if (!strcmp(unit, "ms"))
+	secs /= 1e3;
+    if (unit == arg || secs <= 0 ||
+	(strcmp(unit, "") && strcmp(unit, "s") && strcmp(unit, "ms"))) {
+	usage();
+	exit(1);
+    }
+    return secs;
+}
+
+/*
+ * parse_bytes - Convert a size such as "64M" or "2G" to bytes
+ */
+static double parse_bytes(char *arg)
+{
+    char *unit;
+    double bytes = strtod(arg, &unit);
+
+    if (!strcmp(unit, "K") || !strcmp(unit, "k"))
+	bytes *= 1<<10;
+    else if (!strcmp(unit, "M") || !strcmp(unit, "m"))
+	bytes *= 1<<20;
+    else if (!strcmp(unit, "G") || !strcmp(unit, "g"))
+	bytes *= 1<<30;
+    else if (strcmp(unit, "")) {
+	usage();
+	exit(1);
+    }
+    return bytes;
+}
+
+/*
+ * parse_access - Set the fields of the access model given as a comma
+ *     separated list such as "stride=64,period=0,read=0"
+ */
+static void parse_access(char *arg, mdriver_access_t *access)
+{
+    char buf[MAXLINE], *key, *val;
+
+    strncpy(buf, arg, MAXLINE-1);
+    buf[MAXLINE-1] = '\0';
+    for (key = strtok(buf, ","); key; key = strtok(NULL, ",")) {
+	if ((val = strchr(key, '=')) == NULL) {
+	    usage();
+	    exit(1);
+	}
+	*val++ = '\0';
+	if (!strcmp(key, "stride"))
+	    access->stride = atoi(val);
+	else if (!strcmp(key, "write"))
+	    access->write_alloc = atoi(val);
+	else if (!strcmp(key, "period"))
+	    access->period = atoi(val);
+	else if (!strcmp(key, "recent"))
+	    access->recent = atoi(val);
+	else if (!strcmp(key, "read"))
+	    access->read_free = atoi(val);
+	else {
+	    usage();
+	    exit(1);
+	}
+    }
+}
+
+/*
+ * parse_geometry - Set the fields of the cache model's geometry given
+ *     as a comma separated list such as "size=1M,assoc=16,tlb=1536"
+ */
+static void parse_geometry(char *arg, cachesim_config_t *config)
+{
+    char buf[MAXLINE], *key, *val;
+
+    strncpy(buf, arg, MAXLINE-1);
+    buf[MAXLINE-1] = '\0';
+    for (key = strtok(buf, ","); key; key = strtok(NULL, ",")) {
+	if ((val = strchr(key, '=')) == NULL) {
+	    usage();
+	    exit(1);
+	}
+	*val++ = '\0';
+	if (!strcmp(key, "size"))
+	    config->cache_size = (int)parse_bytes(val);
+	else if (!strcmp(key, "line"))
+	    config->line_size = (int)parse_bytes(val);
+	else if (!strcmp(key, "assoc"))
+	    config->assoc = atoi(val);
+	else if (!strcmp(key, "tlb"))
+	    config->tlb_entries = atoi(val);
+	else if (!strcmp(key, "tlbassoc"))
+	    config->tlb_assoc = atoi(val);
+	else if (!strcmp(key, "page"))
+	    config->page_size = (int)parse_bytes(val);
+	else {
+	    usage();
+	    exit(1);
+	}
+    }
 }
 
 /* 
@@ -1001,14 +2109,45 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValcDFILOSTXi] [-f <file>] [-t <dir>] [-m <file>] [-B <secs>] [-E <file>]\n"
+	    "               [-H <size>] [-K <copies>] [-A <model>] [-G <geom>] [-P <file>]\n"
+	    "               [-p <hz>] [-w <n>[,<factor>]] [-W <secs>] [-C <n>,<file>]\n"
+	    "               [-R <file>] [-s <k>,<n>,<file>] [-e <file>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-A <model> Access model of -T (e.g. stride=64,period=0,read=0).\n");
+    fprintf(stderr, "\t-B <secs>  Time budget for timing each trace (e.g. 2s).\n");
+    fprintf(stderr, "\t-c         Calibrate driver overhead with a null allocator.\n");
+    fprintf(stderr, "\t-C <n>,<file> Checkpoint at request n to <file>, replay from there.\n");
+    fprintf(stderr, "\t-D         Also time every sample on a fresh heap (page faults).\n");
+    fprintf(stderr, "\t-e <file>  Estimate thru from the windows picked by -s.\n");
+    fprintf(stderr, "\t-E <file>  Write a per-request timeline (Chrome trace events).\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-F         Time with and without page faults on the heap.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
+    fprintf(stderr, "\t-G <geom>  Geometry of -S (e.g. size=1M,assoc=16,tlb=1536).\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H <size>  Size of the simulated heap (e.g. 256M).\n");
+    fprintf(stderr, "\t-i         Interleave the copies of -K at random.\n");
+    fprintf(stderr, "\t-I         Score throughput by instructions (see config.h).\n");
+    fprintf(stderr, "\t-K <n>     Replay n copies of each trace in one heap.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Cap throughput with libc on this host (cached).\n");
+    fprintf(stderr, "\t-m <file>  Use the traces and weights of a workload-mix profile.\n");
+    fprintf(stderr, "\t-O         Attribute cycles to malloc, free, and realloc.\n");
+    fprintf(stderr, "\t-p <hz>    Sampling rate of -P (default %d per CPU second).\n",
+	    PROFILE_HZ);
+    fprintf(stderr, "\t-P <file>  Write folded stacks of the timed replays to <file>.\n");
+    fprintf(stderr, "\t-R <file>  Replay from the checkpoint in <file> (see -C).\n");
+    fprintf(stderr, "\t-s <k>,<n>,<file> Pick windows of n requests of k clusters, check them.\n");
+    fprintf(stderr, "\t-S         Replay through a cache and TLB model (misses).\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T         Replay touching the payloads (cycles, LLC misses).\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
+    fprintf(stderr, "\t-w <n>[,f] Report windows of n requests; flag f times the median (%.1f).\n",
+	    WINDOW_FACTOR);
+    fprintf(stderr, "\t-W <secs>  CPU time limit for each trace (default %d s).\n",
+	    TRACE_CPU_LIMIT);
+    fprintf(stderr, "\t-X         Evaluate the traces in the driver process itself.\n");
 }
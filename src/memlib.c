@@ -14,24 +14,46 @@
 #include "memlib.h"
 #include "config.h"
 
+/* 
+ * The heap is a virtual address range of mem_max_heap bytes that is
+ * reserved (PROT_NONE) at once, but only made accessible (committed)
+ * in COMMIT_CHUNK steps as mem_sbrk grows the heap. Startup stays
+ * cheap for large heaps, and memory is only used as far as the
+ * allocator actually extends the heap. A timed caller commits the
+ * heap with mem_precommit beforehand, so that mem_sbrk doesn't call
+ * mprotect while it is being timed.
+ */
+#define COMMIT_CHUNK (1<<20) /* bytes committed at once */
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_commit_brk; /* end of the committed part of the heap */
+static size_t mem_max_heap = MAX_HEAP; /* size of the reservation */
+
+/* private functions */
+static char *mem_reserve(size_t bytes);
+static int mem_commit(char *addr);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-		fprintf(stderr, "mem_init_vm: malloc error\n");
+    /* reserve the address range we will use to model the available VM */
+    if ((mem_start_brk = mem_reserve(mem_max_heap)) == NULL) {
+		fprintf(stderr, "mem_init_vm: mmap error\n");
 		exit(1);
     }
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
+    mem_max_addr = mem_start_brk + mem_max_heap;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_commit_brk = mem_start_brk;           /* nothing committed yet */
 }
 
 /* 
@@ -39,7 +61,31 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    munmap(mem_start_brk, mem_max_heap);
+    mem_start_brk = NULL;
+}
+
+/*
+ * mem_set_max_heap - change the size of the heap from MAX_HEAP to bytes.
+ *    The heap becomes empty. Returns -1 (and keeps the old heap) if
+ *    the address range can't be reserved. On 32-bit builds, the
+ *    address space limits the heap to somewhat less than 3 GB.
+ */
+int mem_set_max_heap(size_t bytes)
+{
+    char *start;
+
+    if (mem_start_brk != NULL) {
+	if ((start = mem_reserve(bytes)) == NULL)
+	    return -1;
+	munmap(mem_start_brk, mem_max_heap);
+	mem_start_brk = start;
+	mem_max_addr = mem_start_brk + bytes;
+	mem_brk = mem_start_brk;
+	mem_commit_brk = mem_start_brk;
+    }
+    mem_max_heap = bytes;
+    return 0;
 }
 
 /*
@@ -59,7 +105,8 @@ void *mem_sbrk(int incr)
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr) ||
+	 ((mem_brk + incr) > mem_commit_brk && mem_commit(mem_brk + incr) < 0)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
@@ -99,3 +146,122 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_reserve - reserve an inaccessible address range of bytes bytes,
+ *    without committing memory for it. Returns NULL on failure.
+ */
+static char *mem_reserve(size_t bytes)
+{
+    void *start = mmap(NULL, bytes, PROT_NONE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    return (start == MAP_FAILED) ? NULL : (char *)start;
+}
+
+/*
+ * mem_commit - make the heap accessible up to at least addr, rounded up
+ *    to the next COMMIT_CHUNK. The committed part never shrinks, so
+ *    only the first run of a trace that grows the heap pays for it.
+ */
+static int mem_commit(char *addr)
+{
+    size_t size = (size_t)(addr - mem_start_brk);
+    char *end;
+
+    size = (size + COMMIT_CHUNK-1) / COMMIT_CHUNK * COMMIT_CHUNK;
+    end = (size < mem_max_heap) ? mem_start_brk + size : mem_max_addr;
+    if (mprotect(mem_commit_brk, end - mem_commit_brk, 
+		 PROT_READ | PROT_WRITE) < 0)
+	return -1;
+    mem_commit_brk = end;
+    return 0;
+}
+
+/*
+ * mem_prefault - map the pages of the first bytes of the heap ahead of
+ *    time, so that an allocator growing its heap up to that size takes
+ *    no page faults. This clobbers the contents of those bytes, so only
+ *    call it on an empty heap.
+ */
+void mem_prefault(size_t bytes)
+{
+    char *lo = mem_start_brk, *hi, *p;
+
+    if (bytes > mem_max_heap)
+	bytes = mem_max_heap;
+    if (bytes == 0 || (lo + bytes > mem_commit_brk && mem_commit(lo + bytes) < 0))
+	return;
+    hi = lo + bytes;
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(lo, hi - lo, MADV_POPULATE_WRITE) == 0)
+	return;
+#endif
+    /* Write a byte of every page, since reads would map the zero page */
+    for (p = lo; p < hi; p += mem_pagesize())
+	*(volatile char *)p = 0;
+}
+
+/*
+ * mem_precommit - commit the first bytes of the heap ahead of time
+ *    without touching them, so that an allocator growing its heap up to
+ *    that size doesn't make mem_sbrk call mprotect. Unlike
+ *    mem_prefault, this keeps the contents of the heap. Returns -1 on
+ *    failure.
+ */
+int mem_precommit(size_t bytes)
+{
+    if (bytes > mem_max_heap)
+	bytes = mem_max_heap;
+    if (mem_start_brk + bytes > mem_commit_brk)
+	return mem_commit(mem_start_brk + bytes);
+    return 0;
+}
+
+/*
+ * mem_restore - make the heap a copy of the size bytes at bytes, with
+ *    its first byte at lo: where the heap was when the copy was made,
+ *    since the blocks in it point to each other. If the heap is
+ *    elsewhere, its address range is reserved again at lo. Returns -1
+ *    (and keeps the old heap) if lo is taken or the heap is too small.
+ */
+int mem_restore(void *lo, const void *bytes, size_t size)
+{
+    char *start = lo;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+    if (size > mem_max_heap)
+	return -1;
+    if (start != mem_start_brk) {
+#ifdef MAP_FIXED_NOREPLACE
+	flags |= MAP_FIXED_NOREPLACE;
+#endif
+	start = mmap(lo, mem_max_heap, PROT_NONE, flags, -1, 0);
+	if (start == MAP_FAILED)
+	    return -1;
+	if (start != lo) { /* only a hint without MAP_FIXED_NOREPLACE */
+	    munmap(start, mem_max_heap);
+	    return -1;
+	}
+	munmap(mem_start_brk, mem_max_heap);
+	mem_start_brk = start;
+	mem_max_addr = mem_start_brk + mem_max_heap;
+	mem_commit_brk = mem_start_brk;
+    }
+    if (start + size > mem_commit_brk && mem_commit(start + size) < 0)
+	return -1;
+    memcpy(start, bytes, size);
+    mem_brk = start + size;
+    return 0;
+}
+
+/*
+ * mem_discard - give the pages of the heap back to the system, so that
+ *    an allocator takes a page fault again the first time it touches
+ *    each page. The contents of the heap are lost.
+ */
+void mem_discard(void)
+{
+    if (mem_commit_brk > mem_start_brk)
+	madvise(mem_start_brk, mem_commit_brk - mem_start_brk, MADV_DONTNEED);
+}
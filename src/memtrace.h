@@ -0,0 +1,60 @@
+/*
+ * memtrace.h - Opt-in hooks that feed an allocator's memory accesses
+ *     to the cache model in cachesim.c
+ *
+ * An allocator that wants its metadata accesses counted routes them
+ * through these macros, typically inside its own access macros:
+ *
+ *     #define GET(p)       (MEMTRACE_LOAD(p, WSIZE), *(size_t *)(p))
+ *     #define PUT(p, val)  (MEMTRACE_STORE(p, WSIZE), *(size_t *)(p) = (val))
+ *     #define TAG(p)       MEMTRACE_GET(*((int *)(p)-1))
+ *
+ * or around the accesses themselves, for code that uses struct fields:
+ *
+ *     y = MEMTRACE_GET(x->Right);
+ *     MEMTRACE_SET(x->Right, y->Left);
+ *
+ * MEMTRACE_REF is an lvalue, for macros that are both read and
+ * assigned, but it counts every access as a load, so a store through
+ * it is miscounted; prefer MEMTRACE_GET and MEMTRACE_SET. Those
+ * evaluate their lvalue twice, so it must not have side effects, and
+ * nesting one in the lvalue of another counts the inner access twice.
+ * Unless MEMTRACE is defined (as in "make mdriver-sim"), the hooks
+ * compile to nothing and the accesses are plain memory accesses.
+ * Accesses that don't go through the hooks are invisible to the model.
+ */
+#ifndef __MEMTRACE_H_
+#define __MEMTRACE_H_
+
+#ifdef MEMTRACE
+#include "cachesim.h"
+
+#define MEMTRACE_LOAD(p, n) \
+    (cachesim_on ? cachesim_access((p), (n), 0) : (void)0)
+#define MEMTRACE_STORE(p, n) \
+    (cachesim_on ? cachesim_access((p), (n), 1) : (void)0)
+#define MEMTRACE_REF(type, p) \
+    (*(type *)memtrace_ref((p), sizeof(type)))
+#define MEMTRACE_GET(lv) \
+    (MEMTRACE_LOAD(&(lv), sizeof(lv)), (lv))
+#define MEMTRACE_SET(lv, val) \
+    (MEMTRACE_STORE(&(lv), sizeof(lv)), (lv) = (val))
+
+static inline void *memtrace_ref(void *p, size_t n)
+{
+    if (cachesim_on)
+	cachesim_access(p, n, 0);
+    return p;
+}
+
+#else /* !MEMTRACE */
+
+#define MEMTRACE_LOAD(p, n)   ((void)0)
+#define MEMTRACE_STORE(p, n)  ((void)0)
+#define MEMTRACE_REF(type, p) (*(type *)(p))
+#define MEMTRACE_GET(lv)      (lv)
+#define MEMTRACE_SET(lv, val) ((lv) = (val))
+
+#endif /* MEMTRACE */
+
+#endif /* __MEMTRACE_H_ */
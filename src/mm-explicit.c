@@ -19,6 +19,7 @@
 
 #include "memlib.h"
 #include "mm.h"
+#include "memtrace.h"
 
 team_t team = {
     /* Team name to be displayed on webpage */
@@ -34,6 +35,10 @@ team_t team = {
 };
 
 
+/* Read and write a header or footer tag (counted by the cache model) */
+#define GETTAG(p)       MEMTRACE_GET(*(int *)(p))
+#define PUTTAG(p, val)  MEMTRACE_SET(*(int *)(p), (val))
+
 typedef struct listHead {
     void * ptrFirstFreeBlock;
 } listHead;
@@ -56,14 +61,14 @@ static void * searchFreeList(int reqSize)
     void* ptrFreeBlock;
     int blockSize;
 
-    ptrFreeBlock = (listHead *)(((listHead *)mem_heap_lo())->ptrFirstFreeBlock);
+    ptrFreeBlock = (listHead *)MEMTRACE_GET(((listHead *)mem_heap_lo())->ptrFirstFreeBlock);
 
     while ((boolInFreeList == 0)&& (ptrFreeBlock != NULL)){
-	blockSize = (*(int *)ptrFreeBlock)&(~(0x7));
+	blockSize = GETTAG(ptrFreeBlock)&(~(0x7));
 	if (blockSize >= reqSize) {
 	    boolInFreeList = 1;
 	}else
-	    ptrFreeBlock = ((freeStruct *)ptrFreeBlock)->pNext;
+	    ptrFreeBlock = MEMTRACE_GET(((freeStruct *)ptrFreeBlock)->pNext);
     }
     if (boolInFreeList == 0) return NULL;
     else return ptrFreeBlock;
@@ -76,15 +81,15 @@ static void insertFreeBlock(void *ptrFreeBlock)
     void * ptrNextBlock;
   
     ptrPrevBlock = mem_heap_lo();
-    ptrNextBlock = ((listHead *)ptrPrevBlock)->ptrFirstFreeBlock;
+    ptrNextBlock = MEMTRACE_GET(((listHead *)ptrPrevBlock)->ptrFirstFreeBlock);
 
     /* update the double linked list 
        with LIFO scheme*/
-    ((freeStruct *)ptrFreeBlock)->pNext = ptrNextBlock;
-    if (ptrNextBlock != NULL) ((freeStruct *)ptrNextBlock)->pPrev = ptrFreeBlock;
+    MEMTRACE_SET(((freeStruct *)ptrFreeBlock)->pNext, ptrNextBlock);
+    if (ptrNextBlock != NULL) MEMTRACE_SET(((freeStruct *)ptrNextBlock)->pPrev, ptrFreeBlock);
 
-    ((freeStruct *)ptrFreeBlock)->pPrev = ptrPrevBlock;
-    ((listHead *)mem_heap_lo())->ptrFirstFreeBlock = ptrFreeBlock;
+    MEMTRACE_SET(((freeStruct *)ptrFreeBlock)->pPrev, ptrPrevBlock);
+    MEMTRACE_SET(((listHead *)mem_heap_lo())->ptrFirstFreeBlock, ptrFreeBlock);
 }      
 
 
@@ -92,17 +97,17 @@ static void removeFreeBlock(void *ptrFreeBlock)
 {
     void *pNextFree, *pPrevFree;
   
-    pNextFree = ((freeStruct *)ptrFreeBlock)->pNext;
-    pPrevFree = ((freeStruct *)ptrFreeBlock)->pPrev;
+    pNextFree = MEMTRACE_GET(((freeStruct *)ptrFreeBlock)->pNext);
+    pPrevFree = MEMTRACE_GET(((freeStruct *)ptrFreeBlock)->pPrev);
 
     /* housekeeping the double linked list*/
     if (pNextFree != NULL) {
-	((freeStruct *)pNextFree)->pPrev = pPrevFree;
+	MEMTRACE_SET(((freeStruct *)pNextFree)->pPrev, pPrevFree);
     }
     if ((unsigned int)pPrevFree == (unsigned int)mem_heap_lo())
-	((listHead *)mem_heap_lo())->ptrFirstFreeBlock = pNextFree;
+	MEMTRACE_SET(((listHead *)mem_heap_lo())->ptrFirstFreeBlock, pNextFree);
     else
-	((freeStruct *)pPrevFree)->pNext = pNextFree;
+	MEMTRACE_SET(((freeStruct *)pPrevFree)->pNext, pNextFree);
 }
 
 static void coalesceFreeBlock(void *ptrBlock)
@@ -113,18 +118,18 @@ static void coalesceFreeBlock(void *ptrBlock)
     int prevTotalSize = 0 ,nextTotalSize = 0, totalSize;
     int thisSize;
 
-    thisSize = (*(int *)ptrBlock) & (~0x7);
+    thisSize = GETTAG(ptrBlock) & (~0x7);
 
     /* coalesce with any proceding free block */
     ptrCurrentBlock = ptrBlock;
-    while ((((*(int *)ptrCurrentBlock))&(0x2))==0){ 
+    while ((GETTAG(ptrCurrentBlock)&(0x2))==0){ 
 	/*previous block is free*/
 	int size;
 
 	/* remove the previous block from it's size class list*/
 	ptrBoundaryTag = ((char *)ptrCurrentBlock-4);
 
-	size = (*(int *)ptrBoundaryTag) &(~0x7);
+	size = GETTAG(ptrBoundaryTag) &(~0x7);
 	ptrFreeBlock = (char *)ptrCurrentBlock-size;
 	removeFreeBlock(ptrFreeBlock);
 
@@ -136,10 +141,10 @@ static void coalesceFreeBlock(void *ptrBlock)
 
     /* coalesce with any following free block */
     ptrCurrentBlock = (char *)ptrBlock+thisSize;
-    while (((*(int *)ptrCurrentBlock) &(0x1))==0){/* current block is free*/
+    while ((GETTAG(ptrCurrentBlock) &(0x1))==0){/* current block is free*/
 	int size;
   
-	size = (*(int *)ptrCurrentBlock) & (~0x7);
+	size = GETTAG(ptrCurrentBlock) & (~0x7);
 	removeFreeBlock(ptrCurrentBlock);
     
 	nextTotalSize += size;
@@ -153,8 +158,8 @@ static void coalesceFreeBlock(void *ptrBlock)
 	/* we shall remove "ptrBlock" to generate the new larger block*/
 	removeFreeBlock(ptrBlock);
 
-	*(int *)ptrHeaderBlock = totalSize|0x2;
-	*(int *)ptrFooterBlock = totalSize|0x2;
+	PUTTAG(ptrHeaderBlock, totalSize|0x2);
+	PUTTAG(ptrFooterBlock, totalSize|0x2);
 	insertFreeBlock(ptrHeaderBlock);
     }
     return;
@@ -177,16 +182,16 @@ static void requestMoreSpace(int reqSize)
 
     /* initialize header, inherit bit 1 from the previously useless last word*/
     /* however, reset the fake in use bit at bit 0*/
-    prevLastWordMask = (*(int *)ptrNewBlock) & 0x2;
-    ((freeStruct *)ptrNewBlock)->size = totalSize | prevLastWordMask;
+    prevLastWordMask = GETTAG(ptrNewBlock) & 0x2;
+    PUTTAG(ptrNewBlock, totalSize | prevLastWordMask);
     /* initialize footer*/
-    *(int *)((char *)((char *)(ptrNewBlock) + totalSize) - 4) = 
-	     totalSize | prevLastWordMask;
+    PUTTAG((char *)((char *)(ptrNewBlock) + totalSize) - 4,
+	   totalSize | prevLastWordMask);
 
     /* initialize "new" useless last word
        the previous block is free at this moment
        but this word is useless, so its use bit is set*/
-    *(int *)((char *)ptrNewBlock + totalSize) = 0x1;
+    PUTTAG((char *)ptrNewBlock + totalSize, 0x1);
 
     insertFreeBlock(ptrNewBlock);
     /* immediate coalesce of newly allocated memory space*/
@@ -240,29 +245,30 @@ void *mm_malloc (size_t size)
 	ptrFreeBlock = searchFreeList(reqSize);
     }
   
-    blockSize = ((freeStruct *)ptrFreeBlock)->size & (~0x7);
-    oldBit1Mask = ((freeStruct *)ptrFreeBlock)->size &(0x2);
+    blockSize = GETTAG(ptrFreeBlock) & (~0x7);
+    oldBit1Mask = GETTAG(ptrFreeBlock) &(0x2);
     if (blockSize - reqSize >= 16){
 	void *splitFreeBlock;
 
 	splitFreeBlock = (char *)ptrFreeBlock + reqSize;
 	removeFreeBlock(ptrFreeBlock);
 
-	*(int *)ptrFreeBlock = reqSize|(oldBit1Mask)|0x5;
+	PUTTAG(ptrFreeBlock, reqSize|(oldBit1Mask)|0x5);
     
 	/* update the free split block header and footer*/
-	((freeStruct *)splitFreeBlock)->size =(blockSize - reqSize)|0x2;
-	*(int *)((char *)((char *)ptrFreeBlock + blockSize) - 4) = 
-	    ((blockSize-reqSize) |0x2);
+	PUTTAG(splitFreeBlock, (blockSize - reqSize)|0x2);
+	PUTTAG((char *)((char *)ptrFreeBlock + blockSize) - 4,
+	       ((blockSize-reqSize) |0x2));
 
 	insertFreeBlock(splitFreeBlock);
     }
     else{
 	/* update the allocated block header*/
-	*(int *)ptrFreeBlock |= 0x5;
+	PUTTAG(ptrFreeBlock, GETTAG(ptrFreeBlock) | 0x5);
 	/* update the adjacent block header, no matter it's in use, 
 	   free or useless */
-	*(int *)((char *)ptrFreeBlock+blockSize) |= 0x2;
+	PUTTAG((char *)ptrFreeBlock+blockSize,
+	       GETTAG((char *)ptrFreeBlock+blockSize) | 0x2);
 
 	/* remove the chosen block from its free list */
 	removeFreeBlock(ptrFreeBlock);
@@ -291,14 +297,14 @@ void *mm_realloc(void *ptr, size_t size)
     }
   
     oldHeader = (char *)ptr - 4;
-    bit0Mask = (*(int *)oldHeader) & 0x1;
+    bit0Mask = GETTAG(oldHeader) & 0x1;
     if (bit0Mask != 1 ) /* no warning is given here*/
 	return NULL;
 
     if (size <= 12) reqSize = 16;
     else reqSize = 8 * ((size+4+7)/8);
 
-    currentTotalSize = (*(int *)oldHeader) & (~0x7);
+    currentTotalSize = GETTAG(oldHeader) & (~0x7);
     currentPayloadSize = currentTotalSize - 4;
 
     if (currentTotalSize >= reqSize){
@@ -306,8 +312,8 @@ void *mm_realloc(void *ptr, size_t size)
 	if (currentPayloadSize>=(size+4)){
 	    /* done, no movement necessary*/
 	    /* create/update header and trailer */
-	    *(int *)(oldHeader) &= (~0x4);
-	    *(int *)((char *)oldHeader+currentPayloadSize) = size;
+	    PUTTAG(oldHeader, GETTAG(oldHeader) & (~0x4));
+	    PUTTAG((char *)oldHeader+currentPayloadSize, size);
 	    return ptr;
 	}
     }
@@ -319,13 +325,13 @@ void *mm_realloc(void *ptr, size_t size)
   
     newPtr = mm_malloc(adjustedSize);
     newHeader = (char *)newPtr-4;
-    *(int *)newHeader &= (~0x4);
-    reqSize = (*(int *)newHeader)&(~0x7);
-    *(int *)((char *)((char *)newHeader+reqSize) - 4) = size;
+    PUTTAG(newHeader, GETTAG(newHeader) & (~0x4));
+    reqSize = GETTAG(newHeader)&(~0x7);
+    PUTTAG((char *)((char *)newHeader+reqSize) - 4, size);
   
-    if (((*(int *)(oldHeader))&0x4) == 0){ /* already realloc block */
+    if ((GETTAG(oldHeader)&0x4) == 0){ /* already realloc block */
 	/* reduce the number of memcopy */
-	copySize = *(int *)((char *)((char *)ptr + currentPayloadSize) - 4);
+	copySize = GETTAG((char *)((char *)ptr + currentPayloadSize) - 4);
     }
     else copySize = currentPayloadSize; /* at maximum two word overhead*/
 
@@ -345,15 +351,31 @@ void mm_free (void *ptr)
 
     ptrFreeBlock = (char *)ptr -4;
   
-    payloadSize = ((*(int *)ptrFreeBlock)&(~0x7)) - 4;
+    payloadSize = (GETTAG(ptrFreeBlock)&(~0x7)) - 4;
     ptrBoundaryTag = (char *)ptrFreeBlock + payloadSize;
     ptrNextBlock = (char *)ptr + payloadSize;
 
-    *(int *)(ptrFreeBlock) = *(int *)ptrBoundaryTag = (*(int *)(ptrFreeBlock))&(~0x5);
-    (*(int *)ptrNextBlock) &= (~0x2);
+    PUTTAG(ptrFreeBlock, PUTTAG(ptrBoundaryTag, GETTAG(ptrFreeBlock)&(~0x5)));
+    PUTTAG(ptrNextBlock, GETTAG(ptrNextBlock) & (~0x2));
 
     insertFreeBlock(ptrFreeBlock);
 
     /* immediate coalesce */
     coalesceFreeBlock(ptrFreeBlock);
 }
+
+/*
+ * mm_save_state - The free list hangs off mem_heap_lo(), so a checkpoint
+ *     saves nothing
+ */
+size_t mm_save_state(void *buf, size_t size)
+{
+    return 0;
+}
+
+/*
+ * mm_restore_state - Nothing to restore
+ */
+void mm_restore_state(const void *buf)
+{
+}
@@ -95,6 +95,22 @@ void *mm_realloc(void *ptr, size_t size)
     return newptr;
 }
 
+/*
+ * mm_save_state - The heap is all the state there is, so a checkpoint
+ *     saves nothing
+ */
+size_t mm_save_state(void *buf, size_t size)
+{
+    return 0;
+}
+
+/*
+ * mm_restore_state - Nothing to restore
+ */
+void mm_restore_state(const void *buf)
+{
+}
+
 
 
 
@@ -15,6 +15,7 @@
 
 #include "memlib.h"
 #include "mm.h"
+#include "memtrace.h"
 
 /*  Team Information  */
 team_t team = {
@@ -77,9 +78,10 @@ typedef struct Node {
 
 /*  Macros for Boundary Tags  */
 
-//  The following 2 are just for use in definitions
-#define __LowTag(p)      (*((int*)(p)-1))
-#define __HiPrevTag(p)   (*((int*)(p)-2))
+//  The following 2 are just for use in definitions (they only read;
+//  setTags writes the tags)
+#define __LowTag(p)      MEMTRACE_GET(*((int*)(p)-1))
+#define __HiPrevTag(p)   MEMTRACE_GET(*((int*)(p)-2))
 
 //  The next few can be safely used with all block pointers
 #define Size(p)          (__LowTag(p) & SIZE_MASK)
@@ -149,7 +151,7 @@ void setTags (void* block, size_t size, int flags)
 {
     int* tag1 = (int*)block - 1;
     int* tag2 = (int*)((char *)block+size)-2;
-    *tag1 = *tag2 = (size | flags);
+    MEMTRACE_SET(*tag1, MEMTRACE_SET(*tag2, (size | flags)));
 }
 
 
@@ -165,26 +167,28 @@ void setTags (void* block, size_t size, int flags)
  * Precondition: x must be non-null with a non-null right child.
  */
 void left_rotate (Node* x) {
-    Node* y = x->Right;
+    Node* y = MEMTRACE_GET(x->Right);
+    Node* p;
 
-    x->Right = y->Left;
+    MEMTRACE_SET(x->Right, MEMTRACE_GET(y->Left));
     if ( y->Left != NULL )
-	y->Left->Parent = x;
+	MEMTRACE_SET(y->Left->Parent, x);
 
     //Set the parent to point to y instead of x
-    y->Parent = x->Parent;
-    if ( x->Parent == NULL )
-	*treeroot = y;
+    p = MEMTRACE_GET(x->Parent);
+    MEMTRACE_SET(y->Parent, p);
+    if ( p == NULL )
+	MEMTRACE_SET(*treeroot, y);
     else
-	if ( x == x->Parent->Left )
+	if ( x == MEMTRACE_GET(p->Left) )
 	    //x was on the left of its parent
-	    x->Parent->Left = y;
+	    MEMTRACE_SET(p->Left, y);
 	else
 	    //x must have been on the right
-	    x->Parent->Right = y;
+	    MEMTRACE_SET(p->Right, y);
 
-    y->Left = x;
-    x->Parent = y;
+    MEMTRACE_SET(y->Left, x);
+    MEMTRACE_SET(x->Parent, y);
 }
 
 /*
@@ -199,46 +203,48 @@ void left_rotate (Node* x) {
  * Precondition: x must be non-null with a non-null left child.
  */
 void right_rotate (Node* x) {
-    Node* y = x->Left;
+    Node* y = MEMTRACE_GET(x->Left);
+    Node* p;
     
-    x->Left = y->Right;
+    MEMTRACE_SET(x->Left, MEMTRACE_GET(y->Right));
     if (y->Right != NULL)
-	y->Right->Parent = x;
+	MEMTRACE_SET(y->Right->Parent, x);
     
-    y->Parent = x->Parent;
+    p = MEMTRACE_GET(x->Parent);
+    MEMTRACE_SET(y->Parent, p);
     
     // Set the parent to point to y instead of x
-    if (x->Parent == NULL) 
-	*treeroot = y;
+    if (p == NULL) 
+	MEMTRACE_SET(*treeroot, y);
     else
-	if (x == x->Parent->Left)
+	if (x == MEMTRACE_GET(p->Left))
 	    // x was on the left of its parent
-	    x->Parent->Left = y;
+	    MEMTRACE_SET(p->Left, y);
 	else
 	    // x must have been on the right
-	    x->Parent->Right = y;
+	    MEMTRACE_SET(p->Right, y);
     
-    y->Right = x;
-    x->Parent = y;
+    MEMTRACE_SET(y->Right, x);
+    MEMTRACE_SET(x->Parent, y);
 }
 
 /*  Color Functions  */
 int isRed (Node* x) {
-    return (x != NULL) && (x->Color == RED);
+    return (x != NULL) && (MEMTRACE_GET(x->Color) == RED);
 }
 
 int isBlack (Node* x) {
-    return (x == NULL) || (x->Color == BLACK);
+    return (x == NULL) || (MEMTRACE_GET(x->Color) == BLACK);
 }
 
 void setblack (Node* x) {
     if (x!=NULL)
-	x->Color = BLACK;
+	MEMTRACE_SET(x->Color, BLACK);
 }
 
 void setred (Node* x) {
     // NULL nodes are never red.
-    x->Color = RED;
+    MEMTRACE_SET(x->Color, RED);
 }
 
 /*
@@ -269,14 +275,16 @@ int isLess (Node* x, Node *y) {
  *
  */
 int tree_insert (Node* x) {
-  Node* current = *treeroot;
+  Node* current = MEMTRACE_GET(*treeroot);
+  Node* next;
 
   //Empty tree --> update root pointer
   if (current == NULL) {
-      *treeroot = x;
-      x->Parent = NULL;
-      x->Right = x->Left = NULL;
-      x->Color = BLACK;
+      MEMTRACE_SET(*treeroot, x);
+      MEMTRACE_SET(x->Parent, NULL);
+      MEMTRACE_SET(x->Right, NULL);
+      MEMTRACE_SET(x->Left, NULL);
+      MEMTRACE_SET(x->Color, BLACK);
       return 0;
   }
 
@@ -284,25 +292,27 @@ int tree_insert (Node* x) {
   while(1) {
       if (isLess(x,current)) {
 	  //x belongs in the left child of current node
-	  if (current->Left != NULL)
-	      current = current->Left;
+	  if ((next = MEMTRACE_GET(current->Left)) != NULL)
+	      current = next;
 	  else {
-	      current->Left = x;
-	      x->Parent = current;
-	      x->Right = x->Left = NULL;
-	      x->Color = RED;
+	      MEMTRACE_SET(current->Left, x);
+	      MEMTRACE_SET(x->Parent, current);
+	      MEMTRACE_SET(x->Right, NULL);
+	      MEMTRACE_SET(x->Left, NULL);
+	      MEMTRACE_SET(x->Color, RED);
 	      return 1; 
 	  }
       }
       else {
 	  //x belongs in the right child of current node
-	  if (current->Right != NULL)
-	      current = current->Right;
+	  if ((next = MEMTRACE_GET(current->Right)) != NULL)
+	      current = next;
 	  else {
-	      current->Right = x;
-	      x->Parent = current;
-	      x->Right = x->Left = NULL;
-	      x->Color = RED;
+	      MEMTRACE_SET(current->Right, x);
+	      MEMTRACE_SET(x->Parent, current);
+	      MEMTRACE_SET(x->Right, NULL);
+	      MEMTRACE_SET(x->Left, NULL);
+	      MEMTRACE_SET(x->Color, RED);
 	      return 1;
 	  }
       }
@@ -312,6 +322,8 @@ int tree_insert (Node* x) {
 void freetree_insert (void* ptr, size_t size) {
     Node* x;
     Node* y;
+    Node* p;   /* x's parent ... */
+    Node* g;   /* ... and grandparent */
 
     //Write the tags for the block
     setTags(ptr, size, IN_TREE);
@@ -327,75 +339,75 @@ void freetree_insert (void* ptr, size_t size) {
     /* Invariant: x is red, and red/black properties are every-  */
     /*            where satisfied, except maybe between x and    */
     //            x->Parent.                                     */
-    while ( (x->Parent != NULL)
-	    && (isRed(x->Parent))
-	    && (x->Parent->Parent != NULL)) {
-	if ( x->Parent == x->Parent->Parent->Left ) {
+    while ( ((p = MEMTRACE_GET(x->Parent)) != NULL)
+	    && (isRed(p))
+	    && ((g = MEMTRACE_GET(p->Parent)) != NULL)) {
+	if ( p == MEMTRACE_GET(g->Left) ) {
 	    /* If x's parent is a left, y is x's right 'uncle' */
-	    y = x->Parent->Parent->Right;
+	    y = MEMTRACE_GET(g->Right);
 	    if ( isRed(y) ) {
 		/* case 1 - change the colours */
-		setblack(x->Parent);  
+		setblack(p);  
 		setblack(y);
-		setred(x->Parent->Parent);
+		setred(g);
 		/* Move x up the tree */
-		x = x->Parent->Parent;
+		x = g;
 	    }
 	    else {
 		/* y is a black node */
-		if ( x == x->Parent->Right ) {
+		if ( x == MEMTRACE_GET(p->Right) ) {
 		    /* and x is to the right */ 
 		    /* double-rotate . . .  */
-		    left_rotate( x->Parent );
-		    right_rotate( x->Parent );
-		    setblack( x->Left );
+		    left_rotate( p );
+		    right_rotate( g );
+		    setblack( MEMTRACE_GET(x->Left) );
 		}
 		else
 		{
 		    /* single-rotate */
 		    setblack(x);
-		    x = x->Parent;
-		    right_rotate( x->Parent );
+		    x = p;
+		    right_rotate( g );
 		}
 	    }
 	}
 	else {
 	    /* If x's parent is a right, y is x's left 'uncle' */
-	    y = x->Parent->Parent->Left;
+	    y = MEMTRACE_GET(g->Left);
 	    if ( isRed(y) ) {
 		/* case 1 - change the colours */
-		setblack(x->Parent);
+		setblack(p);
 		setblack(y);
-		setred(x->Parent->Parent);
+		setred(g);
 		/* Move x up the tree */
-		x = x->Parent->Parent;
+		x = g;
 	    }
 	    else {
 		/* y is a black node */
-		if ( x == x->Parent->Left ) {
+		if ( x == MEMTRACE_GET(p->Left) ) {
 		    /* and x is to the left */
 		    /* double rotate */
-		    right_rotate( x->Parent );
-		    left_rotate( x->Parent );
-		    setblack(x->Right);
+		    right_rotate( p );
+		    left_rotate( g );
+		    setblack( MEMTRACE_GET(x->Right) );
 		}
 		else {
 		    /* single rotate */
 		    setblack(x);
-		    x = x->Parent;
-		    left_rotate( x->Parent );
+		    x = p;
+		    left_rotate( g );
 		}
 	    }
 	}
     }
     /* Colour the root black */
-    setblack(*treeroot);
+    setblack(MEMTRACE_GET(*treeroot));
 }
 
 
 Node* freetree_locate(int size) {
     Node* best = NULL;
-    Node* current = *treeroot;
+    Node* current = MEMTRACE_GET(*treeroot);
 
     //Find the smallest (with respect to tree-order) element
     //for which size <= Size(current), assuming that size-
@@ -403,23 +415,24 @@ Node* freetree_locate(int size) {
     while(current != NULL) {
 	if (size <= Size(current)) {
 	    best = current;
-	    current = current->Left;
+	    current = MEMTRACE_GET(current->Left);
 	}
 	else
-	    current = current->Right;
+	    current = MEMTRACE_GET(current->Right);
     }
     return best;
 }
 
 int freetree_locatemax()
 {
-    Node* n = *treeroot;
+    Node* n = MEMTRACE_GET(*treeroot);
+    Node* next;
     if (n == NULL)
 	return 0;
     else
     {
-	while (n->Right)
-	    n = n->Right;
+	while ((next = MEMTRACE_GET(n->Right)) != NULL)
+	    n = next;
     }
     return Size(n);
 }
@@ -430,214 +443,230 @@ void right_child_is2x(Node* x);
 
 //left child is a double-black node.  Fix it.
 void left_child_is2x(Node* x){
-    Node* sis = x->Right;
+    Node* sis = MEMTRACE_GET(x->Right);
+    Node* p;
 
-    if (sis->Color == RED)
+    if (MEMTRACE_GET(sis->Color) == RED)
     {
 	left_rotate(x);
-	x->Color = !(x->Color);
-	sis->Color = !(sis->Color);
-	sis = x->Right;
+	MEMTRACE_SET(x->Color, !MEMTRACE_GET(x->Color));
+	MEMTRACE_SET(sis->Color, !MEMTRACE_GET(sis->Color));
+	sis = MEMTRACE_GET(x->Right);
     }
 
     //Now sis is black.  Let's check its children.
-    if (isBlack(sis->Right) && isBlack(sis->Left))
+    if (isBlack(MEMTRACE_GET(sis->Right)) && isBlack(MEMTRACE_GET(sis->Left)))
     {
-	sis->Color = RED;
-	if (x->Color == RED)
+	MEMTRACE_SET(sis->Color, RED);
+	if (MEMTRACE_GET(x->Color) == RED)
 	{
-	    x->Color = BLACK;
+	    MEMTRACE_SET(x->Color, BLACK);
 	    return;  //done!
 	}
 	else
 	{
 	    //move violation up to parent, if any.
 	    //if node is root, it's already black, and we're done.
-	    if (x->Parent != NULL)
+	    if ((p = MEMTRACE_GET(x->Parent)) != NULL)
 	    {
-		if (x->Parent->Left == x)
-		    left_child_is2x(x->Parent);
+		if (MEMTRACE_GET(p->Left) == x)
+		    left_child_is2x(p);
 		else
-		    right_child_is2x(x->Parent);
+		    right_child_is2x(p);
 	    }
 	    return;
 	}
     }
 
-    if (isBlack(sis->Right))  //farther child is black
+    if (isBlack(MEMTRACE_GET(sis->Right)))  //farther child is black
     {
 	//make it so that the farther child is red
 	right_rotate(sis);
-	sis->Color = RED;   //used to be black, old sis
-	sis = x->Right;
-	sis->Color = BLACK;  //used to be red.  New sis
+	MEMTRACE_SET(sis->Color, RED);   //used to be black, old sis
+	sis = MEMTRACE_GET(x->Right);
+	MEMTRACE_SET(sis->Color, BLACK);  //used to be red.  New sis
     }
 
     //now we know that sis->Right is red. This is fixable.
     left_rotate(x);
-    sis->Color = x->Color;      //just to copy.
-    x->Color = BLACK;           //was indeterminate.
-    sis->Right->Color = BLACK;  //was red.
+    MEMTRACE_SET(sis->Color, MEMTRACE_GET(x->Color));  //just to copy.
+    MEMTRACE_SET(x->Color, BLACK);           //was indeterminate.
+    setblack(MEMTRACE_GET(sis->Right));      //was red.
     return;
 }
 
 
 void right_child_is2x(Node* x){
-    Node* sis = x->Left;
+    Node* sis = MEMTRACE_GET(x->Left);
+    Node* p;
 
-    if (sis->Color == RED)
+    if (MEMTRACE_GET(sis->Color) == RED)
     {
 	right_rotate(x);
-	x->Color = !(x->Color);
-	sis->Color = !(sis->Color);
-	sis = x->Left;
+	MEMTRACE_SET(x->Color, !MEMTRACE_GET(x->Color));
+	MEMTRACE_SET(sis->Color, !MEMTRACE_GET(sis->Color));
+	sis = MEMTRACE_GET(x->Left);
     }
 
     //Now sis is black.  Let's check its children.
-    if (isBlack(sis->Right) && isBlack(sis->Left))
+    if (isBlack(MEMTRACE_GET(sis->Right)) && isBlack(MEMTRACE_GET(sis->Left)))
     {
-	sis->Color = RED;
-	if (x->Color == RED)
+	MEMTRACE_SET(sis->Color, RED);
+	if (MEMTRACE_GET(x->Color) == RED)
 	{
-	    x->Color = BLACK;
+	    MEMTRACE_SET(x->Color, BLACK);
 	    return;  //done!
 	}
 	else
 	{
 	    //move violation up to parent, if any.
 	    //if node is root, it's already black, and we're done.
-	    if (x->Parent != NULL)
+	    if ((p = MEMTRACE_GET(x->Parent)) != NULL)
 	    {
-		if (x->Parent->Left == x)
-		    left_child_is2x(x->Parent);
+		if (MEMTRACE_GET(p->Left) == x)
+		    left_child_is2x(p);
 		else
-		    right_child_is2x(x->Parent);
+		    right_child_is2x(p);
 	    }
 	    return;
 	}
     }
 
-    if (isBlack(sis->Left))  //farther child is black
+    if (isBlack(MEMTRACE_GET(sis->Left)))  //farther child is black
     {
 	//make it so that the farther child is red
 	left_rotate(sis);
-	sis->Color = RED;   //used to be black, old sis
-	sis = x->Left;
-	sis->Color = BLACK;  //used to be red.  New sis
+	MEMTRACE_SET(sis->Color, RED);   //used to be black, old sis
+	sis = MEMTRACE_GET(x->Left);
+	MEMTRACE_SET(sis->Color, BLACK);  //used to be red.  New sis
     }
 
     //now we know that sis->Left is red. This is fixable.
     right_rotate(x);
-    sis->Color = x->Color;      //just to copy.
-    x->Color = BLACK;           //was indeterminate.
-    sis->Left->Color = BLACK;   //was red.
+    MEMTRACE_SET(sis->Color, MEMTRACE_GET(x->Color));  //just to copy.
+    MEMTRACE_SET(x->Color, BLACK);           //was indeterminate.
+    setblack(MEMTRACE_GET(sis->Left));       //was red.
     return;
 }
 
 void freetree_delete( Node* z ) {
-    
+    Node* left;
+    Node* right;
+    Node* parent;
+    Node* right_left;
+    int color;
+
     /*****************************
      *  delete node z from tree  *
      *****************************/
 
     if (z == NULL)
 	return;
+
+    left = MEMTRACE_GET(z->Left);
+    right = MEMTRACE_GET(z->Right);
+    parent = MEMTRACE_GET(z->Parent);
+    color = MEMTRACE_GET(z->Color);
     
-    if ((z->Left == NULL || z->Right == NULL) && z->Color == RED)
+    if ((left == NULL || right == NULL) && color == RED)
     {
-	Node* child = z->Left ? z->Left : z->Right;  //is black
+	Node* child = left ? left : right;  //is black
 
 	if (child)
-	    child->Parent = z->Parent;
+	    MEMTRACE_SET(child->Parent, parent);
 	
-	if (z->Parent == NULL)
-	    *treeroot = child;
-	else if (z->Parent->Left == z)
-	    z->Parent->Left = child;
+	if (parent == NULL)
+	    MEMTRACE_SET(*treeroot, child);
+	else if (MEMTRACE_GET(parent->Left) == z)
+	    MEMTRACE_SET(parent->Left, child);
 	else
-	    z->Parent->Right = child;
+	    MEMTRACE_SET(parent->Right, child);
 	return;
     }
-    else if ((z->Left == NULL || z->Right == NULL) && z->Color == BLACK)
+    else if ((left == NULL || right == NULL) && color == BLACK)
     {
-	Node* child = z->Left ? z->Left : z->Right;
+	Node* child = left ? left : right;
 	if (child)
-	    child->Parent = z->Parent;
+	    MEMTRACE_SET(child->Parent, parent);
 
-	if (z->Parent == NULL)
+	if (parent == NULL)
 	{
-	    *treeroot = child;
+	    MEMTRACE_SET(*treeroot, child);
 	    setblack(child);
 	    return;
 	}
-	else if (z->Parent->Left == z)
+	else if (MEMTRACE_GET(parent->Left) == z)
 	{
-	    z->Parent->Left = child;
-	    left_child_is2x(z->Parent);
+	    MEMTRACE_SET(parent->Left, child);
+	    left_child_is2x(parent);
 	    return;
 	}
 	else
 	{
-	    z->Parent->Right = child;
-	    right_child_is2x(z->Parent);
+	    MEMTRACE_SET(parent->Right, child);
+	    right_child_is2x(parent);
 	    return;
 	}
     }
-    else if (z->Right->Left == NULL && z->Right->Color == RED)
+    else if ((right_left = MEMTRACE_GET(right->Left)) == NULL &&
+	     MEMTRACE_GET(right->Color) == RED)
     {
 	//We know that z->Left is non-null
-	z->Right->Left = z->Left;
-	z->Left->Parent = z->Right;
-	z->Right->Parent = z->Parent;
-	z->Right->Color = BLACK;
-
-	if (z->Parent == NULL)
-	    *treeroot = z->Right;
-	else if (z->Parent->Left == z)
-	    z->Parent->Left = z->Right;
+	MEMTRACE_SET(right->Left, left);
+	MEMTRACE_SET(left->Parent, right);
+	MEMTRACE_SET(right->Parent, parent);
+	MEMTRACE_SET(right->Color, BLACK);
+
+	if (parent == NULL)
+	    MEMTRACE_SET(*treeroot, right);
+	else if (MEMTRACE_GET(parent->Left) == z)
+	    MEMTRACE_SET(parent->Left, right);
 	else
-	    z->Parent->Right = z->Right;
+	    MEMTRACE_SET(parent->Right, right);
 	return;
     }
-    else if (z->Right->Left == NULL && z->Right->Color == BLACK)
+    else if (right_left == NULL)  //and right is black
     {
-	z->Right->Left = z->Left;
-	z->Left->Parent = z->Right;
-	z->Right->Parent = z->Parent;
-	z->Right->Color = z->Color;
-
-	if (z->Parent == NULL)
-	    *treeroot = z->Right;
-	else if (z->Parent->Left == z)
-	    z->Parent->Left = z->Right;
+	MEMTRACE_SET(right->Left, left);
+	MEMTRACE_SET(left->Parent, right);
+	MEMTRACE_SET(right->Parent, parent);
+	MEMTRACE_SET(right->Color, color);
+
+	if (parent == NULL)
+	    MEMTRACE_SET(*treeroot, right);
+	else if (MEMTRACE_GET(parent->Left) == z)
+	    MEMTRACE_SET(parent->Left, right);
 	else
-	    z->Parent->Right = z->Right;
+	    MEMTRACE_SET(parent->Right, right);
 
-	right_child_is2x(z->Right);
+	right_child_is2x(right);
 	return;
     }
     else
     {
-	Node* y = z->Right->Left;
+	Node* y = right_left;
+	Node* next;
 	Node  y2;
-	while (y->Left)
-	    y = y->Left;
+	while ((next = MEMTRACE_GET(y->Left)) != NULL)
+	    y = next;
 
+	MEMTRACE_LOAD(y, sizeof(Node));
 	y2 = *y;
-	*y = *z;
-	if (z->Parent == NULL)
-	    *treeroot = y;
-	else if (z->Parent->Left == z)
-	    z->Parent->Left = y;
+	MEMTRACE_STORE(y, sizeof(Node));
+	*y = *z;   //z's fields are in left, right, parent, and color
+	if (parent == NULL)
+	    MEMTRACE_SET(*treeroot, y);
+	else if (MEMTRACE_GET(parent->Left) == z)
+	    MEMTRACE_SET(parent->Left, y);
 	else
-	    z->Parent->Right = y;
-	y->Left->Parent = y;
-	y->Right->Parent = y;
+	    MEMTRACE_SET(parent->Right, y);
+	MEMTRACE_SET(left->Parent, y);
+	MEMTRACE_SET(right->Parent, y);
 
 	//now y has replaced z.  Clean up y2, where y used to be.
-	y2.Parent->Left = y2.Right;
+	MEMTRACE_SET(y2.Parent->Left, y2.Right);
 	if (y2.Right)
-	    y2.Right->Parent = y2.Parent;
+	    MEMTRACE_SET(y2.Right->Parent, y2.Parent);
 	if (y2.Color == RED)
 	    return;
 	else
@@ -666,6 +695,7 @@ void freetree_delete( Node* z ) {
 
 
 
+
 
 
 /*
@@ -682,13 +712,15 @@ void delFromWherever (void *ptr)
     {
 	//The node is in the blob.  Remove it in O(1) time.
 	List* L = ptr;
+	List* next = MEMTRACE_GET(L->Next);
+	List* prev = MEMTRACE_GET(L->Prev);
 
-	if (L->Next != NULL)
-	    L->Next->Prev = L->Prev;
-	if (L->Prev)
-	    L->Prev->Next = L->Next;
+	if (next != NULL)
+	    MEMTRACE_SET(next->Prev, prev);
+	if (prev)
+	    MEMTRACE_SET(prev->Next, next);
 	else
-	    *blobroot = L->Next;
+	    MEMTRACE_SET(*blobroot, next);
     }
 }
 
@@ -697,27 +729,28 @@ void queueNewFreeBlock(void* ptr, int size)
 {
     //Mark and insert into the blob.
     List* L = ptr;
+    List* next = MEMTRACE_GET(*blobroot);
     
     setTags(ptr, size, IN_BLOB);
-    L->Prev = NULL;
-    L->Next = *blobroot;
-    if (L->Next)
-	L->Next->Prev = L;
-    *blobroot = L;
+    MEMTRACE_SET(L->Prev, NULL);
+    MEMTRACE_SET(L->Next, next);
+    if (next)
+	MEMTRACE_SET(next->Prev, L);
+    MEMTRACE_SET(*blobroot, L);
 }
 
 //takes all items from the blob and inserts into the freetree
 void emptyblob()
 {
     /*  Move all blob-blocks into the tree  */
-    List* N = *blobroot;
+    List* N = MEMTRACE_GET(*blobroot);
     while (N!=NULL)
     {
-        List* temp = N->Next;
+        List* temp = MEMTRACE_GET(N->Next);
         freetree_insert(N,Size(N));
         N = temp;
     }
-    *blobroot = NULL;
+    MEMTRACE_SET(*blobroot, NULL);
 }
 
 int mm_init (void)
@@ -828,7 +861,7 @@ void *mm_realloc(void *ptr,size_t size)
             //no more memory.  Request cannot be satisfied.
             return NULL;
         }
-        *boundtag_hi = 0;
+        MEMTRACE_SET(*boundtag_hi, 0);
 
 	setTags(ptr,Size(ptr)+grow_size,ALLOCATED);
 	return ptr;
@@ -877,7 +910,7 @@ void *mm_malloc (size_t size)
             //no more memory.  Request cannot be satisfied.
             return NULL;
         }
-        *boundtag_hi = 0; //*((int*)(mem_heap_hi()-3)) = NULL;     // removed int* cast VMF
+        MEMTRACE_SET(*boundtag_hi, 0); //*((int*)(mem_heap_hi()-3)) = NULL;     // removed int* cast VMF
         if (IsFree(PrevBlock(block)))
         {
             block = PrevBlock(block);
@@ -924,6 +957,22 @@ void *mm_malloc (size_t size)
     return block;
 }
 
+/*
+ * mm_save_state - The tree and the blob hang off mem_heap_lo(), so a checkpoint
+ *     saves nothing
+ */
+size_t mm_save_state(void *buf, size_t size)
+{
+    return 0;
+}
+
+/*
+ * mm_restore_state - Nothing to restore
+ */
+void mm_restore_state(const void *buf)
+{
+}
+
 
 
 
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include "mm.h"
 #include "memlib.h"
+#include "memtrace.h"
 
 /*
  * If NEXT_FIT defined use next fit search, else use first fit search 
@@ -59,8 +60,8 @@ team_t team = {
 #define PACK(size, alloc)  ((size) | (alloc))      
 
 /* Read and write a word at address p */
-#define GET(p)       (*(size_t *)(p))	//得到地址ｐ的数据
-#define PUT(p, val)  (*(size_t *)(p) = (val))  	//将地址ｐ中放入ｖａｌ
+#define GET(p)       (MEMTRACE_LOAD(p, sizeof(size_t)), *(size_t *)(p))	//得到地址ｐ的数据
+#define PUT(p, val)  (MEMTRACE_STORE(p, sizeof(size_t)), *(size_t *)(p) = (val))  	//将地址ｐ中放入ｖａｌ
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)	//消掉低三位
@@ -289,6 +290,86 @@ void mm_checkheap(int verbose)
 	printf("Bad epilogue header\n");
 }
 
+/*
+ * mm_save_state - Copy the heap pointers and the size class lists out
+ *     for a heap checkpoint. The list nodes are outside the heap, so
+ *     the state is the number of blocks in each class, then their block
+ *     pointers in list order.
+ */
+size_t mm_save_state(void *buf, size_t size)
+{
+    char *state[2];
+    size_t counts[SC_SIZE];
+    size_t total = 0, need;
+    void **bps;
+    struct node *p;
+    int i;
+
+    state[0] = heap_listp;
+#ifdef NEXT_FIT
+    state[1] = rover;
+#else
+    state[1] = NULL;
+#endif
+    for (i = 0; i < SC_SIZE; i++) {
+	counts[i] = 0;
+	for (p = sc[i]; p != 0; p = (*p).next)
+	    counts[i]++;
+	total += counts[i];
+    }
+    need = sizeof(state) + sizeof(counts) + total * sizeof(void *);
+    if (size < need)
+	return need;
+
+    memcpy(buf, state, sizeof(state));
+    memcpy((char *)buf + sizeof(state), counts, sizeof(counts));
+    bps = (void **)((char *)buf + sizeof(state) + sizeof(counts));
+    for (i = 0; i < SC_SIZE; i++)
+	for (p = sc[i]; p != 0; p = (*p).next)
+	    *bps++ = (*p).bp;
+    return need;
+}
+
+/*
+ * mm_restore_state - Copy back the heap pointers of a heap checkpoint,
+ *     and rebuild the size class lists from its block pointers
+ */
+void mm_restore_state(const void *buf)
+{
+    char *state[2];
+    size_t counts[SC_SIZE];
+    void * const *bps;
+    struct node *p, **tail;
+    size_t j;
+    int i;
+
+    memcpy(state, buf, sizeof(state));
+    memcpy(counts, (const char *)buf + sizeof(state), sizeof(counts));
+    bps = (void * const *)((const char *)buf + sizeof(state) +
+			   sizeof(counts));
+    heap_listp = state[0];
+#ifdef NEXT_FIT
+    rover = state[1];
+#endif
+    for (i = 0; i < SC_SIZE; i++) {
+	while ((p = sc[i]) != 0) {
+	    sc[i] = (*p).next;
+	    free(p);
+	}
+	tail = &sc[i];
+	for (j = 0; j < counts[i]; j++) {
+	    if ((p = (struct node *)malloc(sizeof(struct node))) == NULL) {
+		printf("ERROR: out of memory in mm_restore_state\n");
+		exit(1);
+	    }
+	    (*p).bp = *bps++;
+	    (*p).next = 0;
+	    *tail = p;
+	    tail = &(*p).next;
+	}
+    }
+}
+
 /* The remaining routines are internal helper routines */
 
 /* 
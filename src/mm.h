@@ -5,6 +5,19 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/*
+ * Optional, for the driver's heap checkpoints (mdriver -C, -R, -s, and
+ * -e), which refuse an allocator without them: the allocator copies
+ * the state it keeps outside the heap (in static variables) out and
+ * back in. mm_save_state returns the size of the state, and copies it
+ * to buf if it fits in size bytes; an allocator that keeps all of its
+ * state in the heap returns 0, and its mm_restore_state does nothing.
+ * After mm_restore_state, the allocator must work without another
+ * mm_init, since -R starts from a checkpoint in a new process.
+ */
+extern size_t mm_save_state(void *buf, size_t size) __attribute__((weak));
+extern void mm_restore_state(const void *buf) __attribute__((weak));
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include "mm.h"
 #include "memlib.h"
+#include "memtrace.h"
 
 /*
  * If NEXT_FIT defined use next fit search, else use first fit search 
@@ -59,8 +60,8 @@ team_t team = {
 #define PACK(size, alloc)  ((size) | (alloc))
 
 /* Read and write a word at address p */
-#define GET(p)       (*(size_t *)(p))
-#define PUT(p, val)  (*(size_t *)(p) = (val))  
+#define GET(p)       (MEMTRACE_LOAD(p, sizeof(size_t)), *(size_t *)(p))
+#define PUT(p, val)  (MEMTRACE_STORE(p, sizeof(size_t)), *(size_t *)(p) = (val))  
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
@@ -211,6 +212,38 @@ void mm_checkheap(int verbose)
 	printf("Bad epilogue header\n");
 }
 
+/*
+ * mm_save_state - Copy the heap pointers out for a heap checkpoint
+ */
+size_t mm_save_state(void *buf, size_t size)
+{
+    char *state[2];
+
+    state[0] = heap_listp;
+#ifdef NEXT_FIT
+    state[1] = rover;
+#else
+    state[1] = NULL;
+#endif
+    if (size >= sizeof(state))
+	memcpy(buf, state, sizeof(state));
+    return sizeof(state);
+}
+
+/*
+ * mm_restore_state - Copy back the heap pointers of a heap checkpoint
+ */
+void mm_restore_state(const void *buf)
+{
+    char *state[2];
+
+    memcpy(state, buf, sizeof(state));
+    heap_listp = state[0];
+#ifdef NEXT_FIT
+    rover = state[1];
+#endif
+}
+
 /* The remaining routines are internal helper routines */
 
 /* 
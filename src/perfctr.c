@@ -0,0 +1,119 @@
+/*
+ * perfctr.c - Hardware event counters
+ *
+ * Counts hardware events such as cache misses over a region of code,
+ * using the Linux perf_event interface. A counter is the file
+ * descriptor returned by perf_event_open. Only user-level events of
+ * the calling thread are counted, which is allowed at the default
+ * perf_event_paranoid level. Where perf_event is missing or not
+ * permitted, perfctr_open returns -1 and callers report the events
+ * as unknown.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "perfctr.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* perf_event config for each PERFCTR_ event */
+static unsigned long long configs[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+#define NEVENTS (sizeof(configs) / sizeof(configs[0]))
+
+/*
+ * perfctr_open - Open a disabled counter for event in this thread
+ */
+int perfctr_open(int event)
+{
+    struct perf_event_attr attr;
+
+    if (event < 0 || event >= (int)NEVENTS)
+	return -1;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[event];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * perfctr_start - Zero the counter and start counting
+ */
+void perfctr_start(int ctr)
+{
+    if (ctr < 0)
+	return;
+    ioctl(ctr, PERF_EVENT_IOC_RESET, 0);
+    ioctl(ctr, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+/*
+ * perfctr_stop - Stop counting and return the count since perfctr_start
+ */
+double perfctr_stop(int ctr)
+{
+    unsigned long long count;
+
+    if (ctr < 0)
+	return -1;
+    ioctl(ctr, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(ctr, &count, sizeof(count)) != sizeof(count))
+	return -1;
+    return (double)count;
+}
+
+/*
+ * perfctr_close - Release the counter
+ */
+void perfctr_close(int ctr)
+{
+    if (ctr >= 0)
+	close(ctr);
+}
+
+#else /* no perf_event: no counters */
+
+int perfctr_open(int event)
+{
+    return -1;
+}
+
+void perfctr_start(int ctr)
+{
+}
+
+double perfctr_stop(int ctr)
+{
+    return -1;
+}
+
+void perfctr_close(int ctr)
+{
+}
+
+#endif /* __linux__ */
+
+/*
+ * perfctr_name - The name of an event
+ */
+const char *perfctr_name(int event)
+{
+    static const char *names[] = {
+	"cycles", "instructions", "cache-references", "cache-misses"
+    };
+
+    if (event < 0 || event >= (int)(sizeof(names) / sizeof(names[0])))
+	return "unknown";
+    return names[event];
+}
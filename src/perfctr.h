@@ -0,0 +1,28 @@
+/*
+ * perfctr.h - Hardware event counters (Linux perf_event)
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+/* Events that can be counted */
+#define PERFCTR_CYCLES       0 /* CPU cycles */
+#define PERFCTR_INSTRUCTIONS 1 /* retired instructions */
+#define PERFCTR_CACHE_REFS   2 /* last-level cache references */
+#define PERFCTR_CACHE_MISSES 3 /* last-level cache misses */
+
+/* Open a counter for event in this thread, or return -1 if unavailable */
+int perfctr_open(int event);
+
+/* Zero the counter and start counting */
+void perfctr_start(int ctr);
+
+/* Stop counting and return the count since perfctr_start (<0: error) */
+double perfctr_stop(int ctr);
+
+/* Release the counter */
+void perfctr_close(int ctr);
+
+/* The name of an event */
+const char *perfctr_name(int event);
+
+#endif /* __PERFCTR_H_ */
@@ -0,0 +1,449 @@
+/*
+ * profile.c - A sampling profiler for the timed replays
+ *
+ * While the profiler runs, SIGPROF interrupts the calling thread every
+ * 1/hz seconds of CPU time (ITIMER_PROF), and the handler walks the
+ * chain of saved frame pointers from the interrupted context, recording
+ * the return addresses in a static buffer. Samples that land while
+ * profile_armed is clear are ignored, and the walk stops at the frame
+ * of the caller of profile_start, so only the frames of the replay are
+ * kept. The code must be compiled with -fno-omit-frame-pointer (as in
+ * "make mdriver-prof") for the walk to find the callers; without it, a
+ * sample still has its innermost function. Even so, gcc sets up no
+ * frame in functions that call nothing, so a sample in such a leaf
+ * skips the leaf's caller.
+ *
+ * Nothing is symbolized while sampling. profile_write maps the
+ * addresses to function names by reading the symbol tables of the
+ * program and its shared libraries from their ELF files, which finds
+ * static functions too as long as the files are not stripped.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "profile.h"
+
+#if defined(__linux__) && (defined(__i386__) || defined(__x86_64__))
+#include <ucontext.h>
+#include <link.h>
+#include <elf.h>
+
+#define PROFILE_BUFWORDS (1<<18) /* words of samples kept */
+#define PROFILE_MAXDEPTH 64      /* frames kept per sample */
+#define PROFILE_MAXOBJS  64      /* shared objects that are symbolized */
+
+/* A function in the symbol table of a shared object */
+typedef struct {
+    unsigned long addr;     /* address, relative to the object's base */
+    unsigned long size;     /* bytes of code (0: unknown) */
+    const char *name;
+} sym_t;
+
+/* The program or one of its shared libraries */
+typedef struct {
+    char *path;             /* ELF file */
+    char *label;            /* "[file]", for code without a symbol */
+    unsigned long bias;     /* load address of the object */
+    unsigned long lo, hi;   /* the addresses it occupies */
+    int loaded;             /* have its symbols been read? */
+    sym_t *syms;            /* its functions, by address */
+    int nsyms;
+    char *strs;             /* their names */
+} object_t;
+
+/********************
+ * Global variables
+ *******************/
+volatile int profile_armed = 0;
+
+/* The samples: each is a depth followed by that many return addresses,
+   innermost first. Written by the signal handler only. */
+static void *samples[PROFILE_BUFWORDS];
+static volatile int used = 0;       /* words of samples used */
+static volatile int nsamples = 0;   /* samples kept */
+static volatile int ndropped = 0;   /* samples dropped for lack of room */
+static char *stack_base = NULL;     /* don't unwind past this frame */
+static int running = 0;
+static struct sigaction old_action;
+
+static object_t objects[PROFILE_MAXOBJS];
+static int nobjects = -1;           /* -1: not looked up yet */
+
+/*********************
+ * Function prototypes
+ *********************/
+static void sample(int sig, siginfo_t *info, void *context);
+static const char *symbolize(void *pc);
+static int add_object(struct dl_phdr_info *info, size_t size, void *data);
+static void load_symbols(object_t *obj);
+static int compare_syms(const void *a, const void *b);
+static int compare_strs(const void *a, const void *b);
+
+/*
+ * profile_available - The profiler works on Linux on x86
+ */
+int profile_available(void)
+{
+    return 1;
+}
+
+/*
+ * profile_reset - Forget the samples taken so far
+ */
+void profile_reset(void)
+{
+    used = 0;
+    nsamples = 0;
+    ndropped = 0;
+}
+
+/*
+ * profile_start - Install the SIGPROF handler and start the timer
+ */
+int profile_start(int hz, void *base)
+{
+    struct sigaction action;
+    struct itimerval timer;
+
+    if (running || hz <= 0)
+	return -1;
+    stack_base = (char *)base;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = sample;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &old_action) < 0)
+	return -1;
+
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = (hz > 1000000) ? 1 : 1000000 / hz;
+    if (hz == 1) {
+	timer.it_interval.tv_sec = 1;
+	timer.it_interval.tv_usec = 0;
+    }
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) < 0) {
+	sigaction(SIGPROF, &old_action, NULL);
+	return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+/*
+ * profile_stop - Stop the timer and restore the old SIGPROF handler
+ */
+void profile_stop(void)
+{
+    struct itimerval timer;
+
+    if (!running)
+	return;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &old_action, NULL);
+    running = 0;
+}
+
+/*
+ * profile_samples - The number of samples kept and dropped
+ */
+int profile_samples(int *dropped)
+{
+    if (dropped)
+	*dropped = ndropped;
+    return nsamples;
+}
+
+/*
+ * profile_write - Write the samples as folded stacks. Every sample
+ *     becomes a string of function names, and equal strings are
+ *     counted after sorting them.
+ */
+int profile_write(FILE *fp, const char *root)
+{
+    char **stacks, *s;
+    int i, j, k, depth, len, count;
+
+    if (nsamples == 0)
+	return 0;
+    if ((stacks = (char **)calloc(nsamples, sizeof(char *))) == NULL)
+	return -1;
+
+    for (i = 0, k = 0; i < nsamples; i++) {
+	depth = (int)(long)samples[k];
+
+	/* Callers first; a return address is one past its call */
+	len = strlen(root) + 1;
+	for (j = depth; j > 0; j--)
+	    len += strlen(symbolize((char *)samples[k+j] - (j > 1))) + 1;
+	if ((s = stacks[i] = (char *)malloc(len)) == NULL)
+	    break;
+	strcpy(s, root);
+	for (j = depth; j > 0; j--) {
+	    strcat(s, ";");
+	    strcat(s, symbolize((char *)samples[k+j] - (j > 1)));
+	}
+	k += 1 + depth;
+    }
+
+    if (i == nsamples) {
+	qsort(stacks, nsamples, sizeof(char *), compare_strs);
+	for (i = 0; i < nsamples; i += count) {
+	    for (count = 1; i + count < nsamples; count++)
+		if (strcmp(stacks[i], stacks[i + count]))
+		    break;
+	    fprintf(fp, "%s %d\n", stacks[i], count);
+	}
+    }
+    for (j = 0; j < nsamples && stacks[j]; j++)
+	free(stacks[j]);
+    free(stacks);
+    return (i == nsamples) ? nsamples : -1;
+}
+
+/*
+ * sample - The SIGPROF handler: record the interrupted pc and the
+ *     return addresses of the frames between it and stack_base. A frame
+ *     pointer is trusted only while it is aligned and lies between this
+ *     handler's frame and stack_base, moving toward stack_base.
+ */
+static void sample(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    void **fp, **next;
+    int start = used, depth = 0;
+
+    if (!profile_armed)
+	return;
+    if (start + 1 + PROFILE_MAXDEPTH > PROFILE_BUFWORDS) {
+	ndropped++;
+	return;
+    }
+#if defined(__x86_64__)
+    samples[start + 1 + depth++] = (void *)uc->uc_mcontext.gregs[REG_RIP];
+    fp = (void **)uc->uc_mcontext.gregs[REG_RBP];
+#else
+    samples[start + 1 + depth++] = (void *)uc->uc_mcontext.gregs[REG_EIP];
+    fp = (void **)uc->uc_mcontext.gregs[REG_EBP];
+#endif
+
+    while (depth < PROFILE_MAXDEPTH &&
+	   (char *)fp > (char *)&next && (char *)fp < stack_base &&
+	   ((unsigned long)fp & (sizeof(void *) - 1)) == 0) {
+	samples[start + 1 + depth++] = fp[1];
+	next = (void **)fp[0];
+	if (next <= fp)
+	    break;
+	fp = next;
+    }
+    samples[start] = (void *)(long)depth;
+    used = start + 1 + depth;
+    nsamples++;
+}
+
+/*
+ * symbolize - The name of the function that contains pc, or the name
+ *     of the object in brackets if it has no symbol for pc
+ */
+static const char *symbolize(void *pc)
+{
+    unsigned long addr = (unsigned long)pc;
+    object_t *obj;
+    int i, lo, hi, mid;
+
+    if (nobjects < 0) {
+	nobjects = 0;
+	dl_iterate_phdr(add_object, NULL);
+    }
+    for (i = 0; i < nobjects; i++)
+	if (addr >= objects[i].lo && addr < objects[i].hi)
+	    break;
+    if (i == nobjects)
+	return "[unknown]";
+    obj = &objects[i];
+    if (!obj->loaded)
+	load_symbols(obj);
+
+    /* The last function that starts at or below addr */
+    addr -= obj->bias;
+    lo = 0;
+    hi = obj->nsyms - 1;
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (obj->syms[mid].addr <= addr)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    if (hi < 0 || (obj->syms[hi].size &&
+		   addr >= obj->syms[hi].addr + obj->syms[hi].size))
+	return obj->label;
+    return obj->syms[hi].name;
+}
+
+/*
+ * add_object - dl_iterate_phdr callback: record where an object is
+ *     mapped. The program itself comes first, with an empty name.
+ */
+static int add_object(struct dl_phdr_info *info, size_t size, void *data)
+{
+    object_t *obj;
+    unsigned long lo = ~0UL, hi = 0, end;
+    const char *name = info->dlpi_name;
+    int i;
+
+    if (nobjects == PROFILE_MAXOBJS)
+	return 1;
+    for (i = 0; i < info->dlpi_phnum; i++) {
+	if (info->dlpi_phdr[i].p_type != PT_LOAD)
+	    continue;
+	if (info->dlpi_addr + info->dlpi_phdr[i].p_vaddr < lo)
+	    lo = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+	end = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr +
+	    info->dlpi_phdr[i].p_memsz;
+	if (end > hi)
+	    hi = end;
+    }
+    if (hi == 0)
+	return 0;
+
+    obj = &objects[nobjects++];
+    memset(obj, 0, sizeof(*obj));
+    obj->path = strdup((name && *name) ? name : "/proc/self/exe");
+    if (obj->path == NULL ||
+	(obj->label = (char *)malloc(strlen(obj->path) + 3)) == NULL) {
+	nobjects--;
+	return 0;
+    }
+    sprintf(obj->label, "[%s]", strrchr(obj->path, '/') ?
+	    strrchr(obj->path, '/') + 1 : obj->path);
+    obj->bias = info->dlpi_addr;
+    obj->lo = lo;
+    obj->hi = hi;
+    return 0;
+}
+
+/*
+ * load_symbols - Read the functions of obj from the symbol table of its
+ *     ELF file (or its dynamic symbol table, if it is stripped). On any
+ *     failure, obj simply has no symbols.
+ */
+static void load_symbols(object_t *obj)
+{
+    ElfW(Ehdr) ehdr;
+    ElfW(Shdr) *shdrs = NULL, *symtab = NULL, *strtab;
+    ElfW(Sym) *syms = NULL;
+    FILE *fp;
+    int i, n;
+
+    obj->loaded = 1;
+    if ((fp = fopen(obj->path, "rb")) == NULL)
+	return;
+    if (fread(&ehdr, sizeof(ehdr), 1, fp) != 1 ||
+	memcmp(ehdr.e_ident, ELFMAG, SELFMAG) ||
+	ehdr.e_shentsize != sizeof(ElfW(Shdr)) || ehdr.e_shnum == 0)
+	goto done;
+
+    /* The section headers, to find the symbol table and its names */
+    if ((shdrs = (ElfW(Shdr) *)calloc(ehdr.e_shnum, sizeof(ElfW(Shdr)))) == NULL ||
+	fseek(fp, ehdr.e_shoff, SEEK_SET) < 0 ||
+	fread(shdrs, sizeof(ElfW(Shdr)), ehdr.e_shnum, fp) != ehdr.e_shnum)
+	goto done;
+    for (i = 0; i < ehdr.e_shnum; i++)
+	if (shdrs[i].sh_type == SHT_SYMTAB)
+	    symtab = &shdrs[i];
+    for (i = 0; symtab == NULL && i < ehdr.e_shnum; i++)
+	if (shdrs[i].sh_type == SHT_DYNSYM)
+	    symtab = &shdrs[i];
+    if (symtab == NULL || symtab->sh_link >= ehdr.e_shnum)
+	goto done;
+    strtab = &shdrs[symtab->sh_link];
+
+    n = symtab->sh_size / sizeof(ElfW(Sym));
+    if ((syms = (ElfW(Sym) *)malloc(symtab->sh_size)) == NULL ||
+	(obj->strs = (char *)malloc(strtab->sh_size + 1)) == NULL ||
+	(obj->syms = (sym_t *)calloc(n, sizeof(sym_t))) == NULL ||
+	fseek(fp, symtab->sh_offset, SEEK_SET) < 0 ||
+	fread(syms, sizeof(ElfW(Sym)), n, fp) != (size_t)n ||
+	fseek(fp, strtab->sh_offset, SEEK_SET) < 0 ||
+	fread(obj->strs, 1, strtab->sh_size, fp) != strtab->sh_size)
+	goto done;
+    obj->strs[strtab->sh_size] = '\0';
+
+    for (i = 0; i < n; i++) {
+	if (ELF64_ST_TYPE(syms[i].st_info) != STT_FUNC ||
+	    syms[i].st_value == 0 || syms[i].st_name >= strtab->sh_size)
+	    continue;
+	obj->syms[obj->nsyms].addr = syms[i].st_value;
+	obj->syms[obj->nsyms].size = syms[i].st_size;
+	obj->syms[obj->nsyms].name = obj->strs + syms[i].st_name;
+	obj->nsyms++;
+    }
+    qsort(obj->syms, obj->nsyms, sizeof(sym_t), compare_syms);
+
+ done:
+    free(shdrs);
+    free(syms);
+    fclose(fp);
+}
+
+/*
+ * compare_syms - qsort comparison of functions by address
+ */
+static int compare_syms(const void *a, const void *b)
+{
+    unsigned long x = ((const sym_t *)a)->addr;
+    unsigned long y = ((const sym_t *)b)->addr;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * compare_strs - qsort comparison of stacks
+ */
+static int compare_strs(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+#else /* !__linux__ on x86 */
+
+volatile int profile_armed = 0;
+
+int profile_available(void)
+{
+    return 0;
+}
+
+void profile_reset(void)
+{
+}
+
+int profile_start(int hz, void *base)
+{
+    return -1;
+}
+
+void profile_stop(void)
+{
+}
+
+int profile_samples(int *dropped)
+{
+    if (dropped)
+	*dropped = 0;
+    return 0;
+}
+
+int profile_write(FILE *fp, const char *root)
+{
+    return -1;
+}
+
+#endif /* __linux__ on x86 */
@@ -0,0 +1,35 @@
+/*
+ * profile.h - A sampling profiler for the timed replays
+ */
+#ifndef __PROFILE_H_
+#define __PROFILE_H_
+
+#include <stdio.h>
+
+/* Samples are only kept while this is set, so that the timing
+   harness around the code of interest stays out of the profile */
+extern volatile int profile_armed;
+
+/* Can this platform sample and unwind the stack? */
+int profile_available(void);
+
+/* Forget the samples taken so far */
+void profile_reset(void);
+
+/* Start sampling the calling thread hz times per CPU second. Stacks
+   are unwound up to, but not including, the frame at base. Returns -1
+   if the profiler is not available or already running. */
+int profile_start(int hz, void *base);
+
+/* Stop sampling; the samples are kept until the next reset */
+void profile_stop(void);
+
+/* The number of samples kept, and of those dropped for lack of room */
+int profile_samples(int *dropped);
+
+/* Write the samples to fp as folded stacks, one line per distinct
+   stack: "root;outermost;...;innermost count". Returns the number of
+   samples, or -1 on failure. */
+int profile_write(FILE *fp, const char *root);
+
+#endif /* __PROFILE_H_ */
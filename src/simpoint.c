@@ -0,0 +1,166 @@
+/*
+ * simpoint.c - Clustering the windows of a trace (after SimPoint)
+ *
+ * SimPoint picks a few representative intervals of a long program run
+ * by clustering the intervals on what they execute. Here the points
+ * are the feature vectors of the windows of a trace, and the clusters
+ * come from k-means: k-means++ seeding with a fixed seed, then Lloyd
+ * iterations until no point changes clusters.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "simpoint.h"
+
+#define MAX_ITERS 100  /* Lloyd iterations if the clusters don't settle */
+#define SEED        1  /* of the k-means++ seeding */
+
+static double dist2(const double *a, const double *b, int dim);
+static int nearest(const double *p, const double *centers, int k, int dim);
+
+/*
+ * simpoint_cluster - Cluster n points with k-means and pick the points
+ *     closest to the center of each cluster
+ */
+int simpoint_cluster(const double *x, int n, int dim, int k, int nreps,
+		     int *cluster, int *reps)
+{
+    double *centers, *sums, *d2, *repd, sum, r, d;
+    int *count, *renum;
+    int i, j, c, nc, iter, changed;
+    unsigned int seed = SEED;
+
+    if (n <= 0 || k <= 0)
+	return 0;
+    if (k > n)
+	k = n;
+    centers = malloc(k * dim * sizeof(double));
+    sums = malloc(k * dim * sizeof(double));
+    d2 = malloc(n * sizeof(double));
+    repd = malloc(k * nreps * sizeof(double));
+    count = malloc(k * sizeof(int));
+    renum = malloc(k * sizeof(int));
+    if (!centers || !sums || !d2 || !repd || !count || !renum) {
+	free(centers); free(sums); free(d2); free(repd);
+	free(count); free(renum);
+	return -1;
+    }
+
+    /*
+     * k-means++: the first center is the first point, and each next one
+     * a point picked with a probability proportional to its squared
+     * distance from the nearest center so far
+     */
+    memcpy(centers, x, dim * sizeof(double));
+    for (i = 0; i < n; i++)
+	d2[i] = dist2(&x[i*dim], centers, dim);
+    for (nc = 1; nc < k; nc++) {
+	for (sum = 0, i = 0; i < n; i++)
+	    sum += d2[i];
+	if (sum <= 0) /* every point is on a center already */
+	    break;
+	seed = seed * 1103515245 + 12345;
+	r = sum * ((seed >> 8) & 0xffffff) / (double)0x1000000;
+	for (j = -1, i = 0; i < n; i++)
+	    if (d2[i] > 0) {
+		j = i;
+		if ((r -= d2[i]) < 0)
+		    break;
+	    }
+	memcpy(&centers[nc*dim], &x[j*dim], dim * sizeof(double));
+	for (i = 0; i < n; i++)
+	    if ((d = dist2(&x[i*dim], &centers[nc*dim], dim)) < d2[i])
+		d2[i] = d;
+    }
+    k = nc;
+
+    /* Lloyd: assign every point to its nearest center, move the centers
+       to the means of their points, and repeat */
+    for (i = 0; i < n; i++)
+	cluster[i] = -1;
+    for (iter = 0; iter < MAX_ITERS; iter++) {
+	changed = 0;
+	for (i = 0; i < n; i++)
+	    if ((c = nearest(&x[i*dim], centers, k, dim)) != cluster[i]) {
+		cluster[i] = c;
+		changed = 1;
+	    }
+	if (!changed)
+	    break;
+	memset(sums, 0, k * dim * sizeof(double));
+	memset(count, 0, k * sizeof(int));
+	for (i = 0; i < n; i++) {
+	    count[cluster[i]]++;
+	    for (j = 0; j < dim; j++)
+		sums[cluster[i]*dim + j] += x[i*dim + j];
+	}
+	for (c = 0; c < k; c++) /* an empty cluster keeps its center */
+	    for (j = 0; j < dim && count[c] > 0; j++)
+		centers[c*dim + j] = sums[c*dim + j] / count[c];
+    }
+
+    /* Number the clusters that have points from 0, in order */
+    memset(count, 0, k * sizeof(int));
+    for (i = 0; i < n; i++)
+	count[cluster[i]]++;
+    for (nc = 0, c = 0; c < k; c++)
+	renum[c] = (count[c] > 0) ? nc++ : -1;
+
+    /* The points closest to each center, closest first */
+    for (i = 0; i < nc * nreps; i++) {
+	reps[i] = -1;
+	repd[i] = 0;
+    }
+    for (i = 0; i < n; i++) {
+	d = dist2(&x[i*dim], &centers[cluster[i]*dim], dim);
+	c = renum[cluster[i]];
+	for (j = nreps-1; j >= 0; j--) {
+	    if (reps[c*nreps + j] >= 0 && repd[c*nreps + j] <= d)
+		break;
+	    if (j < nreps-1) {
+		reps[c*nreps + j+1] = reps[c*nreps + j];
+		repd[c*nreps + j+1] = repd[c*nreps + j];
+	    }
+	}
+	if (j < nreps-1) {
+	    reps[c*nreps + j+1] = i;
+	    repd[c*nreps + j+1] = d;
+	}
+	cluster[i] = c;
+    }
+
+    free(centers); free(sums); free(d2); free(repd);
+    free(count); free(renum);
+    return nc;
+}
+
+/*
+ * dist2 - The squared distance between two points
+ */
+static double dist2(const double *a, const double *b, int dim)
+{
+    double d, sum = 0;
+    int j;
+
+    for (j = 0; j < dim; j++) {
+	d = a[j] - b[j];
+	sum += d * d;
+    }
+    return sum;
+}
+
+/*
+ * nearest - The center nearest to point p
+ */
+static int nearest(const double *p, const double *centers, int k, int dim)
+{
+    double d, best = 0;
+    int c, which = 0;
+
+    for (c = 0; c < k; c++)
+	if ((d = dist2(p, &centers[c*dim], dim)) < best || c == 0) {
+	    best = d;
+	    which = c;
+	}
+    return which;
+}
@@ -0,0 +1,20 @@
+/*
+ * simpoint.h - Clustering the windows of a trace (after SimPoint)
+ */
+#ifndef __SIMPOINT_H_
+#define __SIMPOINT_H_
+
+/*
+ * Cluster the n points of x (dim doubles each, one point after the
+ * other) into at most k clusters with k-means. The seeding is
+ * deterministic, so the same points always give the same clusters.
+ * cluster[i] gets the cluster of point i, and reps[c*nreps + j] the
+ * point that is j-th closest to the center of cluster c (or -1 if the
+ * cluster has no more points). Returns the number of clusters, which
+ * is less than k if there are fewer distinct points, or -1 if out of
+ * memory.
+ */
+int simpoint_cluster(const double *x, int n, int dim, int k, int nreps,
+		     int *cluster, int *reps);
+
+#endif /* __SIMPOINT_H_ */
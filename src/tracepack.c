@@ -0,0 +1,139 @@
+/*
+ * tracepack.c - Convert traces between the ASCII and binary formats
+ *
+ * By default a trace is written in the other format than the one it is
+ * read in: .rep files are packed into the compressed binary format, and
+ * binary traces are unpacked into .rep files that mdriver, checktrace,
+ * and a text editor all understand. The output of a round trip is the
+ * original trace, except for blank lines and spacing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tracestream.h"
+
+/*********************
+ * Function prototypes
+ *********************/
+static long long file_size(char *path);
+static void usage(void);
+static void app_error(char *msg);
+
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    tracestream_t in, out;
+    trace_req_t req;
+    int format = -1;   /* output format: 0 ASCII, 1 binary, -1 the other */
+    int verbose = 0;
+    long long insize, outsize;
+    int rc;
+    char c;
+
+    while ((c = getopt(argc, argv, "abvh")) != EOF) {
+        switch (c) {
+	case 'a': /* Write an ASCII trace */
+	    format = 0;
+	    break;
+	case 'b': /* Write a binary trace */
+	    format = 1;
+	    break;
+	case 'v': /* Report the sizes of the files */
+	    verbose = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (argc - optind != 2) {
+	usage();
+	exit(1);
+    }
+
+    if (trace_open(&in, argv[optind]) < 0)
+	app_error(in.errmsg);
+    if (format < 0)
+	format = !in.binary;
+
+    out.sugg_heapsize = in.sugg_heapsize;
+    out.num_ids = in.num_ids;
+    out.num_ops = in.num_ops;
+    out.weight = in.weight;
+    if (trace_create(&out, argv[optind+1], format) < 0)
+	app_error(out.errmsg);
+
+    while ((rc = trace_next(&in, &req)) > 0)
+	if (trace_write(&out, &req) < 0)
+	    app_error(out.errmsg);
+    if (rc < 0)
+	app_error(in.errmsg);
+    if (trace_finish(&out) < 0)
+	app_error(out.errmsg);
+
+    if (in.opnum != in.num_ops)
+	fprintf(stderr, "tracepack: warning: header of %s says %d requests, "
+		"but it has %lld\n", argv[optind], in.num_ops, in.opnum);
+    trace_close(&in);
+
+    if (verbose) {
+	insize = file_size(argv[optind]);
+	outsize = file_size(argv[optind+1]);
+	if (insize > 0 && outsize > 0)
+	    fprintf(stderr, "%s: %lld requests, %lld -> %lld bytes "
+		    "(%.2f bytes/request, %.1fx)\n", argv[optind+1], 
+		    out.opnum, insize, outsize, 
+		    out.opnum ? (double)outsize/out.opnum : 0.0, 
+		    (double)insize/outsize);
+    }
+    exit(0);
+}
+
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/*
+ * file_size - The size of the regular file path, or -1 if unknown
+ */
+static long long file_size(char *path)
+{
+    struct stat sb;
+
+    if (stat(path, &sb) < 0 || !S_ISREG(sb.st_mode))
+	return -1;
+    return sb.st_size;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracepack [-h] [-a | -b] [-v] <in> <out>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-a  Write an ASCII trace.\n");
+    fprintf(stderr, "\t-b  Write a binary trace.\n");
+    fprintf(stderr, "\t-h  Print this message.\n");
+    fprintf(stderr, "\t-v  Report the sizes of the files.\n");
+    fprintf(stderr, "Without -a or -b, <out> is in the format <in> is not.\n");
+    fprintf(stderr, "A file of \"-\" is stdin or stdout.\n");
+}
+
+/*
+ * app_error - Report an error and terminate
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "tracepack: %s\n", msg);
+    exit(1);
+}
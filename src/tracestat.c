@@ -0,0 +1,518 @@
+/*
+ * tracestat.c - Characterize the workload of trace files
+ *
+ * Reads each trace in a single streaming pass and reports the shape of
+ * its workload: the request size histogram and the most common sizes,
+ * object lifetimes (in requests), peak live bytes and blocks, realloc
+ * chains and growth factors, how often blocks are freed in LIFO or
+ * FIFO order, and the best space utilization any allocator could reach
+ * on it. Memory use grows with the number of ids and distinct sizes,
+ * not with the length of the trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "tracestream.h"
+#include "config.h"
+
+/**********************
+ * Constants and macros
+ **********************/
+#define NBUCKETS     40 /* log2 buckets of the histograms */
+#define DEFAULT_TOP  10 /* most common sizes shown */
+#define TAG_BYTES     8 /* header and footer of a boundary-tag allocator */
+#define NIL          -1 /* end of the live list */
+
+/* rounds up to the nearest multiple of ALIGNMENT */
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
+
+/* Realloc growth factor classes */
+#define NGROWTH 6
+static char *growth_names[NGROWTH] = {
+    "shrink", "same", "<1.5x", "<2x", "<4x", ">=4x"
+};
+
+/******************************
+ * The key compound data types
+ *****************************/
+
+/* What we know about the block of one id */
+typedef struct {
+    unsigned size;      /* payload size */
+    int live;           /* allocated and not yet freed? */
+    long long birth;    /* request number of its malloc */
+    int reallocs;       /* reallocs since its malloc */
+    int prev, next;     /* neighbors in the live list */
+} block_t;
+
+/* Number of requests of one size */
+typedef struct {
+    unsigned size;
+    long long count;
+} sizecount_t;
+
+/* The statistics of one trace */
+typedef struct {
+    long long reqs[3];               /* by TRACE_ request type */
+    long long bad;                   /* skipped: inconsistent, or id too big */
+    long long sizes[NBUCKETS];       /* request sizes, by log2 */
+    double size_total;
+    unsigned size_max;
+    long long lifetimes[NBUCKETS];   /* requests from malloc to free */
+    double lifetime_total;
+    long long never_freed;
+    long long chains[NBUCKETS];      /* reallocs per block, if any */
+    long long growth[NGROWTH];       /* realloc growth factors */
+    double log_growth;               /* sum of log(new/old) */
+    long long lifo, fifo;            /* frees of the newest/oldest block */
+    double live_bytes, live_aligned, live_tagged;
+    long long live_blocks;
+    double peak_bytes, peak_aligned, peak_tagged;
+    long long peak_blocks, peak_at;
+} tracestat_t;
+
+/********************
+ * Global variables
+ *******************/
+static block_t *blocks = NULL;  /* indexed by id, grown as needed */
+static size_t num_blocks = 0;
+static int head, tail;          /* oldest and newest live blocks */
+static sizecount_t *table = NULL; /* hash table of request sizes */
+static int table_size = 0, table_used = 0;
+static int top = DEFAULT_TOP;   /* most common sizes shown (set by -n) */
+
+/*********************
+ * Function prototypes
+ *********************/
+static int analyze(char *path, tracestat_t *st);
+static void request(tracestat_t *st, trace_req_t *req, long long opnum);
+static void live_insert(unsigned id);
+static void live_remove(unsigned id);
+static void count_size(unsigned size);
+static void end_chain(tracestat_t *st, block_t *b);
+static int bucket(double x);
+static void print_stats(char *path, tracestream_t *ts, tracestat_t *st);
+static void print_histogram(char *title, long long *hist, long long n);
+static int cmp_count(const void *a, const void *b);
+static void usage(void);
+static void unix_error(char *msg);
+
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    tracestat_t st;
+    int i, errors = 0;
+    char c;
+
+    while ((c = getopt(argc, argv, "n:h")) != EOF) {
+        switch (c) {
+	case 'n': /* Number of most common sizes to show */
+	    top = atoi(optarg);
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (optind == argc) {
+	usage();
+	exit(1);
+    }
+
+    for (i = optind; i < argc; i++) {
+	if (analyze(argv[i], &st) < 0)
+	    errors++;
+	else if (i+1 < argc)
+	    printf("\n");
+    }
+    exit(errors ? 1 : 0);
+}
+
+
+/*
+ * analyze - Read the trace at path and print its statistics
+ */
+static int analyze(char *path, tracestat_t *st)
+{
+    tracestream_t ts;
+    trace_req_t req;
+    long long opnum = 0;
+    size_t id;
+    int i, rc;
+
+    if (trace_open(&ts, path) < 0) {
+	fprintf(stderr, "tracestat: %s\n", ts.errmsg);
+	return -1;
+    }
+
+    memset(st, 0, sizeof(tracestat_t));
+    for (id = 0; id < num_blocks; id++)
+	blocks[id].live = 0;
+    head = tail = NIL;
+    table_used = 0;
+    for (i = 0; i < table_size; i++)
+	table[i].count = 0;
+
+    while ((rc = trace_next(&ts, &req)) > 0)
+	request(st, &req, opnum++);
+    if (rc < 0) {
+	fprintf(stderr, "tracestat: %s: %s\n", path, ts.errmsg);
+	trace_close(&ts);
+	return -1;
+    }
+
+    /* The blocks that are still live end their realloc chains now */
+    for (i = head; i != NIL; i = blocks[i].next) {
+	st->never_freed++;
+	end_chain(st, &blocks[i]);
+    }
+
+    print_stats(path, &ts, st);
+    trace_close(&ts);
+    return 0;
+}
+
+/*
+ * request - Account for one request of the trace
+ */
+static void request(tracestat_t *st, trace_req_t *req, long long opnum)
+{
+    unsigned id = req->index;
+    block_t *b;
+    double old;
+
+    /* Ids must fit the int links of the live list (and the table) */
+    if (id > INT_MAX || id >= SIZE_MAX / sizeof(block_t)) {
+	st->bad++;
+	return;
+    }
+
+    /* Grow the block table to cover id, without overflowing its size */
+    if (id >= num_blocks) {
+	size_t n = (num_blocks > 0) ? num_blocks : 1024;
+	while (n <= id)
+	    n = (n <= SIZE_MAX / sizeof(block_t) / 2) ?
+		2 * n : SIZE_MAX / sizeof(block_t);
+	if ((blocks = realloc(blocks, n * sizeof(block_t))) == NULL)
+	    unix_error("realloc of the block table failed");
+	memset(blocks + num_blocks, 0, (n - num_blocks) * sizeof(block_t));
+	num_blocks = n;
+    }
+    b = &blocks[id];
+
+    /* Requests that don't fit the state of their block are skipped */
+    if ((req->type == TRACE_ALLOC && b->live) ||
+	(req->type != TRACE_ALLOC && !b->live)) {
+	st->bad++;
+	return;
+    }
+    st->reqs[req->type]++;
+
+    switch (req->type) {
+    case TRACE_ALLOC:
+	b->live = 1;
+	b->size = req->size;
+	b->birth = opnum;
+	b->reallocs = 0;
+	live_insert(id);
+	st->live_blocks++;
+	st->live_bytes += req->size;
+	st->live_aligned += ALIGN(req->size);
+	st->live_tagged += ALIGN(req->size + TAG_BYTES);
+	break;
+
+    case TRACE_REALLOC:
+	old = b->size;
+	if (req->size < old)
+	    st->growth[0]++;
+	else if (req->size == old)
+	    st->growth[1]++;
+	else if (req->size < 1.5*old)
+	    st->growth[2]++;
+	else if (req->size < 2*old)
+	    st->growth[3]++;
+	else if (req->size < 4*old)
+	    st->growth[4]++;
+	else
+	    st->growth[5]++;
+	if (old > 0 && req->size > 0)
+	    st->log_growth += log(req->size / old);
+	b->reallocs++;
+	st->live_bytes += (double)req->size - old;
+	st->live_aligned += (double)ALIGN(req->size) - ALIGN(b->size);
+	st->live_tagged += (double)ALIGN(req->size + TAG_BYTES) - 
+	    ALIGN(b->size + TAG_BYTES);
+	b->size = req->size;
+	break;
+
+    default: /* TRACE_FREE */
+	if (id == (unsigned)tail)
+	    st->lifo++;
+	if (id == (unsigned)head)
+	    st->fifo++;
+	live_remove(id);
+	b->live = 0;
+	st->lifetimes[bucket(opnum - b->birth)]++;
+	st->lifetime_total += opnum - b->birth;
+	end_chain(st, b);
+	st->live_blocks--;
+	st->live_bytes -= b->size;
+	st->live_aligned -= ALIGN(b->size);
+	st->live_tagged -= ALIGN(b->size + TAG_BYTES);
+	return;
+    }
+
+    /* malloc and realloc requests */
+    count_size(req->size);
+    st->sizes[bucket(req->size)]++;
+    st->size_total += req->size;
+    if (req->size > st->size_max)
+	st->size_max = req->size;
+
+    if (st->live_bytes > st->peak_bytes) {
+	st->peak_bytes = st->live_bytes;
+	st->peak_at = opnum;
+    }
+    if (st->live_aligned > st->peak_aligned)
+	st->peak_aligned = st->live_aligned;
+    if (st->live_tagged > st->peak_tagged)
+	st->peak_tagged = st->live_tagged;
+    if (st->live_blocks > st->peak_blocks)
+	st->peak_blocks = st->live_blocks;
+}
+
+/*
+ * live_insert - Append block id to the live list, which keeps the live
+ *     blocks in allocation order
+ */
+static void live_insert(unsigned id)
+{
+    blocks[id].prev = tail;
+    blocks[id].next = NIL;
+    if (tail != NIL)
+	blocks[tail].next = id;
+    else
+	head = id;
+    tail = id;
+}
+
+/*
+ * live_remove - Unlink block id from the live list
+ */
+static void live_remove(unsigned id)
+{
+    block_t *b = &blocks[id];
+
+    if (b->prev != NIL)
+	blocks[b->prev].next = b->next;
+    else
+	head = b->next;
+    if (b->next != NIL)
+	blocks[b->next].prev = b->prev;
+    else
+	tail = b->prev;
+}
+
+/*
+ * count_size - Count one more request of size bytes in the hash table
+ *     of sizes (open addressing, kept at most half full)
+ */
+static void count_size(unsigned size)
+{
+    sizecount_t *old;
+    int old_size, i, h;
+
+    if (2*(table_used+1) > table_size) {
+	old = table;
+	old_size = table_size;
+	table_size = (table_size > 0) ? 2*table_size : 1024;
+	if ((table = calloc(table_size, sizeof(sizecount_t))) == NULL)
+	    unix_error("calloc of the size table failed");
+	table_used = 0;
+	for (i = 0; i < old_size; i++) {
+	    if (old[i].count == 0)
+		continue;
+	    h = (old[i].size * 2654435761u) & (table_size-1);
+	    while (table[h].count != 0)
+		h = (h+1) & (table_size-1);
+	    table[h] = old[i];
+	    table_used++;
+	}
+	free(old);
+    }
+
+    h = (size * 2654435761u) & (table_size-1);
+    while (table[h].count != 0 && table[h].size != size)
+	h = (h+1) & (table_size-1);
+    if (table[h].count == 0) {
+	table[h].size = size;
+	table_used++;
+    }
+    table[h].count++;
+}
+
+/*
+ * end_chain - Account for the realloc chain of block b, which is freed
+ *     or still live at the end of the trace
+ */
+static void end_chain(tracestat_t *st, block_t *b)
+{
+    if (b->reallocs > 0)
+	st->chains[bucket(b->reallocs)]++;
+}
+
+/*
+ * bucket - The log2 histogram bucket of x: 0 for x < 2, else floor(log2 x)
+ */
+static int bucket(double x)
+{
+    int i = 0;
+
+    while (x >= 2 && i < NBUCKETS-1) {
+	x /= 2;
+	i++;
+    }
+    return i;
+}
+
+/*
+ * print_stats - Print the statistics of the trace at path
+ */
+static void print_stats(char *path, tracestream_t *ts, tracestat_t *st)
+{
+    long long allocs = st->reqs[TRACE_ALLOC] + st->reqs[TRACE_REALLOC];
+    long long frees = st->reqs[TRACE_FREE];
+    long long reallocs = st->reqs[TRACE_REALLOC];
+    sizecount_t *sorted;
+    int i, n;
+
+    printf("%s: %lld requests (header: %d), %d ids, weight %d\n",
+	   path, ts->opnum, ts->num_ops, ts->num_ids, ts->weight);
+    printf("  malloc %lld, free %lld, realloc %lld", 
+	   st->reqs[TRACE_ALLOC], frees, reallocs);
+    if (st->bad)
+	printf(", %lld inconsistent requests skipped", st->bad);
+    printf("\n");
+
+    /* Sizes */
+    if (allocs > 0)
+	printf("  sizes: mean %.1f, max %u bytes, %d distinct\n",
+	       st->size_total/allocs, st->size_max, table_used);
+    print_histogram("size (bytes)", st->sizes, allocs);
+    if (table_used > 0 && top > 0) {
+	if ((sorted = malloc(table_used * sizeof(sizecount_t))) == NULL)
+	    unix_error("malloc of the sorted sizes failed");
+	for (i = 0, n = 0; i < table_size; i++)
+	    if (table[i].count != 0)
+		sorted[n++] = table[i];
+	qsort(sorted, n, sizeof(sizecount_t), cmp_count);
+	printf("  %-14s%12s%8s\n", "top sizes", "requests", "share");
+	for (i = 0; i < n && i < top; i++)
+	    printf("  %-14u%12lld%7.1f%%\n", sorted[i].size, sorted[i].count,
+		   100.0*sorted[i].count/allocs);
+	free(sorted);
+    }
+
+    /* Lifetimes */
+    if (frees > 0)
+	printf("  lifetimes: mean %.1f requests, %lld blocks never freed\n",
+	       st->lifetime_total/frees, st->never_freed);
+    print_histogram("lifetime (reqs)", st->lifetimes, frees);
+
+    /* Live data */
+    printf("  peak live: %.0f bytes (at request %lld), %lld blocks\n",
+	   st->peak_bytes, st->peak_at, st->peak_blocks);
+
+    /* Realloc chains */
+    if (reallocs > 0) {
+	printf("  realloc growth: geometric mean %.2fx\n", 
+	       exp(st->log_growth/reallocs));
+	printf("  %-14s%12s%8s\n", "growth", "reallocs", "share");
+	for (i = 0; i < NGROWTH; i++)
+	    printf("  %-14s%12lld%7.1f%%\n", growth_names[i], st->growth[i],
+		   100.0*st->growth[i]/reallocs);
+	for (i = 0, n = 0; i < NBUCKETS; i++)
+	    n += st->chains[i];
+	print_histogram("realloc chain", st->chains, n);
+    }
+
+    /* Free order */
+    if (frees > 0)
+	printf("  free order: LIFO %.1f%%, FIFO %.1f%% of frees\n",
+	       100.0*st->lifo/frees, 100.0*st->fifo/frees);
+
+    /* The best utilization an allocator could reach */
+    if (st->peak_aligned > 0)
+	printf("  util bound: %.1f%% (%d-byte alignment), "
+	       "%.1f%% (with %d-byte tags)\n",
+	       100.0*st->peak_bytes/st->peak_aligned, ALIGNMENT,
+	       100.0*st->peak_bytes/st->peak_tagged, TAG_BYTES);
+}
+
+/*
+ * print_histogram - Print the nonempty buckets of a log2 histogram
+ *     with n entries in all
+ */
+static void print_histogram(char *title, long long *hist, long long n)
+{
+    char range[TRACE_MAXLINE];
+    int i;
+
+    if (n <= 0)
+	return;
+    printf("  %-14s%12s%8s\n", title, "count", "share");
+    for (i = 0; i < NBUCKETS; i++) {
+	if (hist[i] == 0)
+	    continue;
+	if (i == 0)
+	    sprintf(range, "0-1");
+	else
+	    sprintf(range, "%.0f-%.0f", pow(2, i), pow(2, i+1) - 1);
+	printf("  %-14s%12lld%7.1f%%\n", range, hist[i], 100.0*hist[i]/n);
+    }
+}
+
+/*
+ * cmp_count - qsort comparison: more requests first, then smaller size
+ */
+static int cmp_count(const void *a, const void *b)
+{
+    const sizecount_t *x = a, *y = b;
+
+    if (x->count != y->count)
+	return (x->count > y->count) ? -1 : 1;
+    return (x->size < y->size) ? -1 : (x->size > y->size);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracestat [-h] [-n <sizes>] <tracefile>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-n <sizes>  Show the <sizes> most common sizes (default %d).\n",
+	    DEFAULT_TOP);
+    fprintf(stderr, "A <tracefile> of \"-\" is read from stdin.\n");
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    perror(msg);
+    exit(1);
+}
@@ -0,0 +1,555 @@
+/*
+ * tracestream.c - Read and write trace files one request at a time
+ *
+ * ASCII traces (.rep) have a four-line header (suggested heap size,
+ * number of ids, number of requests, weight) followed by one request
+ * per line: "a <id> <bytes>", "r <id> <bytes>", or "f <id>". Blank
+ * lines are skipped.
+ *
+ * Binary traces hold the same information in a few bytes per request.
+ * All numbers are varints (7 bits per byte, low bits first, the high
+ * bit set on all but the last byte):
+ *
+ *     magic      the 8 bytes "\211MTRACE\n"
+ *     version    1
+ *     header     sugg_heapsize, num_ids, num_ops, weight
+ *     blocks     <n> <bytes> followed by <bytes> bytes of n requests;
+ *                a block with n = 0 ends the trace
+ *
+ * A request is ((zigzag(id - previous id) << 2) | type), and for
+ * mallocs and reallocs a size code: k > 0 for the k-th entry of the
+ * size dictionary, or 0 followed by the size itself, which then
+ * becomes the next dictionary entry (until the dictionary is full).
+ * Consecutive requests tend to use nearby ids and a few distinct
+ * sizes, so most requests take 2 or 3 bytes. The blocks bound the
+ * memory of the decoder, which reads a whole block with one fread.
+ *
+ * The readers check the syntax of the trace only; whether the requests
+ * are consistent with each other and with the header is up to the
+ * caller.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "tracestream.h"
+
+#define MAGIC       "\211MTRACE\n" /* first 8 bytes of binary traces */
+#define MAGICLEN    8
+#define VERSION     1
+#define BLOCK_REQS  4096        /* requests per block written */
+#define MAX_BLOCK   (1<<24)     /* max bytes of a block read */
+#define DICT_MAX    (1<<16)     /* max entries of the size dictionary */
+#define HASH_SIZE   (2*DICT_MAX)/* slots of the dictionary hash table */
+
+/* hash table slot of a size */
+#define HASH(size)  (((size) * 2654435761u) & (HASH_SIZE-1))
+
+/* private functions */
+static int read_line(tracestream_t *ts, char *line);
+static int read_header(tracestream_t *ts, const char *path);
+static int next_text(tracestream_t *ts, trace_req_t *req);
+static int next_binary(tracestream_t *ts, trace_req_t *req);
+static int read_block(tracestream_t *ts);
+static int read_varint(FILE *fp, unsigned long long *v);
+static int get_varint(tracestream_t *ts, unsigned long long *v);
+static void write_varint(FILE *fp, unsigned long long v);
+static int put_varint(tracestream_t *ts, unsigned long long v);
+static int flush_block(tracestream_t *ts);
+static void free_state(tracestream_t *ts);
+
+/*
+ * trace_open - Open the trace file path ("-" is stdin) and read its
+ *     header. Returns -1 (with ts->errmsg set) on failure.
+ */
+int trace_open(tracestream_t *ts, const char *path)
+{
+    memset(ts, 0, sizeof(tracestream_t));
+    if (!strcmp(path, "-"))
+	ts->fp = stdin;
+    else if ((ts->fp = fopen(path, "rb")) == NULL) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, "Could not open %.900s: %s",
+		 path, strerror(errno));
+	return -1;
+    }
+    if (read_header(ts, path) < 0) {
+	trace_close(ts);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * trace_next - Read the next request into req. Returns 1 if there was
+ *     one, 0 at the end of the trace, and -1 (with ts->errmsg set) if
+ *     the trace is malformed.
+ */
+int trace_next(tracestream_t *ts, trace_req_t *req)
+{
+    int rc = ts->binary ? next_binary(ts, req) : next_text(ts, req);
+
+    if (rc > 0)
+	ts->opnum++;
+    return rc;
+}
+
+/*
+ * trace_close - Close a trace that was opened for reading
+ */
+void trace_close(tracestream_t *ts)
+{
+    if (ts->fp && ts->fp != stdin)
+	fclose(ts->fp);
+    ts->fp = NULL;
+    free_state(ts);
+}
+
+/*
+ * trace_create - Create the trace file path ("-" is stdout), in the
+ *     binary format if binary is set, and write the header that the
+ *     caller filled into ts. Returns -1 (with ts->errmsg set) on
+ *     failure.
+ */
+int trace_create(tracestream_t *ts, const char *path, int binary)
+{
+    int sugg_heapsize = ts->sugg_heapsize, num_ids = ts->num_ids;
+    int num_ops = ts->num_ops, weight = ts->weight;
+
+    memset(ts, 0, sizeof(tracestream_t));
+    ts->sugg_heapsize = sugg_heapsize;
+    ts->num_ids = num_ids;
+    ts->num_ops = num_ops;
+    ts->weight = weight;
+    ts->binary = binary;
+
+    if (!strcmp(path, "-"))
+	ts->fp = stdout;
+    else if ((ts->fp = fopen(path, "wb")) == NULL) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, "Could not create %.900s: %s",
+		 path, strerror(errno));
+	return -1;
+    }
+
+    if (!binary) {
+	fprintf(ts->fp, "%d\n%d\n%d\n%d\n", sugg_heapsize, num_ids, 
+		num_ops, weight);
+	return 0;
+    }
+    ts->dict = (unsigned *)malloc(DICT_MAX * sizeof(unsigned));
+    ts->hash = (unsigned *)calloc(HASH_SIZE, sizeof(unsigned));
+    if (!ts->dict || !ts->hash) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, "Out of memory in trace_create");
+	trace_finish(ts);
+	return -1;
+    }
+    fwrite(MAGIC, 1, MAGICLEN, ts->fp);
+    write_varint(ts->fp, VERSION);
+    write_varint(ts->fp, (unsigned)sugg_heapsize);
+    write_varint(ts->fp, (unsigned)num_ids);
+    write_varint(ts->fp, (unsigned)num_ops);
+    write_varint(ts->fp, (unsigned)weight);
+    return 0;
+}
+
+/*
+ * trace_write - Append the request req to a created trace. Returns -1
+ *     (with ts->errmsg set) on failure.
+ */
+int trace_write(tracestream_t *ts, trace_req_t *req)
+{
+    long long delta;
+    unsigned h, code;
+
+    ts->opnum++;
+    if (!ts->binary) {
+	if (req->type == TRACE_FREE)
+	    fprintf(ts->fp, "f %u\n", req->index);
+	else
+	    fprintf(ts->fp, "%c %u %u\n", 
+		    (req->type == TRACE_ALLOC) ? 'a' : 'r', 
+		    req->index, req->size);
+	return 0;
+    }
+
+    /* The id as a zigzag-coded delta, and the type */
+    delta = (long long)req->index - ts->prev;
+    ts->prev = req->index;
+    if (put_varint(ts, ((delta < 0) ? ((unsigned long long)(-delta) << 1) - 1
+			: (unsigned long long)delta << 1) << 2 | req->type) < 0)
+	return -1;
+
+    /* The size, from the dictionary if possible */
+    if (req->type != TRACE_FREE) {
+	for (h = HASH(req->size); ts->hash[h] != 0; h = (h+1) & (HASH_SIZE-1))
+	    if (ts->dict[ts->hash[h]-1] == req->size)
+		break;
+	code = ts->hash[h];
+	if (code == 0 && ts->dictlen < DICT_MAX) {
+	    ts->dict[ts->dictlen++] = req->size;
+	    ts->hash[h] = ts->dictlen;
+	}
+	if (put_varint(ts, code) < 0 ||
+	    (code == 0 && put_varint(ts, req->size) < 0))
+	    return -1;
+    }
+
+    if (++ts->blockreqs == BLOCK_REQS)
+	return flush_block(ts);
+    return 0;
+}
+
+/*
+ * trace_finish - Write the end of a created trace and close it. Returns
+ *     -1 (with ts->errmsg set) if the trace couldn't be written.
+ */
+int trace_finish(tracestream_t *ts)
+{
+    int rc = 0;
+
+    if (ts->fp == NULL)
+	return -1;
+    if (ts->binary) {
+	if (ts->blockreqs > 0 && flush_block(ts) < 0)
+	    rc = -1;
+	write_varint(ts->fp, 0);
+    }
+    if (ferror(ts->fp) || 
+	(ts->fp == stdout ? fflush(ts->fp) : fclose(ts->fp)) == EOF) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, "Write error: %s", 
+		 strerror(errno));
+	rc = -1;
+    }
+    ts->fp = NULL;
+    free_state(ts);
+    return rc;
+}
+
+/*****************
+ * Reading traces
+ *****************/
+
+/*
+ * read_header - Tell the format of the trace from its first byte and
+ *     read its header
+ */
+static int read_header(tracestream_t *ts, const char *path)
+{
+    char line[TRACE_MAXLINE];
+    unsigned char magic[MAGICLEN];
+    unsigned long long v[5];
+    int *header[4];
+    int i, c;
+
+    header[0] = &ts->sugg_heapsize;
+    header[1] = &ts->num_ids;
+    header[2] = &ts->num_ops;
+    header[3] = &ts->weight;
+
+    if ((c = getc(ts->fp)) == (unsigned char)MAGIC[0]) {
+	ts->binary = 1;
+	magic[0] = c;
+	if (fread(magic+1, 1, MAGICLEN-1, ts->fp) != MAGICLEN-1 ||
+	    memcmp(magic, MAGIC, MAGICLEN)) {
+	    snprintf(ts->errmsg, TRACE_MAXLINE, 
+		     "%.900s is not a trace file", path);
+	    return -1;
+	}
+	for (i = 0; i < 5; i++) {
+	    if (read_varint(ts->fp, &v[i]) < 0) {
+		snprintf(ts->errmsg, TRACE_MAXLINE, "Bad header in %.900s", 
+			 path);
+		return -1;
+	    }
+	}
+	if (v[0] != VERSION) {
+	    snprintf(ts->errmsg, TRACE_MAXLINE, 
+		     "%.900s has unknown format version %llu", path, v[0]);
+	    return -1;
+	}
+	for (i = 0; i < 4; i++)
+	    *header[i] = (int)v[i+1];
+	if ((ts->dict = (unsigned *)malloc(DICT_MAX * sizeof(unsigned))) 
+	    == NULL) {
+	    snprintf(ts->errmsg, TRACE_MAXLINE, "Out of memory in trace_open");
+	    return -1;
+	}
+	return 0;
+    }
+
+    if (c != EOF)
+	ungetc(c, ts->fp);
+    for (i = 0; i < 4; i++) {
+	if (read_line(ts, line) <= 0 || sscanf(line, "%d", header[i]) != 1) {
+	    snprintf(ts->errmsg, TRACE_MAXLINE, "Bad header in %.900s", path);
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/*
+ * next_text - Read the next request of an ASCII trace
+ */
+static int next_text(tracestream_t *ts, trace_req_t *req)
+{
+    char line[TRACE_MAXLINE];
+    char *p, *end;
+    int rc;
+
+    /* Skip blank lines */
+    do {
+	if ((rc = read_line(ts, line)) <= 0)
+	    return rc;
+	for (p = line; *p == ' ' || *p == '\t'; p++)
+	    ;
+    } while (*p == '\n' || *p == '\r' || *p == '\0');
+
+    switch (*p) {
+    case 'a':
+	req->type = TRACE_ALLOC;
+	break;
+    case 'r':
+	req->type = TRACE_REALLOC;
+	break;
+    case 'f':
+	req->type = TRACE_FREE;
+	break;
+    default:
+	snprintf(ts->errmsg, TRACE_MAXLINE, 
+		 "Bogus type character (%c) on line %lld", *p, ts->linenum);
+	return -1;
+    }
+
+    p++;
+    req->index = strtoul(p, &end, 10);
+    if (end == p)
+	goto bad;
+    req->size = 0;
+    if (req->type != TRACE_FREE) {
+	p = end;
+	req->size = strtoul(p, &end, 10);
+	if (end == p)
+	    goto bad;
+    }
+    return 1;
+
+ bad:
+    snprintf(ts->errmsg, TRACE_MAXLINE, "Malformed request on line %lld",
+	     ts->linenum);
+    return -1;
+}
+
+/*
+ * read_line - Read the next line of an ASCII trace into line. Returns
+ *     1 if there was one, 0 at the end of the file, -1 on error.
+ */
+static int read_line(tracestream_t *ts, char *line)
+{
+    if (fgets(line, TRACE_MAXLINE, ts->fp) == NULL) {
+	if (ferror(ts->fp)) {
+	    snprintf(ts->errmsg, TRACE_MAXLINE, "Read error after line %lld: %s",
+		     ts->linenum, strerror(errno));
+	    return -1;
+	}
+	return 0;
+    }
+    ts->linenum++;
+    return 1;
+}
+
+/*
+ * next_binary - Decode the next request of a binary trace
+ */
+static int next_binary(tracestream_t *ts, trace_req_t *req)
+{
+    unsigned long long tag, zz, code, size;
+
+    while (ts->blockreqs == 0) {
+	if (ts->done)
+	    return 0;
+	if (read_block(ts) < 0)
+	    return -1;
+    }
+
+    if (get_varint(ts, &tag) < 0)
+	goto bad;
+    req->type = tag & 0x3;
+    zz = tag >> 2;
+    ts->prev += (zz & 1) ? -(long long)((zz + 1) >> 1) : (long long)(zz >> 1);
+    req->index = ts->prev;
+    req->size = 0;
+    if (req->type > TRACE_REALLOC)
+	goto bad;
+
+    if (req->type != TRACE_FREE) {
+	if (get_varint(ts, &code) < 0)
+	    goto bad;
+	if (code > 0) {
+	    if (code > (unsigned long long)ts->dictlen)
+		goto bad;
+	    size = ts->dict[code-1];
+	}
+	else {
+	    if (get_varint(ts, &size) < 0)
+		goto bad;
+	    if (ts->dictlen < DICT_MAX)
+		ts->dict[ts->dictlen++] = size;
+	}
+	req->size = size;
+    }
+    ts->blockreqs--;
+    return 1;
+
+ bad:
+    snprintf(ts->errmsg, TRACE_MAXLINE, "Corrupt request %lld", ts->opnum);
+    return -1;
+}
+
+/*
+ * read_block - Read the next block of a binary trace into the buffer
+ */
+static int read_block(tracestream_t *ts)
+{
+    unsigned long long n, bytes;
+
+    if (read_varint(ts->fp, &n) < 0 ||
+	(n > 0 && read_varint(ts->fp, &bytes) < 0)) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, 
+		 "Truncated trace after request %lld", ts->opnum);
+	return -1;
+    }
+    if (n == 0) {
+	ts->done = 1;
+	return 0;
+    }
+    if (bytes > MAX_BLOCK) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, 
+		 "Corrupt block after request %lld", ts->opnum);
+	return -1;
+    }
+    if (bytes > ts->bufsize) {
+	free(ts->buf);
+	if ((ts->buf = (unsigned char *)malloc(bytes)) == NULL) {
+	    ts->bufsize = 0;
+	    snprintf(ts->errmsg, TRACE_MAXLINE, "Out of memory in trace_next");
+	    return -1;
+	}
+	ts->bufsize = bytes;
+    }
+    if (fread(ts->buf, 1, bytes, ts->fp) != bytes) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, 
+		 "Truncated trace after request %lld", ts->opnum);
+	return -1;
+    }
+    ts->buflen = bytes;
+    ts->bufpos = 0;
+    ts->blockreqs = n;
+    return 0;
+}
+
+/*
+ * read_varint - Read a varint from fp
+ */
+static int read_varint(FILE *fp, unsigned long long *v)
+{
+    int c, shift = 0;
+
+    *v = 0;
+    do {
+	if ((c = getc(fp)) == EOF || shift > 63)
+	    return -1;
+	*v |= (unsigned long long)(c & 0x7f) << shift;
+	shift += 7;
+    } while (c & 0x80);
+    return 0;
+}
+
+/*
+ * get_varint - Decode a varint from the current block
+ */
+static int get_varint(tracestream_t *ts, unsigned long long *v)
+{
+    unsigned char c;
+    int shift = 0;
+
+    *v = 0;
+    do {
+	if (ts->bufpos >= ts->buflen || shift > 63)
+	    return -1;
+	c = ts->buf[ts->bufpos++];
+	*v |= (unsigned long long)(c & 0x7f) << shift;
+	shift += 7;
+    } while (c & 0x80);
+    return 0;
+}
+
+/*****************
+ * Writing traces
+ *****************/
+
+/*
+ * write_varint - Write a varint to fp
+ */
+static void write_varint(FILE *fp, unsigned long long v)
+{
+    while (v >= 0x80) {
+	putc((v & 0x7f) | 0x80, fp);
+	v >>= 7;
+    }
+    putc(v, fp);
+}
+
+/*
+ * put_varint - Encode a varint into the current block
+ */
+static int put_varint(tracestream_t *ts, unsigned long long v)
+{
+    unsigned char *buf;
+    size_t size;
+
+    if (ts->buflen + 10 > ts->bufsize) {
+	size = (ts->bufsize > 0) ? 2*ts->bufsize : 16*BLOCK_REQS;
+	if ((buf = (unsigned char *)realloc(ts->buf, size)) == NULL) {
+	    snprintf(ts->errmsg, TRACE_MAXLINE, "Out of memory in trace_write");
+	    return -1;
+	}
+	ts->buf = buf;
+	ts->bufsize = size;
+    }
+    while (v >= 0x80) {
+	ts->buf[ts->buflen++] = (v & 0x7f) | 0x80;
+	v >>= 7;
+    }
+    ts->buf[ts->buflen++] = v;
+    return 0;
+}
+
+/*
+ * flush_block - Write the requests of the current block
+ */
+static int flush_block(tracestream_t *ts)
+{
+    write_varint(ts->fp, ts->blockreqs);
+    write_varint(ts->fp, ts->buflen);
+    if (fwrite(ts->buf, 1, ts->buflen, ts->fp) != ts->buflen) {
+	snprintf(ts->errmsg, TRACE_MAXLINE, "Write error: %s", 
+		 strerror(errno));
+	return -1;
+    }
+    ts->buflen = 0;
+    ts->blockreqs = 0;
+    return 0;
+}
+
+/*
+ * free_state - Free the buffers of the binary format
+ */
+static void free_state(tracestream_t *ts)
+{
+    free(ts->buf);
+    free(ts->dict);
+    free(ts->hash);
+    ts->buf = NULL;
+    ts->dict = NULL;
+    ts->hash = NULL;
+}
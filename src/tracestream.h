@@ -0,0 +1,74 @@
+/*
+ * tracestream.h - Read and write trace files one request at a time
+ *
+ * The trace tools and the evaluation library read traces through this
+ * interface, so they never need a whole trace file in memory. Traces
+ * are either the ASCII .rep files or the compressed binary format
+ * described in tracestream.c; trace_open tells them apart by their
+ * first byte.
+ */
+#ifndef __TRACESTREAM_H_
+#define __TRACESTREAM_H_
+
+#include <stdio.h>
+
+#define TRACE_MAXLINE 1024 /* max string size */
+
+/* Request types */
+#define TRACE_ALLOC   0    /* ptr_<index> = malloc(<size>) */
+#define TRACE_FREE    1    /* free(ptr_<index>) */
+#define TRACE_REALLOC 2    /* ptr_<index> = realloc(ptr_<index>, <size>) */
+
+/* One request of a trace */
+typedef struct {
+    int type;          /* TRACE_ALLOC, TRACE_FREE, or TRACE_REALLOC */
+    unsigned index;    /* id of the block */
+    unsigned size;     /* byte size of alloc/realloc request */
+} trace_req_t;
+
+/* An open trace file */
+typedef struct {
+    FILE *fp;
+    int sugg_heapsize;  /* the header of the trace... */
+    int num_ids;
+    int num_ops;
+    int weight;
+    int binary;         /* compressed binary format? */
+    long long opnum;    /* requests read or written so far */
+    long long linenum;  /* lines read so far (ASCII traces) */
+    char errmsg[TRACE_MAXLINE]; /* why the last call failed */
+
+    /* private state of the binary format */
+    unsigned char *buf; /* the current block */
+    size_t buflen, bufsize, bufpos;
+    unsigned blockreqs; /* requests left in (or written to) the block */
+    unsigned prev;      /* id of the previous request */
+    unsigned *dict;     /* size dictionary, in order of first use... */
+    unsigned *hash;     /* ... and a hash table of dictionary indexes */
+    int dictlen;
+    int done;           /* the end marker has been read */
+} tracestream_t;
+
+/* Open path ("-" is stdin) and read its header. -1 on failure */
+int trace_open(tracestream_t *ts, const char *path);
+
+/* Read the next request: 1 if there was one, 0 at the end, -1 on error */
+int trace_next(tracestream_t *ts, trace_req_t *req);
+
+/* Close a trace that was opened for reading */
+void trace_close(tracestream_t *ts);
+
+/* 
+ * Create path ("-" is stdout), in the binary format if binary is set,
+ * with the header in ts (sugg_heapsize, num_ids, num_ops, weight).
+ * -1 on failure.
+ */
+int trace_create(tracestream_t *ts, const char *path, int binary);
+
+/* Append a request to the trace. -1 on failure */
+int trace_write(tracestream_t *ts, trace_req_t *req);
+
+/* Finish and close a trace that was created. -1 on failure */
+int trace_finish(tracestream_t *ts);
+
+#endif /* __TRACESTREAM_H_ */